@@ -43,8 +43,10 @@
 
 #include "freertos/FreeRTOS.h"
 #include "freertos/queue.h"
+#include "freertos/task.h"
 #include "esp_err.h"
 #include "driver/gpio.h"
+#include "driver/pcnt.h"
 
 #ifdef __cplusplus
 extern "C" {
@@ -52,6 +54,11 @@ extern "C" {
 
 typedef int32_t rotary_encoder_position_t;
 
+/**
+ * @brief Number of step timestamps kept for speed measurement.
+ */
+#define ROTARY_ENCODER_TIMESTAMPS 32
+
 /**
  * @brief Enum representing the direction of rotation.
  */
@@ -77,6 +84,11 @@ typedef struct
     rotary_encoder_direction_t direction;  ///< Direction of last movement. Set to NOT_SET on reset.
 } rotary_encoder_state_t;
 
+/**
+ * @brief Function called from the interrupt handler when a watched position is reached, see ::rotary_encoder_set_watch
+ */
+typedef void (*rotary_encoder_watch_callback_t)(void * arg, BaseType_t * task_woken);
+
 /**
  * @brief Struct carries all the information needed by this driver to manage the rotary encoder device.
  *        The fields of this structure should not be accessed directly.
@@ -86,6 +98,24 @@ typedef struct
     gpio_num_t pin_a;                       ///< GPIO for Signal A from the rotary encoder device
     gpio_num_t pin_b;                       ///< GPIO for Signal B from the rotary encoder device
     QueueHandle_t queue;                    ///< Handle for event queue, created by ::rotary_encoder_create_queue
+    TaskHandle_t notify_task;               ///< Task notified by the interrupt handler, set by ::rotary_encoder_set_notify_task
+    rotary_encoder_position_t notify_steps; ///< Minimum position change between two notifications
+    rotary_encoder_position_t notify_position; ///< Position at last notification
+    rotary_encoder_watch_callback_t watch_callback; ///< Called once when watch_position is reached, NULL = no watch
+    void * watch_arg;                       ///< Argument of watch_callback
+    rotary_encoder_position_t watch_position; ///< Watched position, set by ::rotary_encoder_set_watch
+    bool watch_rising;                      ///< Watched position was above the position at arming
+    uint32_t step_time[ROTARY_ENCODER_TIMESTAMPS]; ///< Ring buffer with time (us) of the last step events
+    rotary_encoder_position_t step_position[ROTARY_ENCODER_TIMESTAMPS]; ///< Position at each entry of step_time
+    uint32_t step_count;                    ///< Valid entries in step_time (events since direction change)
+    uint8_t step_head;                      ///< Index of newest entry in step_time
+    bool use_pcnt;                          ///< Edges are counted by the pulse counter, see ::rotary_encoder_init_pcnt
+    pcnt_unit_t pcnt_unit;                  ///< Pulse counter unit used
+    pcnt_isr_handle_t pcnt_isr_handle;      ///< Pulse counter interrupt, registered by ::rotary_encoder_init_pcnt
+    int16_t pcnt_limit;                     ///< Counter limit (edges), the counter is reset and accumulated when reached
+    volatile int32_t pcnt_accum;            ///< Edges accumulated at counter limit events
+    int8_t pcnt_sign;                       ///< -1 when direction is flipped
+    uint8_t pcnt_shift;                     ///< log2 of counted edges per step (2 = full steps, 1 = half steps)
     const table_row_t * table;              ///< Pointer to active state transition table
     uint8_t table_state;                    ///< Internal state
     volatile rotary_encoder_state_t state;  ///< Device state
@@ -110,6 +140,22 @@ typedef struct
  */
 esp_err_t rotary_encoder_init(rotary_encoder_info_t * info, gpio_num_t pin_a, gpio_num_t pin_b);
 
+/**
+ * @brief Initialise the rotary encoder device using a pulse counter (PCNT) unit in x4 quadrature mode.
+ *        The edges are counted in hardware and filtered by the glitch filter, the interrupt handler only
+ *        runs when the counter reaches +/- event_steps. Between events the position is read from the counter.
+ *        Note: the interrupt is registered with pcnt_isr_register(), the pcnt isr service must not be installed.
+ * @param[in, out] info Pointer to allocated rotary encoder info structure.
+ * @param[in] pin_a GPIO number for rotary encoder output A.
+ * @param[in] pin_b GPIO number for rotary encoder output B.
+ * @param[in] unit Pulse counter unit to use.
+ * @param[in] filter_apb_cycles Pulses shorter than this number of APB clock cycles (80MHz) are ignored, 0 disables the filter (max 1023).
+ * @param[in] event_steps Full steps between two interrupts, determines resolution of timestamps and notifications.
+ * @return ESP_OK if successful, ESP_FAIL or ESP_ERR_* if an error occurred.
+ */
+esp_err_t rotary_encoder_init_pcnt(rotary_encoder_info_t * info, gpio_num_t pin_a, gpio_num_t pin_b,
+                                   pcnt_unit_t unit, uint16_t filter_apb_cycles, rotary_encoder_position_t event_steps);
+
 /**
  * @brief Enable half-stepping mode. This generates twice as many counted steps per rotation.
  * @param[in] info Pointer to initialised rotary encoder info structure.
@@ -149,6 +195,32 @@ QueueHandle_t rotary_encoder_create_queue(void);
  */
 esp_err_t rotary_encoder_set_queue(rotary_encoder_info_t * info, QueueHandle_t queue);
 
+/**
+ * @brief Notify a task directly from the interrupt handler (vTaskNotifyGiveFromISR) when the position
+ *        changed by at least the specified number of steps since the last notification.
+ *        The task can sleep in ulTaskNotifyTake() while the encoder is stationary, notifications
+ *        arriving while the task is busy are accumulated in its notification value.
+ * @param[in] info Pointer to initialised rotary encoder info structure.
+ * @param[in] task Handle of the task to notify, NULL to disable notifications.
+ * @param[in] steps Position change that triggers a notification (minimum 1).
+ * @return ESP_OK if successful, ESP_FAIL or ESP_ERR_* if an error occurred.
+ */
+esp_err_t rotary_encoder_set_notify_task(rotary_encoder_info_t * info, TaskHandle_t task, rotary_encoder_position_t steps);
+
+/**
+ * @brief Call a function from the interrupt handler once when the position reaches the watched position
+ *        (coming from the position at the time of this call, in either direction).
+ *        Replaces a previous watch. The watch is removed when it fired and by ::rotary_encoder_reset.
+ *        With the pulse counter the position is checked at each counter event only (every event_steps).
+ * @param[in] info Pointer to initialised rotary encoder info structure.
+ * @param[in] position Position to watch.
+ * @param[in] callback Function called in interrupt context, NULL to remove the watch.
+ * @param[in] arg Argument passed to callback.
+ * @return ESP_OK if successful, ESP_FAIL or ESP_ERR_* if an error occurred.
+ */
+esp_err_t rotary_encoder_set_watch(rotary_encoder_info_t * info, rotary_encoder_position_t position,
+                                   rotary_encoder_watch_callback_t callback, void * arg);
+
 /**
  * @brief Get the current position of the rotary encoder.
  * @param[in] info Pointer to initialised rotary encoder info structure.
@@ -157,6 +229,27 @@ esp_err_t rotary_encoder_set_queue(rotary_encoder_info_t * info, QueueHandle_t q
  */
 esp_err_t rotary_encoder_get_state(const rotary_encoder_info_t * info, rotary_encoder_state_t * state);
 
+/**
+ * @brief Struct with the times of the last step events in one direction.
+ *        With the interrupt backend every step is an event, with the pulse counter backend every event_steps steps.
+ */
+typedef struct
+{
+    uint32_t time[ROTARY_ENCODER_TIMESTAMPS]; ///< esp_timer time (us, lower 32 bit) of each event, time[0] is the newest
+    rotary_encoder_position_t position[ROTARY_ENCODER_TIMESTAMPS]; ///< Position at each event
+    uint32_t count;                           ///< Number of valid entries (limited to ROTARY_ENCODER_TIMESTAMPS)
+    rotary_encoder_direction_t direction;     ///< Direction of the steps
+} rotary_encoder_timestamps_t;
+
+/**
+ * @brief Get a consistent copy of the times of the last step events, e.g. for speed measurement.
+ *        Timestamps are captured in the interrupt handler, the history is restarted on direction change.
+ * @param[in] info Pointer to initialised rotary encoder info structure.
+ * @param[out] timestamps Times of the last steps, newest first.
+ * @return ESP_OK if successful, ESP_FAIL or ESP_ERR_* if an error occurred.
+ */
+esp_err_t rotary_encoder_get_timestamps(const rotary_encoder_info_t * info, rotary_encoder_timestamps_t * timestamps);
+
 /**
  * @brief Reset the current position of the rotary encoder to zero.
  * @param[in] info Pointer to initialised rotary encoder info structure.
@@ -90,7 +90,10 @@
 #include "rotary_encoder.h"
 
 #include "esp_log.h"
+#include "esp_timer.h"
 #include "driver/gpio.h"
+#include "driver/pcnt.h"
+#include "hal/pcnt_ll.h"
 
 #define TAG "rotary_encoder"
 
@@ -142,6 +145,80 @@ static const uint8_t _ttable_full[TABLE_ROWS][TABLE_COLS] = {
     {F_CCW_NEXT, F_CCW_FINAL, F_CCW_BEGIN, R_START},           // F_CCW_NEXT
 };
 
+// Protects step history and pcnt accumulator while they are accessed by a task
+static portMUX_TYPE _history_mux = portMUX_INITIALIZER_UNLOCKED;
+
+// Position from pcnt quadrature count (4 edges per full step)
+static rotary_encoder_position_t _pcnt_position(const rotary_encoder_info_t * info, int32_t count)
+{
+    count *= info->pcnt_sign;
+    // round towards negative infinity, a step is counted when its last edge arrived
+    int32_t edges = 1 << info->pcnt_shift;
+    return (count >= 0) ? count / edges : -((-count + edges - 1) / edges);
+}
+
+// Update position, step history, notify task and event queue (interrupt context)
+static void _step_event(rotary_encoder_info_t * info, rotary_encoder_position_t position,
+                        rotary_encoder_direction_t direction, BaseType_t * task_woken)
+{
+    uint32_t now = (uint32_t)esp_timer_get_time();
+    portENTER_CRITICAL_ISR(&_history_mux);
+    if (direction != info->state.direction)
+    {
+        info->step_count = 0;   // restart history on direction change
+    }
+    info->state.position = position;
+    info->state.direction = direction;
+    info->step_head = (info->step_head + 1) % ROTARY_ENCODER_TIMESTAMPS;
+    info->step_time[info->step_head] = now;
+    info->step_position[info->step_head] = position;
+    if (info->step_count < ROTARY_ENCODER_TIMESTAMPS)
+    {
+        ++info->step_count;
+    }
+    portEXIT_CRITICAL_ISR(&_history_mux);
+
+    if (info->notify_task)
+    {
+        // notify only when enough steps are accumulated to reduce context switches at high speed
+        rotary_encoder_position_t diff = position - info->notify_position;
+        if (diff >= info->notify_steps || -diff >= info->notify_steps)
+        {
+            info->notify_position = position;
+            vTaskNotifyGiveFromISR(info->notify_task, task_woken);
+        }
+    }
+
+    rotary_encoder_watch_callback_t watch_callback = NULL;
+    void * watch_arg = NULL;
+    portENTER_CRITICAL_ISR(&_history_mux);
+    if (info->watch_callback && (info->watch_rising ? position >= info->watch_position
+                                                    : position <= info->watch_position))
+    {
+        watch_callback = info->watch_callback;
+        watch_arg = info->watch_arg;
+        info->watch_callback = NULL;   // fire once
+    }
+    portEXIT_CRITICAL_ISR(&_history_mux);
+    if (watch_callback)
+    {
+        watch_callback(watch_arg, task_woken);
+    }
+
+    if (info->queue)
+    {
+        rotary_encoder_event_t queue_event =
+        {
+            .state =
+            {
+                .position = position,
+                .direction = direction,
+            },
+        };
+        xQueueOverwriteFromISR(info->queue, &queue_event, task_woken);
+    }
+}
+
 static uint8_t _process(rotary_encoder_info_t * info)
 {
     uint8_t event = 0;
@@ -170,41 +247,134 @@ static void _isr_rotenc(void * args)
 {
     rotary_encoder_info_t * info = (rotary_encoder_info_t *)args;
     uint8_t event = _process(info);
-    bool send_event = false;
+    BaseType_t task_woken = pdFALSE;
 
     switch (event)
     {
     case DIR_CW:
-        ++info->state.position;
-        info->state.direction = ROTARY_ENCODER_DIRECTION_CLOCKWISE;
-        send_event = true;
+        _step_event(info, info->state.position + 1, ROTARY_ENCODER_DIRECTION_CLOCKWISE, &task_woken);
         break;
     case DIR_CCW:
-        --info->state.position;
-        info->state.direction = ROTARY_ENCODER_DIRECTION_COUNTER_CLOCKWISE;
-        send_event = true;
+        _step_event(info, info->state.position - 1, ROTARY_ENCODER_DIRECTION_COUNTER_CLOCKWISE, &task_woken);
         break;
     default:
         break;
     }
 
-    if (send_event && info->queue)
+    if (task_woken)
     {
-        rotary_encoder_event_t queue_event =
-        {
-            .state =
-            {
-                .position = info->state.position,
-                .direction = info->state.direction,
-            },
-        };
-        BaseType_t task_woken = pdFALSE;
-        xQueueOverwriteFromISR(info->queue, &queue_event, &task_woken);
-        if (task_woken)
-        {
-            portYIELD_FROM_ISR();
-        }
+        portYIELD_FROM_ISR();
+    }
+}
+
+// Edges of the limit event in status (latched event flags of the unit)
+static int32_t _pcnt_event_edges(const rotary_encoder_info_t * info, uint32_t status)
+{
+    if (status & PCNT_EVT_H_LIM)
+    {
+        return info->pcnt_limit;
+    }
+    else if (status & PCNT_EVT_L_LIM)
+    {
+        return -info->pcnt_limit;
+    }
+    return 0;
+}
+
+// Counter reached a limit and was reset to zero by hardware
+// The interrupt is cleared together with updating the accumulator (see _pcnt_get_position),
+// therefore the isr is registered directly instead of using the pcnt isr service
+static void _isr_pcnt(void * args)
+{
+    rotary_encoder_info_t * info = (rotary_encoder_info_t *)args;
+    pcnt_dev_t * hw = PCNT_LL_GET_HW(0);
+    uint32_t mask = 1 << info->pcnt_unit;
+    uint32_t pending = 0;
+    uint32_t status = 0;
+    pcnt_ll_get_intr_status(hw, &pending);
+    if (!(pending & mask))
+    {
+        return;
+    }
+    pcnt_ll_get_event_status(hw, info->pcnt_unit, &status);
+    BaseType_t task_woken = pdFALSE;
+
+    portENTER_CRITICAL_ISR(&_history_mux);
+    pcnt_ll_clear_intr_status(hw, mask);
+    int32_t edges = _pcnt_event_edges(info, status);
+    info->pcnt_accum += edges;
+    rotary_encoder_position_t position = _pcnt_position(info, info->pcnt_accum);
+    portEXIT_CRITICAL_ISR(&_history_mux);
+    if (edges == 0)
+    {
+        return;
     }
+
+    rotary_encoder_direction_t direction = (position > info->state.position) ?
+        ROTARY_ENCODER_DIRECTION_CLOCKWISE : ROTARY_ENCODER_DIRECTION_COUNTER_CLOCKWISE;
+    _step_event(info, position, direction, &task_woken);
+
+    if (task_woken)
+    {
+        portYIELD_FROM_ISR();
+    }
+}
+
+static void _init_info(rotary_encoder_info_t * info, gpio_num_t pin_a, gpio_num_t pin_b)
+{
+    info->pin_a = pin_a;
+    info->pin_b = pin_b;
+    info->table = &_ttable_full[0];   //enable_half_step ? &_ttable_half[0] : &_ttable_full[0];
+    info->table_state = R_START;
+    info->state.position = 0;
+    info->state.direction = ROTARY_ENCODER_DIRECTION_NOT_SET;
+    info->notify_task = NULL;
+    info->notify_steps = 1;
+    info->notify_position = 0;
+    info->watch_callback = NULL;
+    info->watch_arg = NULL;
+    info->watch_position = 0;
+    info->watch_rising = true;
+    info->step_count = 0;
+    info->step_head = 0;
+    info->use_pcnt = false;
+    info->pcnt_accum = 0;
+    info->pcnt_sign = 1;
+    info->pcnt_shift = 2;
+}
+
+// Edges accumulated at limit events plus the edges in the pcnt counter, call with _history_mux held
+// The hardware resets the counter at a limit before the isr adds it to the accumulator:
+// while the interrupt is pending, the edges of the pending event are added here
+static int32_t _pcnt_get_edges_locked(const rotary_encoder_info_t * info)
+{
+    pcnt_dev_t * hw = PCNT_LL_GET_HW(0);
+    uint32_t mask = 1 << info->pcnt_unit;
+    uint32_t pending, pending_after, status;
+    int16_t count;
+    // isr clears the interrupt and updates the accumulator while holding _history_mux
+    do
+    {
+        pcnt_ll_get_intr_status(hw, &pending);
+        pcnt_ll_get_counter_value(hw, info->pcnt_unit, &count);
+        pcnt_ll_get_event_status(hw, info->pcnt_unit, &status);
+        pcnt_ll_get_intr_status(hw, &pending_after);
+    } while ((pending ^ pending_after) & mask); // limit reached while reading -> count may be from before
+    int32_t edges = info->pcnt_accum + count;
+    if (pending & mask)
+    {
+        edges += _pcnt_event_edges(info, status);
+    }
+    return edges;
+}
+
+// Current position including the steps in the pcnt counter since the last limit event
+static rotary_encoder_position_t _pcnt_get_position(const rotary_encoder_info_t * info)
+{
+    portENTER_CRITICAL(&_history_mux);
+    int32_t edges = _pcnt_get_edges_locked(info);
+    portEXIT_CRITICAL(&_history_mux);
+    return _pcnt_position(info, edges);
 }
 
 esp_err_t rotary_encoder_init(rotary_encoder_info_t * info, gpio_num_t pin_a, gpio_num_t pin_b)
@@ -212,12 +382,7 @@ esp_err_t rotary_encoder_init(rotary_encoder_info_t * info, gpio_num_t pin_a, gp
     esp_err_t err = ESP_OK;
     if (info)
     {
-        info->pin_a = pin_a;
-        info->pin_b = pin_b;
-        info->table = &_ttable_full[0];   //enable_half_step ? &_ttable_half[0] : &_ttable_full[0];
-        info->table_state = R_START;
-        info->state.position = 0;
-        info->state.direction = ROTARY_ENCODER_DIRECTION_NOT_SET;
+        _init_info(info, pin_a, pin_b);
 
         // configure GPIOs
         gpio_pad_select_gpio(info->pin_a);
@@ -242,6 +407,79 @@ esp_err_t rotary_encoder_init(rotary_encoder_info_t * info, gpio_num_t pin_a, gp
     return err;
 }
 
+esp_err_t rotary_encoder_init_pcnt(rotary_encoder_info_t * info, gpio_num_t pin_a, gpio_num_t pin_b,
+                                   pcnt_unit_t unit, uint16_t filter_apb_cycles, rotary_encoder_position_t event_steps)
+{
+    esp_err_t err = ESP_OK;
+    if (info && event_steps > 0 && event_steps * 4 <= INT16_MAX)
+    {
+        _init_info(info, pin_a, pin_b);
+        info->use_pcnt = true;
+        info->pcnt_unit = unit;
+        info->pcnt_limit = event_steps * 4;
+
+        // x4 quadrature: both channels count both edges of their pulse input,
+        // the level of the other input decides the direction
+        pcnt_config_t config =
+        {
+            .pulse_gpio_num = pin_a,
+            .ctrl_gpio_num = pin_b,
+            .lctrl_mode = PCNT_MODE_REVERSE,
+            .hctrl_mode = PCNT_MODE_KEEP,
+            .pos_mode = PCNT_COUNT_INC,
+            .neg_mode = PCNT_COUNT_DEC,
+            .counter_h_lim = info->pcnt_limit,
+            .counter_l_lim = -info->pcnt_limit,
+            .unit = unit,
+            .channel = PCNT_CHANNEL_0,
+        };
+        err = pcnt_unit_config(&config);
+        if (err == ESP_OK)
+        {
+            config.pulse_gpio_num = pin_b;
+            config.ctrl_gpio_num = pin_a;
+            config.pos_mode = PCNT_COUNT_DEC;
+            config.neg_mode = PCNT_COUNT_INC;
+            config.channel = PCNT_CHANNEL_1;
+            err = pcnt_unit_config(&config);
+        }
+        if (err == ESP_OK)
+        {
+            // inputs are configured by pcnt_unit_config, encoder needs pullups
+            gpio_set_pull_mode(pin_a, GPIO_PULLUP_ONLY);
+            gpio_set_pull_mode(pin_b, GPIO_PULLUP_ONLY);
+
+            if (filter_apb_cycles > 0)
+            {
+                pcnt_set_filter_value(unit, filter_apb_cycles > 1023 ? 1023 : filter_apb_cycles);
+                pcnt_filter_enable(unit);
+            }
+            else
+            {
+                pcnt_filter_disable(unit);
+            }
+
+            pcnt_event_enable(unit, PCNT_EVT_H_LIM);
+            pcnt_event_enable(unit, PCNT_EVT_L_LIM);
+            pcnt_counter_pause(unit);
+            pcnt_counter_clear(unit);
+            err = pcnt_isr_register(_isr_pcnt, info, 0, &info->pcnt_isr_handle);
+            pcnt_intr_enable(unit);
+            pcnt_counter_resume(unit);
+        }
+        if (err != ESP_OK)
+        {
+            ESP_LOGE(TAG, "pcnt unit %d config failed: %s", unit, esp_err_to_name(err));
+        }
+    }
+    else
+    {
+        ESP_LOGE(TAG, "info is NULL or invalid event_steps");
+        err = ESP_ERR_INVALID_ARG;
+    }
+    return err;
+}
+
 esp_err_t rotary_encoder_enable_half_steps(rotary_encoder_info_t * info, bool enable)
 {
     esp_err_t err = ESP_OK;
@@ -249,6 +487,7 @@ esp_err_t rotary_encoder_enable_half_steps(rotary_encoder_info_t * info, bool en
     {
         info->table = enable ? &_ttable_half[0] : &_ttable_full[0];
         info->table_state = R_START;
+        info->pcnt_shift = enable ? 1 : 2;
     }
     else
     {
@@ -266,6 +505,8 @@ esp_err_t rotary_encoder_flip_direction(rotary_encoder_info_t * info)
         gpio_num_t temp = info->pin_a;
         info->pin_a = info->pin_b;
         info->pin_b = temp;
+        // pulse counter channels are already routed -> invert the count instead
+        info->pcnt_sign = -info->pcnt_sign;
     }
     else
     {
@@ -280,8 +521,17 @@ esp_err_t rotary_encoder_uninit(rotary_encoder_info_t * info)
     esp_err_t err = ESP_OK;
     if (info)
     {
-        gpio_isr_handler_remove(info->pin_a);
-        gpio_isr_handler_remove(info->pin_b);
+        if (info->use_pcnt)
+        {
+            pcnt_counter_pause(info->pcnt_unit);
+            pcnt_intr_disable(info->pcnt_unit);
+            esp_intr_free(info->pcnt_isr_handle);
+        }
+        else
+        {
+            gpio_isr_handler_remove(info->pin_a);
+            gpio_isr_handler_remove(info->pin_b);
+        }
     }
     else
     {
@@ -311,13 +561,52 @@ esp_err_t rotary_encoder_set_queue(rotary_encoder_info_t * info, QueueHandle_t q
     return err;
 }
 
+esp_err_t rotary_encoder_set_notify_task(rotary_encoder_info_t * info, TaskHandle_t task, rotary_encoder_position_t steps)
+{
+    esp_err_t err = ESP_OK;
+    if (info)
+    {
+        info->notify_steps = steps > 0 ? steps : 1;
+        info->notify_position = info->state.position;
+        info->notify_task = task;
+    }
+    else
+    {
+        ESP_LOGE(TAG, "info is NULL");
+        err = ESP_ERR_INVALID_ARG;
+    }
+    return err;
+}
+
+esp_err_t rotary_encoder_set_watch(rotary_encoder_info_t * info, rotary_encoder_position_t position,
+                                   rotary_encoder_watch_callback_t callback, void * arg)
+{
+    esp_err_t err = ESP_OK;
+    if (info)
+    {
+        rotary_encoder_position_t now = info->use_pcnt ? _pcnt_get_position(info) : info->state.position;
+        portENTER_CRITICAL(&_history_mux);
+        info->watch_position = position;
+        info->watch_rising = position > now;
+        info->watch_arg = arg;
+        info->watch_callback = callback;
+        portEXIT_CRITICAL(&_history_mux);
+    }
+    else
+    {
+        ESP_LOGE(TAG, "info is NULL");
+        err = ESP_ERR_INVALID_ARG;
+    }
+    return err;
+}
+
 esp_err_t rotary_encoder_get_state(const rotary_encoder_info_t * info, rotary_encoder_state_t * state)
 {
     esp_err_t err = ESP_OK;
     if (info && state)
     {
         // make a snapshot of the state
-        state->position = info->state.position;
+        state->position = info->use_pcnt ? _pcnt_get_position(info) : info->state.position;
         state->direction = info->state.direction;
     }
     else
@@ -328,13 +617,56 @@ esp_err_t rotary_encoder_get_state(const rotary_encoder_info_t * info, rotary_en
     return err;
 }
 
+esp_err_t rotary_encoder_get_timestamps(const rotary_encoder_info_t * info, rotary_encoder_timestamps_t * timestamps)
+{
+    esp_err_t err = ESP_OK;
+    if (info && timestamps)
+    {
+        portENTER_CRITICAL(&_history_mux);
+        timestamps->count = info->step_count;
+        timestamps->direction = info->state.direction;
+        for (uint32_t i = 0; i < info->step_count; ++i)
+        {
+            uint8_t index = (info->step_head + ROTARY_ENCODER_TIMESTAMPS - i) % ROTARY_ENCODER_TIMESTAMPS;
+            timestamps->time[i] = info->step_time[index];
+            timestamps->position[i] = info->step_position[index];
+        }
+        portEXIT_CRITICAL(&_history_mux);
+    }
+    else
+    {
+        ESP_LOGE(TAG, "info and/or timestamps is NULL");
+        err = ESP_ERR_INVALID_ARG;
+    }
+    return err;
+}
+
 esp_err_t rotary_encoder_reset(rotary_encoder_info_t * info)
 {
     esp_err_t err = ESP_OK;
     if (info)
     {
+        portENTER_CRITICAL(&_history_mux);
+        // state.position does not include the edges in the pcnt counter since the last limit event
+        rotary_encoder_position_t offset = info->state.position;
+        if (info->use_pcnt)
+        {
+            offset = _pcnt_position(info, _pcnt_get_edges_locked(info));
+            // a pending limit event refers to the counting before reset
+            pcnt_counter_clear(info->pcnt_unit);
+            pcnt_ll_clear_intr_status(PCNT_LL_GET_HW(0), 1 << info->pcnt_unit);
+        }
+        // shift history so that position differences stay valid for speed measurement
+        for (uint32_t i = 0; i < ROTARY_ENCODER_TIMESTAMPS; ++i)
+        {
+            info->step_position[i] -= offset;
+        }
+        info->pcnt_accum = 0;
         info->state.position = 0;
         info->state.direction = ROTARY_ENCODER_DIRECTION_NOT_SET;
+        info->notify_position = 0;
+        info->watch_callback = NULL;   // watched position refers to the counting before reset
+        portEXIT_CRITICAL(&_history_mux);
     }
     else
     {
@@ -1,4 +1,5 @@
 #include "gpio_evaluateSwitch.hpp"
+#include "gpio_inputEvents.hpp"
 
 static const char *TAG = "evaluateSwitch";
 
@@ -32,7 +33,7 @@ gpio_evaluatedSwitch::gpio_evaluatedSwitch( //optional parameters given
 gpio_evaluatedSwitch::gpio_evaluatedSwitch( //with function as input source
         bool (*getInputStatePtr_f)(void),
         bool inverted_f){
-    //gpio_num = NULL;
+    gpio_num = GPIO_NUM_NC;
     //pullup = NULL;
     inverted = inverted_f;
     getInputStatePtr = getInputStatePtr_f;
@@ -61,19 +62,19 @@ void gpio_evaluatedSwitch::initGpio(){
 
 
 
-void gpio_evaluatedSwitch::handle(){  //Statemachine for debouncing and edge detection
-
+bool gpio_evaluatedSwitch::readInput(){
+    bool active = false;
     //--- get pin state with required method ---
     switch (inputSource){
         case inputSource_t::GPIO: //from gpio pin
             if (gpio_get_level(gpio_num) == 0){ //pin low
-                inputState = true;
+                active = true;
             } else { //pin high
-                inputState = false;
+                active = false;
             }
             break;
         case inputSource_t::FUNCTION: //from funtion
-            inputState = (*getInputStatePtr)();
+            active = (*getInputStatePtr)();
             break;
     }
 
@@ -81,8 +82,49 @@ void gpio_evaluatedSwitch::handle(){  //Statemachine for debouncing and edge det
     //not inverted: switch switches to GND when active
     //inverted: switch switched to VCC when active
     if (inverted == true){
-        inputState = !inputState;
+        active = !active;
+    }
+    return active;
+}
+
+
+
+void gpio_evaluatedSwitch::handleInterruptDriven(){ //apply edge debounced by gpio_inputEvents
+    bool pressed;
+    uint32_t edgeMs, changes;
+    gpioInputs_read(inputSlot, &pressed, &edgeMs, &changes);
+    //edge events are valid for one handle() call like in polling mode
+    risingEdge = false;
+    fallingEdge = false;
+    if (changes != changesApplied && pressed != state) {
+        state = pressed;
+        if (pressed) {
+            risingEdge = true;
+            msReleased = edgeMs - timestampLow; //calculate duration the button was released
+            timestampHigh = edgeMs;
+        } else {
+            fallingEdge = true;
+            msPressed = edgeMs - timestampHigh; //calculate duration the button was pressed
+            timestampLow = edgeMs;
+        }
+    } else if (state) {
+        msPressed = esp_log_timestamp() - timestampHigh; //update duration pressed
+    } else {
+        msReleased = esp_log_timestamp() - timestampLow; //update duration released
     }
+    changesApplied = changes;
+}
+
+
+
+void gpio_evaluatedSwitch::handle(){  //Statemachine for debouncing and edge detection
+    if (inputSlot != NULL) {
+        handleInterruptDriven();
+        return;
+    }
+
+    //--- get debounced input ---
+    inputState = readInput();
 
 
     //=========================================================
@@ -20,6 +20,8 @@ extern "C"
 
 enum class inputSource_t {GPIO, FUNCTION};
 
+struct gpioInputSlot; //interrupt driven input, see gpio_inputEvents.hpp
+
 class gpio_evaluatedSwitch {
     public:
         //--- input ---
@@ -50,7 +52,13 @@ class gpio_evaluatedSwitch {
         uint32_t msReleased = 0;
 
         //--- functions ---
-        void handle();  //Statemachine for debouncing and edge detection
+        void handle();  //Statemachine for debouncing and edge detection (polling)
+                        //or apply edges debounced by gpio_inputEvents (interrupt driven)
+        bool readInput(); //current input state (not debounced, inversion applied)
+        gpio_num_t getGpioNum(){ return gpio_num; } //GPIO_NUM_NC with function as source
+
+        //set by gpioInputs_add() when edges are detected by interrupt
+        gpioInputSlot *inputSlot = NULL;
 
     private:
         gpio_num_t gpio_num;
@@ -64,7 +72,9 @@ class gpio_evaluatedSwitch {
         bool inputState = false;
         uint32_t timestampLow = 0;
         uint32_t timestampHigh = 0;
+        uint32_t changesApplied = 0; //debounced edges of inputSlot already applied
         void initGpio();
+        void handleInterruptDriven();
 
 };
 
@@ -0,0 +1,181 @@
+extern "C"
+{
+#include "esp_timer.h"
+#include "esp_attr.h"
+}
+
+#include "gpio_inputEvents.hpp"
+
+static const char *TAG = "inputEvents";
+
+
+//---------------------
+//--- configuration ---
+//---------------------
+#define INPUTS_MAX 8
+
+
+//----------------------
+//----- variables ------
+//----------------------
+static gpioInputSlot slots[INPUTS_MAX];
+static int slotCount = 0;
+static portMUX_TYPE slotsMux = portMUX_INITIALIZER_UNLOCKED;
+static TaskHandle_t debounceTask = NULL;
+static esp_timer_handle_t wakeTimer = NULL;
+static QueueHandle_t eventQueue = NULL;
+static uint32_t dropped = 0;
+
+
+
+//---------------------------
+//----- local functions -----
+//---------------------------
+//--- isr ---
+//timestamp edge and wake debounce task (any edge, level is evaluated after debounce time)
+static void IRAM_ATTR isr_edge(void *arg){
+    gpioInputSlot *slot = (gpioInputSlot *)arg;
+    int64_t now = esp_timer_get_time();
+    portENTER_CRITICAL_ISR(&slotsMux);
+    if (!slot->pending) slot->firstEdgeUs = now;
+    slot->edgeUs = now;
+    slot->pending = true;
+    portEXIT_CRITICAL_ISR(&slotsMux);
+    BaseType_t woken = pdFALSE;
+    vTaskNotifyGiveFromISR(debounceTask, &woken);
+    portYIELD_FROM_ISR(woken);
+}
+
+
+//--- wake timer ---
+//debounce time of a pending edge passed
+static void timer_wake(void *arg){
+    xTaskNotifyGive(debounceTask);
+}
+
+
+//--- publish ---
+static void publish(gpioInputSlot *slot, bool pressed, int64_t firstEdgeUs){
+    gpioInputEvent_t event = {slot->input, pressed, (uint32_t)(firstEdgeUs / 1000)};
+    portENTER_CRITICAL(&slotsMux);
+    slot->debounced = pressed;
+    slot->debouncedEdgeMs = event.timestampMs;
+    slot->changes++;
+    portEXIT_CRITICAL(&slotsMux);
+    if (slot->onEdge != NULL) slot->onEdge(&event);
+    if (eventQueue != NULL && xQueueSend(eventQueue, &event, 0) != pdTRUE) dropped++;
+}
+
+
+//--- debounce task ---
+//accept the level of each input with pending edge when it did not change for minOnMs / minOffMs
+static void task_debounce(void *pvParameter){
+    while (1) {
+        int64_t now = esp_timer_get_time();
+        int64_t nextCheckUs = INT64_MAX;
+        for (int i = 0; i < slotCount; i++) {
+            gpioInputSlot *slot = &slots[i];
+            portENTER_CRITICAL(&slotsMux);
+            bool pending = slot->pending;
+            int64_t edgeUs = slot->edgeUs;
+            int64_t firstEdgeUs = slot->firstEdgeUs;
+            portEXIT_CRITICAL(&slotsMux);
+            if (!pending) continue;
+            bool level = slot->input->readInput();
+            int64_t stableUs = (int64_t)(level ? slot->input->minOnMs : slot->input->minOffMs) * 1000;
+            if (now - edgeUs < stableUs) {
+                if (edgeUs + stableUs < nextCheckUs) nextCheckUs = edgeUs + stableUs;
+                continue;
+            }
+            //stable -> clear pending unless a new edge occurred meanwhile
+            portENTER_CRITICAL(&slotsMux);
+            bool newEdge = slot->edgeUs != edgeUs;
+            if (!newEdge) slot->pending = false;
+            portEXIT_CRITICAL(&slotsMux);
+            if (newEdge) {
+                nextCheckUs = now;
+            } else if (level != slot->debounced) {
+                publish(slot, level, firstEdgeUs);
+            }
+        }
+        //wait for next edge or debounce time of pending edge
+        if (nextCheckUs != INT64_MAX) {
+            esp_timer_stop(wakeTimer);
+            int64_t waitUs = nextCheckUs - esp_timer_get_time();
+            esp_timer_start_once(wakeTimer, waitUs > 0 ? waitUs : 1);
+        }
+        ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+    }
+}
+
+
+
+//=======================
+//=== gpioInputs_init ===
+//=======================
+QueueHandle_t gpioInputs_init(UBaseType_t taskPriority, UBaseType_t queueLength){
+    //service may already be installed (e.g. rotary encoder)
+    esp_err_t err = gpio_install_isr_service(0);
+    if (err != ESP_OK && err != ESP_ERR_INVALID_STATE) {
+        ESP_LOGE(TAG, "installing gpio isr service failed (%s)", esp_err_to_name(err));
+    }
+    esp_timer_create_args_t timerArgs = {};
+    timerArgs.callback = timer_wake;
+    timerArgs.name = "inputDebounce";
+    ESP_ERROR_CHECK(esp_timer_create(&timerArgs, &wakeTimer));
+    if (queueLength > 0) {
+        eventQueue = xQueueCreate(queueLength, sizeof(gpioInputEvent_t));
+    }
+    xTaskCreate(task_debounce, "task_debounce", 2048, NULL, taskPriority, &debounceTask);
+    return eventQueue;
+}
+
+
+
+//======================
+//=== gpioInputs_add ===
+//======================
+bool gpioInputs_add(gpio_evaluatedSwitch *input, void (*onEdge)(const gpioInputEvent_t *event)){
+    gpio_num_t gpio = input->getGpioNum();
+    if (debounceTask == NULL || gpio == GPIO_NUM_NC || slotCount >= INPUTS_MAX) {
+        ESP_LOGE(TAG, "can not add input (gpio %d, %d of %d inputs used)", (int)gpio, slotCount, INPUTS_MAX);
+        return false;
+    }
+    gpioInputSlot *slot = &slots[slotCount];
+    slot->input = input;
+    slot->onEdge = onEdge;
+    //current level is confirmed like an edge at startup (switch held at power on)
+    slot->firstEdgeUs = slot->edgeUs = esp_timer_get_time();
+    slot->pending = true;
+    input->inputSlot = slot;
+    slotCount++;
+
+    gpio_set_intr_type(gpio, GPIO_INTR_ANYEDGE);
+    gpio_isr_handler_add(gpio, isr_edge, slot);
+    gpio_intr_enable(gpio);
+    xTaskNotifyGive(debounceTask);
+    ESP_LOGI(TAG, "gpio %d: edge interrupt armed", (int)gpio);
+    return true;
+}
+
+
+
+//=======================
+//=== gpioInputs_read ===
+//=======================
+void gpioInputs_read(const gpioInputSlot *slot, bool *pressed, uint32_t *edgeMs, uint32_t *changes){
+    portENTER_CRITICAL(&slotsMux);
+    *pressed = slot->debounced;
+    *edgeMs = slot->debouncedEdgeMs;
+    *changes = slot->changes;
+    portEXIT_CRITICAL(&slotsMux);
+}
+
+
+
+//=============================
+//=== gpioInputs_getDropped ===
+//=============================
+uint32_t gpioInputs_getDropped(){
+    return dropped;
+}
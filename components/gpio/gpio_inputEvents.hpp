@@ -0,0 +1,55 @@
+#pragma once
+
+extern "C"
+{
+#include "freertos/FreeRTOS.h"
+#include "freertos/queue.h"
+}
+
+#include "gpio_evaluateSwitch.hpp"
+
+//interrupt driven input engine for gpio_evaluatedSwitch objects with a gpio pin as source
+//- the gpio isr only timestamps the edge and wakes the debounce task
+//- the debounce task confirms the new level after minOnMs / minOffMs (woken by esp_timer, not
+//  limited to the rtos tick) and publishes the debounced edge:
+//  to the switch (applied at its next handle() call), to an optional callback (runs right away
+//  in the debounce task) and to a queue
+//thus edges are timestamped with the time of the actual edge and the latency no longer depends
+//on how often handle() is called
+
+//debounced edge of an input
+typedef struct {
+    gpio_evaluatedSwitch *input;
+    bool pressed;           //state after the edge (inversion applied)
+    uint32_t timestampMs;   //time of the first edge (esp_log_timestamp), before debouncing
+} gpioInputEvent_t;
+
+//state of an interrupt driven input, shared by isr, debounce task and handle()
+struct gpioInputSlot {
+    gpio_evaluatedSwitch *input;
+    void (*onEdge)(const gpioInputEvent_t *event);
+    //--- written in isr ---
+    volatile int64_t edgeUs;        //last edge
+    volatile int64_t firstEdgeUs;   //first edge after the last debounced state
+    volatile bool pending;          //edge not debounced yet
+    //--- written in debounce task ---
+    bool debounced;
+    uint32_t debouncedEdgeMs;
+    uint32_t changes;               //count of debounced edges, handle() applies new ones
+};
+
+
+//create debounce task, installs gpio isr service if not done yet
+//returns queue receiving debounced edges of all inputs (queueLength 0: no queue, NULL)
+QueueHandle_t gpioInputs_init(UBaseType_t taskPriority, UBaseType_t queueLength);
+
+//arm edge interrupt of a switch (gpio source only), handle() then applies the debounced edges
+//onEdge: optional, called in the debounce task right at the debounced edge (keep short)
+//returns false when the switch has no gpio source or too many inputs were added
+bool gpioInputs_add(gpio_evaluatedSwitch *input, void (*onEdge)(const gpioInputEvent_t *event) = NULL);
+
+//copy debounced state of an input (used by handle())
+void gpioInputs_read(const gpioInputSlot *slot, bool *pressed, uint32_t *edgeMs, uint32_t *changes);
+
+//number of events not sent because the queue was full
+uint32_t gpioInputs_getDropped();
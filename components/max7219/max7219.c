@@ -39,6 +39,7 @@
  */
 #include "max7219.h"
 #include <string.h>
+#include <stdlib.h>
 #include <esp_log.h>
 
 #include "max7219_priv.h"
@@ -48,6 +49,7 @@ static const char *TAG = "max7219";
 #define ALL_CHIPS 0xff
 #define ALL_DIGITS 8
 
+#define REG_NO_OP        (0 << 8)
 #define REG_DIGIT_0      (1 << 8)
 #define REG_DECODE_MODE  (9 << 8)
 #define REG_INTENSITY    (10 << 8)
@@ -66,8 +68,25 @@ static inline uint16_t shuffle(uint16_t val)
     return (val >> 8) | (val << 8);
 }
 
+// wait until queued framebuffer transactions are finished
+static esp_err_t wait_pending(max7219_t *dev)
+{
+    if (!dev->fb)
+        return ESP_OK;
+    spi_transaction_t *t;
+    while (dev->fb->pending)
+    {
+        CHECK(spi_device_get_trans_result(dev->spi_dev, &t, portMAX_DELAY));
+        dev->fb->pending--;
+    }
+    return ESP_OK;
+}
+
 static esp_err_t send(max7219_t *dev, uint8_t chip, uint16_t value)
 {
+    // results of queued transactions have to be fetched before spi_device_transmit()
+    CHECK(wait_pending(dev));
+
     uint16_t buf[MAX7219_MAX_CASCADE_SIZE] = { 0 };
     if (chip == ALL_CHIPS)
     {
@@ -122,8 +141,9 @@ esp_err_t max7219_init_desc(max7219_t *dev, spi_host_device_t host, uint32_t clo
     dev->spi_cfg.spics_io_num = cs_pin;
     dev->spi_cfg.clock_speed_hz = clock_speed_hz;
     dev->spi_cfg.mode = 0;
-    dev->spi_cfg.queue_size = 1;
+    dev->spi_cfg.queue_size = ALL_DIGITS; // one flush queues up to 8 transactions
     dev->spi_cfg.flags = SPI_DEVICE_NO_DUMMY;
+    dev->fb = NULL;
 
     return spi_bus_add_device(host, &dev->spi_cfg, &dev->spi_dev);
 }
@@ -132,6 +152,9 @@ esp_err_t max7219_free_desc(max7219_t *dev)
 {
     CHECK_ARG(dev);
 
+    CHECK(wait_pending(dev));
+    free(dev->fb);
+    dev->fb = NULL;
     return spi_bus_remove_device(dev->spi_dev);
 }
 
@@ -169,13 +192,28 @@ esp_err_t max7219_init(max7219_t *dev)
     return ESP_OK;
 }
 
+// clear all digits immediately, framebuffer is cleared as well
+static esp_err_t clear_all(max7219_t *dev)
+{
+    uint8_t val = dev->bcd ? VAL_CLEAR_BCD : VAL_CLEAR_NORMAL;
+    for (uint8_t i = 0; i < ALL_DIGITS; i++)
+        CHECK(send(dev, ALL_CHIPS, (REG_DIGIT_0 + ((uint16_t)i << 8)) | val));
+    if (dev->fb)
+    {
+        memset(dev->fb->digits, val, sizeof(dev->fb->digits));
+        memset(dev->fb->dirty, 0, sizeof(dev->fb->dirty));
+    }
+
+    return ESP_OK;
+}
+
 esp_err_t max7219_set_decode_mode(max7219_t *dev, bool bcd)
 {
     CHECK_ARG(dev);
 
     dev->bcd = bcd;
     CHECK(send(dev, ALL_CHIPS, REG_DECODE_MODE | (bcd ? 0xff : 0)));
-    CHECK(max7219_clear(dev));
+    CHECK(clear_all(dev));
 
     return ESP_OK;
 }
@@ -186,6 +224,7 @@ esp_err_t max7219_set_brightness(max7219_t *dev, uint8_t value)
     CHECK_ARG(value <= MAX7219_MAX_BRIGHTNESS);
 
     CHECK(send(dev, ALL_CHIPS, REG_INTENSITY | value));
+    dev->brightness = value;
 
     return ESP_OK;
 }
@@ -195,6 +234,7 @@ esp_err_t max7219_set_shutdown_mode(max7219_t *dev, bool shutdown)
     CHECK_ARG(dev);
 
     CHECK(send(dev, ALL_CHIPS, REG_SHUTDOWN | !shutdown));
+    dev->shutdown = shutdown;
 
     return ESP_OK;
 }
@@ -216,6 +256,17 @@ esp_err_t max7219_set_digit(max7219_t *dev, uint8_t digit, uint8_t val)
 
     ESP_LOGV(TAG, "Chip %d, digit %d val 0x%02x", c, d, val);
 
+    if (dev->fb)
+    {
+        // only mark changed digits, sent by max7219_flush()
+        if (dev->fb->digits[c][d] != val)
+        {
+            dev->fb->digits[c][d] = val;
+            dev->fb->dirty[c] |= 1 << d;
+        }
+        return ESP_OK;
+    }
+
     CHECK(send(dev, c, (REG_DIGIT_0 + ((uint16_t)d << 8)) | val));
 
     return ESP_OK;
@@ -225,9 +276,91 @@ esp_err_t max7219_clear(max7219_t *dev)
 {
     CHECK_ARG(dev);
 
-    uint8_t val = dev->bcd ? VAL_CLEAR_BCD : VAL_CLEAR_NORMAL;
-    for (uint8_t i = 0; i < ALL_DIGITS; i++)
-        CHECK(send(dev, ALL_CHIPS, (REG_DIGIT_0 + ((uint16_t)i << 8)) | val));
+    if (dev->fb)
+    {
+        uint8_t val = dev->bcd ? VAL_CLEAR_BCD : VAL_CLEAR_NORMAL;
+        for (uint8_t c = 0; c < dev->cascade_size; c++)
+            for (uint8_t d = 0; d < ALL_DIGITS; d++)
+                if (dev->fb->digits[c][d] != val)
+                {
+                    dev->fb->digits[c][d] = val;
+                    dev->fb->dirty[c] |= 1 << d;
+                }
+        return ESP_OK;
+    }
+
+    return clear_all(dev);
+}
+
+esp_err_t max7219_refresh(max7219_t *dev, bool config)
+{
+    CHECK_ARG(dev);
+
+    if (config)
+    {
+        CHECK(send(dev, ALL_CHIPS, REG_DISPLAY_TEST));
+        CHECK(send(dev, ALL_CHIPS, REG_SCAN_LIMIT | (ALL_DIGITS - 1)));
+        CHECK(send(dev, ALL_CHIPS, REG_DECODE_MODE | (dev->bcd ? 0xff : 0)));
+        CHECK(send(dev, ALL_CHIPS, REG_INTENSITY | dev->brightness));
+        CHECK(send(dev, ALL_CHIPS, REG_SHUTDOWN | !dev->shutdown));
+    }
+    if (dev->fb)
+        memset(dev->fb->dirty, 0xff, sizeof(dev->fb->dirty));
+
+    return ESP_OK;
+}
+
+esp_err_t max7219_enable_framebuffer(max7219_t *dev)
+{
+    CHECK_ARG(dev);
+
+    if (dev->fb)
+        return ESP_OK;
+    dev->fb = calloc(1, sizeof(max7219_fb_t));
+    if (!dev->fb)
+        return ESP_ERR_NO_MEM;
+    // content of the display is unknown -> send everything at first flush
+    memset(dev->fb->dirty, 0xff, sizeof(dev->fb->dirty));
+
+    return ESP_OK;
+}
+
+esp_err_t max7219_flush(max7219_t *dev)
+{
+    CHECK_ARG(dev);
+    if (!dev->fb)
+        return ESP_OK;
+
+    // buffers of the last flush are reused
+    CHECK(wait_pending(dev));
+
+    max7219_fb_t *fb = dev->fb;
+    for (uint8_t frame = 0; frame < ALL_DIGITS; frame++)
+    {
+        // one changed digit per chip, no-op for the others
+        bool changed = false;
+        for (uint8_t c = 0; c < dev->cascade_size; c++)
+        {
+            uint16_t value = REG_NO_OP;
+            if (fb->dirty[c])
+            {
+                uint8_t d = __builtin_ctz(fb->dirty[c]);
+                fb->dirty[c] &= ~(1 << d);
+                value = (REG_DIGIT_0 + ((uint16_t)d << 8)) | fb->digits[c][d];
+                changed = true;
+            }
+            fb->tx[frame][c] = shuffle(value);
+        }
+        if (!changed)
+            break;
+
+        spi_transaction_t *t = &fb->trans[frame];
+        memset(t, 0, sizeof(*t));
+        t->length = dev->cascade_size * 16;
+        t->tx_buffer = fb->tx[frame];
+        CHECK(spi_device_queue_trans(dev->spi_dev, t, portMAX_DELAY));
+        fb->pending++;
+    }
 
     return ESP_OK;
 }
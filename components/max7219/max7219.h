@@ -57,6 +57,18 @@ extern "C" {
 #define MAX7219_MAX_CASCADE_SIZE 8
 #define MAX7219_MAX_BRIGHTNESS   15
 
+/**
+ * Framebuffer with the digit registers of all chips, see max7219_enable_framebuffer()
+ */
+typedef struct
+{
+    uint8_t digits[MAX7219_MAX_CASCADE_SIZE][8];  //!< Register values per chip and digit
+    uint8_t dirty[MAX7219_MAX_CASCADE_SIZE];      //!< Bit per digit changed since last flush
+    uint16_t tx[8][MAX7219_MAX_CASCADE_SIZE];     //!< SPI data of queued cascade updates
+    spi_transaction_t trans[8];                   //!< Queued cascade updates
+    uint8_t pending;                              //!< Transactions queued but not yet finished
+} max7219_fb_t;
+
 /**
  * Display descriptor
  */
@@ -68,6 +80,9 @@ typedef struct
     uint8_t cascade_size;        //!< Up to `MAX7219_MAX_CASCADE_SIZE` MAX721xx cascaded
     bool mirrored;               //!< true for horizontally mirrored displays
     bool bcd;
+    uint8_t brightness;          //!< Set by max7219_set_brightness(), restored by max7219_refresh()
+    bool shutdown;               //!< Set by max7219_set_shutdown_mode(), restored by max7219_refresh()
+    max7219_fb_t *fb;            //!< Framebuffer, NULL if digits are written immediately. Shared by copies of the descriptor
 } max7219_t;
 
 /**
@@ -137,6 +152,45 @@ esp_err_t max7219_set_shutdown_mode(max7219_t *dev, bool shutdown);
  */
 esp_err_t max7219_set_digit(max7219_t *dev, uint8_t digit, uint8_t val);
 
+/**
+ * @brief Enable framebuffer
+ *
+ * Digit writes (max7219_set_digit(), max7219_clear(), max7219_draw_text_7seg(), ...)
+ * only update the framebuffer and mark changed digits dirty. max7219_flush()
+ * sends the dirty digits. Copies of the descriptor share the framebuffer.
+ *
+ * @param dev Display descriptor, initialized by max7219_init_desc()
+ * @return `ESP_OK` on success
+ */
+esp_err_t max7219_enable_framebuffer(max7219_t *dev);
+
+/**
+ * @brief Send changed digits of the framebuffer
+ *
+ * One SPI transaction updates one digit on every chip of the cascade (no-op for
+ * chips without changes), thus the number of transactions is the highest count of
+ * changed digits on one chip. Transactions are queued, the function does not wait
+ * for them to finish (waits for the previous flush only).
+ *
+ * @param dev Display descriptor
+ * @return `ESP_OK` on success
+ */
+esp_err_t max7219_flush(max7219_t *dev);
+
+/**
+ * @brief Send the whole display content again at the next flush
+ *
+ * Registers of the MAX7219 can be corrupted by electrical interference, with the
+ * framebuffer only changed digits are sent. Marks all digits dirty and, if config
+ * is true, writes the configuration registers (scan limit, decode mode, brightness,
+ * shutdown, display test off) immediately without clearing the digits.
+ *
+ * @param dev Display descriptor
+ * @param config Also write the configuration registers
+ * @return `ESP_OK` on success
+ */
+esp_err_t max7219_refresh(max7219_t *dev, bool config);
+
 /**
  * @brief Clear display
  *
@@ -0,0 +1,203 @@
+extern "C" {
+#include <string.h>
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "esp_log.h"
+#include "driver/adc.h"
+}
+#include "config.h"
+#include "adc-service.hpp"
+#include "gpio_adc.hpp"
+
+
+//---------------------
+//--- configuration ---
+//---------------------
+//used macros from config.h:
+//ADC_CONTINUOUS_ENABLED, ADC_CONTINUOUS_SAMPLE_HZ
+//ADC_CHANNEL_POTI, ADC_CHANNEL_4SW_TO_ANALOG, ADC_CHANNEL_SUPPLY_VOLTAGE
+
+//samples per dma frame (all channels), one frame is processed per task wakeup
+//200 samples at 20kHz = 10ms
+#define FRAME_SAMPLES 200
+
+//channels scanned in this order, filtered with value += (sample - value) / 2^filterShift
+typedef struct {
+    adc1_channel_t channel;
+    adc_atten_t atten;
+    uint8_t filterShift;
+} adcChannelConfig_t;
+
+static const adcChannelConfig_t channelConfig[] = {
+    //poti: smooth, slow changes only
+    {ADC_CHANNEL_POTI, ADC_ATTEN_DB_11, 6},
+    //switch ladder: settles within ~1ms, switches are debounced in switchesAnalog.cpp
+    //attenuation was never configured for this channel -> keep hardware default (lookup table is calibrated with it)
+    {ADC_CHANNEL_4SW_TO_ANALOG, ADC_ATTEN_DB_0, 4},
+    //supply voltage: light filtering, fast shutdown detection
+    {ADC_CHANNEL_SUPPLY_VOLTAGE, ADC_ATTEN_DB_11, 2},
+};
+#define CHANNEL_COUNT (sizeof(channelConfig) / sizeof(channelConfig[0]))
+
+
+
+//----------------------
+//----- variables ------
+//----------------------
+static const char *TAG = "adc-service";
+
+//filtered value per adc1 channel, written by adc task only (32 bit -> atomic read)
+static volatile int32_t valueNow[ADC1_CHANNEL_MAX] = {};
+
+//threshold notification per channel
+typedef struct {
+    TaskHandle_t task;
+    int threshold;
+    bool below;
+} belowNotify_t;
+static belowNotify_t belowNotify[ADC1_CHANNEL_MAX] = {};
+
+
+
+#ifdef ADC_CONTINUOUS_ENABLED
+//-----------------------
+//---- processFrame -----
+//-----------------------
+//filter samples of one dma frame, publish values and check thresholds
+static void processFrame(const uint8_t * buf, uint32_t length){
+    //filter state with 8 fractional bits
+    static int32_t filterQ8[ADC1_CHANNEL_MAX] = {};
+    static bool initialized[ADC1_CHANNEL_MAX] = {};
+
+    for (uint32_t i = 0; i + sizeof(adc_digi_output_data_t) <= length; i += sizeof(adc_digi_output_data_t)) {
+        const adc_digi_output_data_t * sample = (const adc_digi_output_data_t *)&buf[i];
+        uint32_t channel = sample->type1.channel;
+        if (channel >= ADC1_CHANNEL_MAX) continue;
+        int32_t valueQ8 = (int32_t)sample->type1.data << 8;
+        //start at first sample instead of ramping up from 0
+        if (!initialized[channel]) {
+            filterQ8[channel] = valueQ8;
+            initialized[channel] = true;
+        }
+        uint8_t shift = 0;
+        for (const adcChannelConfig_t &config : channelConfig) {
+            if (config.channel == channel) shift = config.filterShift;
+        }
+        filterQ8[channel] += (valueQ8 - filterQ8[channel]) >> shift;
+    }
+
+    //publish and check thresholds
+    for (const adcChannelConfig_t &config : channelConfig) {
+        int32_t value = filterQ8[config.channel] >> 8;
+        valueNow[config.channel] = value;
+        belowNotify_t &notify = belowNotify[config.channel];
+        if (notify.task == NULL) continue;
+        if (value < notify.threshold) {
+            if (!notify.below) xTaskNotifyGive(notify.task);
+            notify.below = true;
+        } else {
+            notify.below = false;
+        }
+    }
+}
+
+
+//--------------------
+//---- task_adc ------
+//--------------------
+//read dma frames and process them, blocks while waiting for the next frame
+static void task_adc(void *pvParameter){
+    TaskHandle_t initTask = (TaskHandle_t)pvParameter;
+    static uint8_t buf[FRAME_SAMPLES * sizeof(adc_digi_output_data_t)];
+    while (1) {
+        uint32_t length = 0;
+        esp_err_t err = adc_digi_read_bytes(buf, sizeof(buf), &length, 100);
+        if (err == ESP_ERR_TIMEOUT) {
+            ESP_LOGE(TAG, "no adc data within 100ms");
+            continue;
+        }
+        //ESP_ERR_INVALID_STATE: task was too slow, driver dropped data -> data in buf is still valid
+        if (err != ESP_OK && err != ESP_ERR_INVALID_STATE) {
+            ESP_LOGE(TAG, "read failed: %s", esp_err_to_name(err));
+            continue;
+        }
+        processFrame(buf, length);
+        //signal init that the first values are available
+        if (initTask != NULL) {
+            xTaskNotifyGive(initTask);
+            initTask = NULL;
+        }
+    }
+}
+#endif
+
+
+
+//=======================
+//=== adcService_init ===
+//=======================
+void adcService_init(){
+#ifdef ADC_CONTINUOUS_ENABLED
+    ESP_LOGI(TAG, "starting continuous sampling of %u channels at %dHz", (unsigned)CHANNEL_COUNT, ADC_CONTINUOUS_SAMPLE_HZ);
+    uint32_t channelMask = 0;
+    adc_digi_pattern_config_t pattern[CHANNEL_COUNT] = {};
+    for (size_t i = 0; i < CHANNEL_COUNT; i++) {
+        channelMask |= 1 << channelConfig[i].channel;
+        pattern[i].atten = channelConfig[i].atten;
+        pattern[i].channel = channelConfig[i].channel;
+        pattern[i].unit = 0; //ADC1 (esp32: unit index 0)
+        pattern[i].bit_width = 12;
+    }
+    adc_digi_init_config_t initConfig = {};
+    initConfig.max_store_buf_size = 4 * FRAME_SAMPLES * sizeof(adc_digi_output_data_t);
+    initConfig.conv_num_each_intr = FRAME_SAMPLES * sizeof(adc_digi_output_data_t);
+    initConfig.adc1_chan_mask = channelMask;
+    initConfig.adc2_chan_mask = 0;
+    ESP_ERROR_CHECK(adc_digi_initialize(&initConfig));
+
+    adc_digi_configuration_t config = {};
+    config.conv_limit_en = true; //required on esp32
+    config.conv_limit_num = 250;
+    config.pattern_num = CHANNEL_COUNT;
+    config.adc_pattern = pattern;
+    config.sample_freq_hz = ADC_CONTINUOUS_SAMPLE_HZ;
+    config.conv_mode = ADC_CONV_SINGLE_UNIT_1;
+    config.format = ADC_DIGI_OUTPUT_FORMAT_TYPE1;
+    ESP_ERROR_CHECK(adc_digi_controller_configure(&config));
+    ESP_ERROR_CHECK(adc_digi_start());
+
+    //higher priority than consumers, processing one frame is short
+    xTaskCreate(task_adc, "task_adc", 2048, xTaskGetCurrentTaskHandle(), 5, NULL);
+    if (ulTaskNotifyTake(pdTRUE, pdMS_TO_TICKS(500)) == 0) {
+        ESP_LOGE(TAG, "timeout waiting for first adc values");
+    }
+#else
+    adc1_config_width(ADC_WIDTH_BIT_12); //=> max resolution 4096
+    adc1_config_channel_atten(ADC_CHANNEL_POTI, ADC_ATTEN_DB_11); //max voltage
+    adc1_config_channel_atten(ADC_CHANNEL_SUPPLY_VOLTAGE, ADC_ATTEN_DB_11); //max voltage
+#endif
+}
+
+
+
+//======================
+//=== adcService_get ===
+//======================
+int adcService_get(adc1_channel_t channel){
+#ifdef ADC_CONTINUOUS_ENABLED
+    return valueNow[channel];
+#else
+    return gpio_readAdc(channel);
+#endif
+}
+
+
+
+//==============================
+//=== adcService_notifyBelow ===
+//==============================
+void adcService_notifyBelow(adc1_channel_t channel, int threshold, TaskHandle_t task){
+    belowNotify[channel].threshold = threshold;
+    belowNotify[channel].below = false;
+    belowNotify[channel].task = task;
+}
@@ -0,0 +1,22 @@
+#pragma once
+extern "C" {
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "driver/adc.h"
+}
+
+//background sampling of all used adc1 channels (poti, 4-switch ladder, supply voltage)
+//ADC_CONTINUOUS_ENABLED: the adc scans all channels continuously (dma), a task filters each
+//channel (iir) and publishes the latest value. Reading a value does not touch the adc.
+//Otherwise values are read synchronously with gpio_readAdc() (32 samples, blocking).
+
+//configure adc, start sampling and wait for the first values
+void adcService_init();
+
+//latest filtered value of channel (0-4095)
+int adcService_get(adc1_channel_t channel);
+
+//notify task (xTaskNotifyGive) as soon as the filtered value of channel drops below threshold
+//the task is notified again only after the value was above the threshold in between
+//without ADC_CONTINUOUS_ENABLED the task is never notified and has to poll adcService_get()
+void adcService_notifyBelow(adc1_channel_t channel, int threshold, TaskHandle_t task);
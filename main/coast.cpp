@@ -0,0 +1,261 @@
+extern "C" {
+#include "freertos/FreeRTOS.h"
+#include "esp_log.h"
+#include "nvs_flash.h"
+#include "nvs.h"
+}
+#include <cmath>
+#include "config.h"
+#include "coast.hpp"
+#include "vfd.hpp"
+#include "encoder.hpp"
+#include "params.hpp"
+
+
+//---------------------
+//--- configuration ---
+//---------------------
+//used macros from config.h:
+//COAST_DOWNSHIFT_FACTOR, COAST_LEARN_MIN_SPEED, COAST_LEARN_RATE
+
+#define STOPPED_TIMEOUT_MS 300      //reel is considered stopped when length did not change for that time
+#define SETTLE_TIME_MS 1500         //time after level change until speed is considered steady
+#define SPEED_LEARN_RATE 0.02       //weight of each speed sample while running steady
+#define NVS_KEY "coastModel"
+
+//remaining length thresholds for levels 1-3 used until the level is learned (previous fixed values)
+static const paramId_t thresholdDefault[4] = {PARAM_COUNT, PARAM_LEVEL1_BELOW, PARAM_LEVEL2_BELOW, PARAM_LEVEL3_BELOW};
+
+
+
+//----------------------
+//----- variables ------
+//----------------------
+static const char *TAG = "coast";
+
+//learned model stored in nvs
+typedef struct {
+    float coastMs[4];   //coast distance per speed at vfd off (mm / mm/s * 1000), 0 = not learned
+    float speed[4];     //steady speed at level in mm/s, 0 = not learned
+} coastModel_t;
+static coastModel_t model = {};
+static nvs_handle_t nvsHandle = 0;
+//coast time learned, written to nvs by the persist task (coast_persist), not by the control task
+static volatile bool modelChanged = false;
+
+//speed measured by encoder at last handle call
+static float speedNow = 0;
+static float accelNow = 0;
+
+//cable speed per percent vfd frequency, learned while running steady (analog speed reference)
+static float speedPerPercent = (float)VFD_ANALOG_MAX_SPEED / 100;
+
+//tracking of vfd state
+static bool vfdOnPrev = false;
+static uint8_t levelPrev = 0;
+static float percentPrev = 0;
+static uint32_t timestamp_levelChanged = 0;
+static int lengthPrev = 0;
+static uint32_t timestamp_lengthChanged = 0;
+
+//current coast observation
+static bool coasting = false;
+static uint8_t coastLevel = 0;
+static float coastStartSpeed = 0;
+static int coastStartLengthMm = 0;
+
+
+
+//---------------------------
+//----- local functions -----
+//---------------------------
+//evaluate finished coast and update model of that level
+static void learnCoast(int lengthNowMm){
+    int coastMm = lengthNowMm - coastStartLengthMm;
+    float coastMs = coastMm * 1000 / coastStartSpeed;
+    float &learned = model.coastMs[coastLevel];
+    float old = learned;
+    learned = (learned == 0) ? coastMs : learned + (coastMs - learned) * COAST_LEARN_RATE;
+    ESP_LOGW(TAG, "level %d: coasted %dmm from %.0fmm/s -> %.0fms, model %.0fms -> %.0fms (steady speed %.0fmm/s)",
+            coastLevel, coastMm, coastStartSpeed, coastMs, old, learned, model.speed[coastLevel]);
+    modelChanged = true;
+}
+
+
+
+//==========================
+//======= coast_init =======
+//==========================
+void coast_init(){
+    esp_err_t err = nvs_open("storage", NVS_READWRITE, &nvsHandle);
+    if (err != ESP_OK) {
+        ESP_LOGE(TAG, "nvs: failed opening (%s), model will not be stored", esp_err_to_name(err));
+        nvsHandle = 0;
+        return;
+    }
+    size_t length = sizeof(model);
+    err = nvs_get_blob(nvsHandle, NVS_KEY, &model, &length);
+    if (err != ESP_OK || length != sizeof(model)) {
+        ESP_LOGW(TAG, "no learned model in nvs (%s) -> using default thresholds", esp_err_to_name(err));
+        model = {};
+        return;
+    }
+    for (int i = 0; i < 4; i++) {
+        ESP_LOGI(TAG, "loaded level %d: coast %.0fms, speed %.0fmm/s", i, model.coastMs[i], model.speed[i]);
+    }
+}
+
+
+
+//===========================
+//====== coast_persist ======
+//===========================
+void coast_persist(){
+    if (!modelChanged || nvsHandle == 0) return;
+    //clear first: a coast learned while writing is stored at the next call
+    modelChanged = false;
+    coastModel_t copy = model; //floats are written one at a time by the control task
+    esp_err_t err = nvs_set_blob(nvsHandle, NVS_KEY, &copy, sizeof(copy));
+    if (err == ESP_OK) err = nvs_commit(nvsHandle);
+    if (err != ESP_OK) ESP_LOGE(TAG, "nvs: failed storing model (%s)", esp_err_to_name(err));
+}
+
+
+
+//==========================
+//====== coast_handle ======
+//==========================
+void coast_handle(int lengthNowMm){
+    uint32_t now = esp_log_timestamp();
+    encoderMotion_t motion = encoder_getMotion();
+    speedNow = motion.speedMmPerS;
+    accelNow = motion.accelMmPerS2;
+    if (lengthNowMm != lengthPrev) {
+        lengthPrev = lengthNowMm;
+        timestamp_lengthChanged = now;
+    }
+
+    bool vfdOn = vfd_getState();
+    uint8_t level = vfd_getSpeedLevel();
+    float percent = vfd_getSpeedPercent();
+    if (level != levelPrev || vfdOn != vfdOnPrev || percent != percentPrev) {
+        timestamp_levelChanged = now;
+    }
+    percentPrev = percent;
+
+    //--- learn steady speed of level ---
+    if (vfdOn && now - timestamp_levelChanged > SETTLE_TIME_MS && speedNow > 0) {
+        float &speed = model.speed[level];
+        speed = (speed == 0) ? speedNow : speed + (speedNow - speed) * SPEED_LEARN_RATE;
+        if (percent > 0) speedPerPercent += (speedNow / percent - speedPerPercent) * SPEED_LEARN_RATE;
+    }
+
+    //--- vfd turned off -> start observing coast ---
+    if (vfdOnPrev && !vfdOn) {
+        coasting = true;
+        coastLevel = levelPrev;
+        coastStartSpeed = speedNow;
+        coastStartLengthMm = lengthNowMm;
+        ESP_LOGI(TAG, "vfd off at %dmm, %.0fmm/s level %d, predicted coast %dmm",
+                lengthNowMm, speedNow, levelPrev, (int)(model.coastMs[levelPrev] * speedNow / 1000));
+    }
+    //--- coasting ---
+    else if (coasting) {
+        //vfd on again or length reset -> measurement invalid
+        if (vfdOn || lengthNowMm < coastStartLengthMm - 2) {
+            ESP_LOGW(TAG, "coast observation aborted");
+            coasting = false;
+        }
+        //stopped
+        else if (now - timestamp_lengthChanged > STOPPED_TIMEOUT_MS) {
+            coasting = false;
+            if (coastStartSpeed >= COAST_LEARN_MIN_SPEED) {
+                learnCoast(lengthNowMm);
+            }
+        }
+    }
+    vfdOnPrev = vfdOn;
+    levelPrev = level;
+}
+
+
+
+//===========================
+//==== coast_isCoasting =====
+//===========================
+bool coast_isCoasting(){
+    return coasting;
+}
+
+
+
+//===========================
+//===== coast_getSpeed ======
+//===========================
+float coast_getSpeed(){
+    return speedNow;
+}
+
+
+
+//===========================
+//=== coast_predictStopMm ===
+//===========================
+int coast_predictStopMm(){
+    if (speedNow <= 0) return 0;
+    return model.coastMs[vfd_getSpeedLevel()] * speedNow / 1000;
+}
+
+
+
+//==================================
+//=== coast_predictOffDistanceMm ===
+//==================================
+int coast_predictOffDistanceMm(int lengthRemainingMm){
+    float coastS = model.coastMs[vfd_getSpeedLevel()] / 1000;
+    if (speedNow <= 0 || coastS <= 0) return lengthRemainingMm;
+    //speed after distance d: v + a * d / v -> remaining - d = coastS * (v + a * d / v)
+    float divisor = 1 + coastS * accelNow / speedNow;
+    if (divisor < 0.5) divisor = 0.5; //limit extrapolation
+    if (divisor > 2) divisor = 2;
+    return (lengthRemainingMm - coastS * speedNow) / divisor;
+}
+
+
+
+//=============================
+//=== coast_getSpeedPercent ===
+//=============================
+float coast_getSpeedPercent(int lengthRemainingMm, float percentMax){
+    float stopSpeed = param_getInt(PARAM_PROFILE_STOP_SPEED);
+    float decel = param_getInt(PARAM_PROFILE_DECEL);
+    //vfd is turned off the coast distance before the target (level the stop speed belongs to)
+    uint8_t stopLevel = vfd_percentToLevel(stopSpeed / speedPerPercent);
+    float offMm = model.coastMs[stopLevel] * stopSpeed / 1000;
+    //v^2 = v_stop^2 + 2 * a * distance
+    float distanceMm = lengthRemainingMm - offMm;
+    float speed = sqrtf(stopSpeed * stopSpeed + 2 * decel * (distanceMm > 0 ? distanceMm : 0));
+    float percent = speed / speedPerPercent;
+    return percent > percentMax ? percentMax : percent;
+}
+
+
+
+//===========================
+//=== coast_getSpeedLevel ===
+//===========================
+uint8_t coast_getSpeedLevel(int lengthRemainingMm, uint8_t lvlMax){
+    uint8_t lvl = 0;
+    float coastMs = 0;
+    //highest level that can still be slowed down from in time
+    for (uint8_t i = 1; i <= 3; i++) {
+        //levels the machine never stopped from use coast time of the next slower level
+        if (model.coastMs[i] > 0) coastMs = model.coastMs[i];
+        int threshold = param_getInt(thresholdDefault[i]);
+        if (coastMs > 0 && model.speed[i] > 0) {
+            threshold = COAST_DOWNSHIFT_FACTOR * coastMs * model.speed[i] / 1000;
+        }
+        if (lengthRemainingMm >= threshold) lvl = i;
+    }
+    return lvl > lvlMax ? lvlMax : lvl;
+}
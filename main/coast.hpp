@@ -0,0 +1,40 @@
+#pragma once
+#include <stdint.h>
+
+//predictive stop of the reel
+//After the vfd is turned off the reel coasts for a distance that depends on speed level and speed.
+//The coast time (coast distance / speed at vfd off) and the steady speed of each level are
+//learned from every stop and stored in nvs by the persist task. The control task uses the model to
+//turn the motor off before the target is reached and to select the speed level.
+
+//load learned model from nvs (nvs has to be initialized already)
+void coast_init();
+
+//write the model to nvs when a coast was learned since the last call (persist task, blocks during nvs commit)
+void coast_persist();
+
+//measure cable speed and learn from coasting after vfd was turned off
+//has to be called repeatedly (control loop) with the current length
+void coast_handle(int lengthNowMm);
+
+//true while the reel still moves after the vfd was turned off
+bool coast_isCoasting();
+
+//cable speed in mm/s at last coast_handle() call (see encoder_getSpeed)
+float coast_getSpeed();
+
+//distance in mm the reel would coast when turning the vfd off now (0 when not learned yet)
+int coast_predictStopMm();
+
+//distance in mm the reel can still be driven before the vfd has to be turned off to stop at
+//lengthRemainingMm, the speed until then is extrapolated with the current acceleration
+//(the reel slows down to the new level before the stop), used to watch the stop length in the encoder isr
+int coast_predictOffDistanceMm(int lengthRemainingMm);
+
+//vfd frequency in percent to use for the remaining length, limited to percentMax (VFD_CONTINUOUS_SPEED)
+//continuous profile: highest speed the reel can slow down from with PARAM_PROFILE_DECEL to
+//PARAM_PROFILE_STOP_SPEED until the vfd is turned off (coast distance at stop speed before target)
+float coast_getSpeedPercent(int lengthRemainingMm, float percentMax = 100);
+
+//speed level (0-3) to use for the remaining length, limited to lvlMax
+uint8_t coast_getSpeedLevel(int lengthRemainingMm, uint8_t lvlMax = 3);
@@ -13,6 +13,7 @@
 #define GPIO_VFD_D0 GPIO_NUM_2      //ST2
 #define GPIO_VFD_D1 GPIO_NUM_15     //ST1
 //#define GPIO_VFD_D2 GPIO_NUM_15     //ST1 (D2 only used with 7.5kw vfd)
+#define GPIO_VFD_ANALOG GPIO_VFD_D0 //ST2 pwm to rc filter + 0-10V amplifier (only with VFD_ANALOG_SPEED)
 
 #define GPIO_MOS1 GPIO_NUM_18       //mos1 (free) 2022.02.28: pin used for stepper
 #define GPIO_LAMP GPIO_NUM_0        //mos2 (5) 2022.02.28: lamp disabled, pin used for stepper
@@ -37,6 +38,11 @@
 //ADC1_CHANNEL_6 gpio_34
 //ADC1_CHANNEL_3 gpio_39
 
+//sample all adc channels continuously (dma) in the background instead of blocking reads (see adc-service.cpp)
+//comment out to use synchronous reads (gpio_readAdc) and polling in shutdown task
+#define ADC_CONTINUOUS_ENABLED
+#define ADC_CONTINUOUS_SAMPLE_HZ 20000 //all channels together
+
 
 //=====================================
 //==== assign switches to objects =====
@@ -54,6 +60,12 @@
 //#define ? sw_gpio_34
 //note: actual objects are created in global.cpp
 
+//detect edges of the gpio switches by interrupt and debounce them in a separate task
+//(components/gpio/gpio_inputEvents.hpp) instead of polling the pins in every handle() call
+//comment out to poll all switches
+#define INPUTS_INTERRUPT_DRIVEN
+#define INPUTS_TASK_PRIORITY 5 //above control task, below shutdown detection
+
 
 
 
@@ -73,6 +85,10 @@
 #define DISPLAY_PIN_NUM_CS GPIO_NUM_27
 #define DISPLAY_DELAY 2000
 #define DISPLAY_BRIGHTNESS 8
+//only changed digits are sent: resend all digits / the configuration registers this often
+//(corrects registers of the MAX7219 corrupted by interference from vfd and relays)
+#define DISPLAY_REFRESH_MS 1000
+#define DISPLAY_CONFIG_REFRESH_MS 10000
 
 //--------------------------
 //----- encoder config -----
@@ -81,6 +97,12 @@
 #define ROT_ENC_B_GPIO GPIO_NUM_21
 #define ENABLE_HALF_STEPS false  // Set to true to enable tracking of rotary encoder at half step resolution
 #define FLIP_DIRECTION    false  // Set to true to reverse the clockwise/counterclockwise sense
+//count encoder edges with the pulse counter (PCNT) instead of a gpio interrupt per edge
+//the isr then only runs every ENCODER_PCNT_EVENT_STEPS steps (timestamps for speed, guide notification)
+#define ENCODER_PCNT_ENABLED
+#define ENCODER_PCNT_UNIT PCNT_UNIT_0
+#define ENCODER_PCNT_FILTER 800      //apb cycles (80MHz) - ignore pulses shorter than 10us (max 1023)
+#define ENCODER_PCNT_EVENT_STEPS 2   //steps between two interrupts
 
 
 
@@ -96,8 +118,15 @@
 #define STEPPER_STEPS_PER_MM	(200/2)	//steps/mm (steps-per-rot / spindle-slope)
 #define STEPPER_SPEED_DEFAULT	25		//mm/s
 #define STEPPER_SPEED_MIN		4		//mm/s  - speed threshold at which stepper immediately starts/stops
-#define STEPPER_ACCEL_INC		3		//steps/s increment per cycle 
-#define STEPPER_DECEL_INC		7		//steps/s decrement per cycle
+#define STEPPER_SPEED_MAX		70		//mm/s  - highest speed the acceleration table is calculated for
+#define STEPPER_ACCEL			40		//mm/s^2 - linear acceleration (previously ~3 steps/s increment per step)
+#define STEPPER_DECEL			80		//mm/s^2 - linear deceleration (previously ~7 steps/s decrement per step)
+//step pulse generation
+//STEPPER_PULSE_RMT: step pulse is generated by the RMT peripheral, timer isr only triggers it
+//comment out to generate the pulse by toggling the pin in the timer isr (busy waits STEPPER_PULSE_US)
+#define STEPPER_PULSE_RMT
+#define STEPPER_RMT_CHANNEL		RMT_CHANNEL_0
+#define STEPPER_PULSE_US		10		//us - length of step pulse (high)
 //options affecting movement are currently defined in guide-stepper.cpp
 
 
@@ -115,6 +144,16 @@
 #define LAYER_THICKNESS_MM 5         // height of one cable layer on reel -> increase in radius every layer
 #define D_CABLE 6                    // determines winds per layer / guide speed
 #define D_REEL 160                   // start diameter of empty reel
+// encoder steps counted before the encoder isr wakes the guide task
+// guide moves at least 2 steps at once, 2 guide steps = ~1.7mm cable = ~3.6 encoder steps on empty reel
+#define GUIDE_ENCODER_NOTIFY_STEPS 4
+// velocity following: guide speed is continuously set from cable speed * D_CABLE / (PI * diameter)
+// and the target position is kept ahead of the ideal position, thus the guide moves continuously
+// and reverses at the winding edges without waiting for a full stop
+// comment out to move the guide in discrete bursts of the counted steps instead
+#define GUIDE_VELOCITY_FOLLOWING
+#define GUIDE_FOLLOW_LEAD_MS 100  // target is ahead of the ideal position by the distance moved in this time
+#define GUIDE_FOLLOW_GAIN 4.0     // 1/s - speed added per step the guide lags behind the ideal position
 
 // max winding width that can be set using potentiometer (SET+PRESET1 buttons)
 #define MAX_SELECTABLE_WINDING_WIDTH_MM 100;
@@ -129,23 +168,155 @@
 //--------------------------
 //------ calibration -------
 //--------------------------
-//enable mode  encoder test for calibration (determine ENCODER_STEPS_PER_METER)
-//if defined, displays always show length and steps instead of the normal messages
-//#define ENCODER_TEST
-//TODO: add way to calibrate without flashing -> enter calibration mode with certain button sequence, enter steps-per-meter with poti, store in nvs
-
-//steps per meter
-//this value is determined experimentally while ENCODER_TEST is enabled
+//calibration mode (determines encoder steps per meter, stored as parameter encStepsPerM in nvs):
+//hold SET + PRESET3 -> length is reset, hold START to wind a reference length slowly,
+//hold SET and enter the true length with poti, PRESET1 stores the result, PRESET3 cancels
+#define CALIBRATION_ENTER_MS 2000       //time SET + PRESET3 have to be held
+#define CALIBRATION_RANGE_PERCENT 10    //poti range for true length: measured length +-10%
+#define CALIBRATION_MIN_LENGTH_MM 1000  //shorter reference lengths are too inaccurate
+
+//steps per meter (default, calibrated value is stored in nvs)
 //#define ENCODER_STEPS_PER_METER 2127 //until 2024.03.13 roll-v3-gummi-86.6mm - d=89.8mm
 #define ENCODER_STEPS_PER_METER 2118 //2024.03.13 roll-v3-gummi measured 86.5mm
 
+//--- slip correction (slip.cpp) ---
+//length correction in percent depending on cable speed, one table per cable profile (stored in nvs)
+//comment out to use encStepsPerM only
+#define ENCODER_SLIP_CORRECTION
+#define SLIP_SPEED_POINTS {0, 250, 700, 1400} //mm/s, about the speed of the vfd speed levels
+#define SLIP_PROFILE_COUNT 4
+#define SLIP_PERCENT_MAX 10
+
 //millimeters added to target length
 //to ensure that length does not fall short when spool slightly rotates back after stop
 #define TARGET_LENGTH_OFFSET 0
 
+//--- predictive stop (coast.cpp) ---
+//the distance the reel coasts after vfd off is learned per speed level and stored in nvs,
+//the motor is turned off that distance before the target is reached
+#define COAST_MODEL_ENABLED
+//a speed level is used while the remaining length is more than factor * coast distance of that level
+#define COAST_DOWNSHIFT_FACTOR 2.0
+//slowest speed at vfd off a stop is learned from (mm/s)
+#define COAST_LEARN_MIN_SPEED 20
+//weight of a new measurement (0-1)
+#define COAST_LEARN_RATE 0.4
+
+//--- vfd speed reference (vfd.cpp) ---
+//frequency of speed levels 0-3 in percent of the max frequency (multi-speed presets in the vfd)
+#define VFD_LEVEL_PERCENT {4.3, 17.9, 50, 100}
+//VFD_ANALOG_SPEED: set the frequency through the analog input of the vfd instead of selecting a preset
+//with D0/D1: ledc pwm on GPIO_VFD_ANALOG, rc low pass and amplifier to 0-10V (vfd frequency source = AI).
+//While winding the speed then follows a continuous deceleration profile (coast_getSpeedPercent)
+//comment out to use the digital speed levels
+//#define VFD_ANALOG_SPEED
+#define VFD_PWM_FREQUENCY_HZ 5000
+#define VFD_PWM_RESOLUTION LEDC_TIMER_10_BIT
+#define VFD_PWM_BITS 10
+//cable speed at 100% until learned while winding steady (mm/s)
+#define VFD_ANALOG_MAX_SPEED 1400
+//defaults of the profile parameters (params.hpp)
+#define VFD_PROFILE_DECEL 1500      //mm/s2 deceleration the profile is planned with
+#define VFD_PROFILE_STOP_SPEED 250  //mm/s speed the vfd is turned off at
+
+//--- vfd modbus (vfd.cpp, modbus-rtu.cpp) ---
+//VFD_MODBUS: set the frequency reference over rs485 (modbus rtu, registers of T13-750W see docs/vfd/)
+//and read back output frequency, current and run state. Run/stop stay on the FWD/REV terminals
+//(stop from encoder isr), vfd: run command source = terminals, frequency source = communication.
+//Enables the continuous deceleration profile like VFD_ANALOG_SPEED and the stall / empty spool
+//detection from the motor current (control.cpp). Rs485 transceiver on the D0/D1 outputs.
+//comment out to use the digital speed levels
+//#define VFD_MODBUS
+#define VFD_MODBUS_UART UART_NUM_2
+#define GPIO_VFD_MODBUS_TX GPIO_VFD_D0
+#define GPIO_VFD_MODBUS_RX GPIO_VFD_D1
+#define GPIO_VFD_MODBUS_DE UART_PIN_NO_CHANGE //driver enable, UART_PIN_NO_CHANGE: auto direction transceiver
+#define VFD_MODBUS_BAUD 9600
+#define VFD_MODBUS_SLAVE_ID 1
+#define VFD_MODBUS_TIMEOUT_MS 100
+//one write (reference changed) and one batch read of all feedback registers per period,
+//a read of registers 2-10 takes ~35ms at 9600 baud, thus not every control cycle
+#define VFD_MODBUS_PERIOD_MS 50
+//feedback older than this is invalid (control stops winding)
+#define VFD_MODBUS_FEEDBACK_MAX_AGE_MS 500
+//consecutive failed reads logged as communication lost
+#define VFD_MODBUS_LOST_READS 3
+#define VFD_MODBUS_TASK_PRIORITY 3
+//frequency at 100% speed reference (Hz)
+#define VFD_MAX_FREQUENCY_HZ 50
+//registers (T13 spec v1.3): frequency 0.1Hz (write: reference, read: output), run state 1=fwd 2=stop 3=rev,
+//bus voltage 0.1V, current 0.01A, temperature 1C. Read as one block from frequency to temperature.
+#define VFD_REG_FREQUENCY 2
+#define VFD_REG_RUN_STATE 3
+#define VFD_REG_VOLTAGE 8
+#define VFD_REG_CURRENT 9
+#define VFD_REG_TEMPERATURE 10
+//the T13 spec lists no fault code register (4-7 spare), define for a vfd that reports one in the block
+//without it a fault is detected when the vfd reports stop while the run terminal is on
+//#define VFD_REG_FAULT 4
+
+//--- stall / empty spool detection (control.cpp, VFD_MODBUS) ---
+//cable does not move while the vfd runs: high current = reel or cable blocked, low current = supply
+//spool empty (cable end passed the encoder, reel turns freely). Thresholds are parameters (params.hpp)
+#define VFD_STALL_CURRENT 2.0    //A above this: stall (also while moving)
+#define VFD_IDLE_CURRENT 0.6     //A below this: motor without cable load
+#define VFD_LOAD_CHECK_DELAY_MS 1500 //after vfd start (acceleration)
+#define VFD_LOAD_FAULT_MS 500    //condition has to persist this long
+#define VFD_LOAD_MIN_FREQUENCY 5 //Hz output frequency, below the cable may stand still
+#define VFD_LOAD_MOVING_SPEED 20 //mm/s cable speed considered moving
+
+#if defined(VFD_ANALOG_SPEED) && defined(VFD_MODBUS)
+#error "VFD_ANALOG_SPEED and VFD_MODBUS both set the frequency reference, enable only one"
+#endif
+//frequency reference is set in percent instead of selecting speed levels
+#if defined(VFD_ANALOG_SPEED) || defined(VFD_MODBUS)
+#define VFD_CONTINUOUS_SPEED
+#endif
+
+//--- stop in encoder isr (control.cpp, encoder.cpp) ---
+//the encoder isr turns the vfd off as soon as the stop length is passed (watched position, checked
+//every ENCODER_PCNT_EVENT_STEPS) instead of the control task at its next run
+//comment out to only wake the control task at the stop length
+#define TARGET_TRIP_IN_ISR
+//the isr and the vfd outputs run from flash: while flash is written or erased the cache is disabled and
+//the isr is held off (sector erase ~45ms). Thus the persist task does not access the flash while the
+//vfd runs, journal records, erasing ahead and nvs commits (parameters, slip tables, coast model) wait
+//until the vfd is off (persist.cpp). Remaining delay of the trip:
+//- record written at power loss or when the voltage recovered: programming only, <1ms
+//- erase started right before the vfd was turned on: up to one sector erase
+
 //millimeters lengthNow can be below lengthTarget to still stay in target_reached state
 #define TARGET_REACHED_TOLERANCE 5
 
+//--- pipelined cut cycle (control.cpp, cutter.cpp) ---
+//auto-cut countdown ends when the reel stands still and the cutter is idle, but not before
+//AUTO_CUT_DELAY_MIN_MS (instead of the full countdown). Control continues as soon as the blade
+//passed the cable, the next piece can be started while the blade returns to idle position.
+#define AUTO_CUT_PIPELINED
+#define AUTO_CUT_DELAY_MIN_MS 800
+//blade passed the cable after this fraction of the time the cutter position switch is closed
+//(the cable is cut at about half the cycle, duration is learned from previous cuts)
+#define CUTTER_CLEAR_FRACTION 0.65
+
+//--- production jobs (control.cpp) ---
+//number of jobs (length, count, winding width) that can be queued
+#define JOB_QUEUE_LENGTH 8
+
+//--- control cycle (control.cpp) ---
+//the control task waits for events (switch edges, length reached, cutter, timer, power fail)
+//and runs at least every CONTROL_CYCLE_MS while the machine is active (winding, cutting, switch
+//held, display blinking). While waiting for the operator it only runs every CONTROL_IDLE_CYCLE_MS
+//(scans the analog switches, updates the displays). Set both equal for a fixed cycle.
+#define CONTROL_CYCLE_MS 10
+#define CONTROL_IDLE_CYCLE_MS 50
+#define CONTROL_EVENT_QUEUE_LENGTH 16
+
+
 
 
 
+//--- telemetry (telemetry.cpp, console.cpp) ---
+//records of the last cut pieces kept in RAM (76 bytes each)
+#define TELEMETRY_RING_LENGTH 64
+//uart the console commands are read from (same as log output)
+#define CONSOLE_UART UART_NUM_0
@@ -0,0 +1,203 @@
+extern "C"
+{
+#include <stdio.h>
+#include <string.h>
+#include <stdlib.h>
+#include <freertos/FreeRTOS.h>
+#include <freertos/task.h>
+#include "esp_log.h"
+#include "driver/uart.h"
+}
+
+#include "config.h"
+#include "console.hpp"
+#include "telemetry.hpp"
+#include "params.hpp"
+#include "slip.hpp"
+#include "vfd.hpp"
+#include "control.hpp"
+
+
+//---------------------
+//--- configuration ---
+//---------------------
+#define CONSOLE_LINE_LENGTH 64
+#define CONSOLE_RX_BUFFER 256
+
+
+
+//----------------------
+//----- variables ------
+//----------------------
+static const char *TAG = "console";
+
+
+
+//----------------------
+//----- commands -------
+//----------------------
+static void cmd_telemetry(const char *args){
+    if (strcmp(args, "clear") == 0) {
+        telemetry_clear();
+        printf("telemetry cleared\n");
+    } else {
+        telemetry_printCsv(stdout);
+    }
+}
+
+static void cmd_param(const char *args){
+    //--- list all ---
+    if (*args == '\0') {
+        for (int i = 0; i < PARAM_COUNT; i++) param_print(stdout, (paramId_t)i);
+        return;
+    }
+    //--- split name and value ---
+    char name[24];
+    const char *value = strchr(args, ' ');
+    size_t nameLength = value ? (size_t)(value - args) : strlen(args);
+    if (nameLength >= sizeof(name)) nameLength = sizeof(name) - 1;
+    memcpy(name, args, nameLength);
+    name[nameLength] = '\0';
+    paramId_t id = param_find(name);
+    if (id == PARAM_COUNT) {
+        printf("unknown parameter '%s', try 'param'\n", name);
+        return;
+    }
+    while (value != NULL && *value == ' ') value++;
+    //--- get / reset / set ---
+    if (value == NULL || *value == '\0') {
+        param_print(stdout, id);
+        return;
+    } else if (strcmp(value, "default") == 0) {
+        param_reset(id);
+    } else {
+        char *end;
+        float number = strtof(value, &end);
+        if (end == value || *end != '\0') {
+            printf("invalid value '%s'\n", value);
+            return;
+        }
+        if (!param_set(id, number)) {
+            printf("value %s out of bounds\n", value);
+        }
+    }
+    param_print(stdout, id);
+}
+
+static void cmd_slip(const char *args){
+    if (*args != '\0') {
+        char *value, *end;
+        long point = strtol(args, &value, 10);
+        float percent = strtof(value, &end);
+        if (end == value || *end != '\0' || !slip_setPoint(point, percent)) {
+            printf("invalid point or value, usage: slip <point> <percent>\n");
+        }
+    }
+    slip_print(stdout);
+}
+
+static void cmd_job(const char *args){
+    if (strncmp(args, "add", 3) == 0 && (args[3] == ' ' || args[3] == '\0')) {
+        int lengthMm, count, widthMm = 0;
+        int parsed = sscanf(args + 3, "%d %d %d", &lengthMm, &count, &widthMm);
+        if (parsed < 2 || widthMm < 0 || widthMm > 255 || !control_addJob(lengthMm, count, widthMm)) {
+            printf("invalid values or queue full, usage: job add <lengthMm> <count> [widthMm]\n");
+            return;
+        }
+    } else if (strcmp(args, "clear") == 0) {
+        control_clearJobs();
+        printf("jobs cleared\n");
+        return;
+    } else if (*args != '\0' && strcmp(args, "list") != 0) {
+        printf("usage: job [list | add <lengthMm> <count> [widthMm] | clear]\n");
+        return;
+    }
+    //--- list ---
+    controlJob_t list[JOB_QUEUE_LENGTH];
+    int count = control_getJobs(list, JOB_QUEUE_LENGTH);
+    int active = control_getActiveJob();
+    if (count == 0) printf("no jobs\n");
+    for (int i = 0; i < count; i++) {
+        printf("%c%d: %dmm x %d, width %dmm, done %d\n", i == active ? '*' : ' ', i,
+                list[i].lengthMm, list[i].count, list[i].windingWidthMm, list[i].done);
+    }
+}
+
+static void cmd_vfd(const char *args){
+    vfd_printFeedback(stdout);
+}
+
+static void cmd_help(const char *args);
+
+typedef struct {
+    const char *name;
+    void (*handler)(const char *args);
+    const char *help;
+} consoleCommand_t;
+
+static const consoleCommand_t commands[] = {
+    {"telemetry", cmd_telemetry, "[clear] - print records of the last pieces as csv"},
+    {"param", cmd_param, "[name [value|default]] - list, get, set or reset runtime parameters"},
+    {"slip", cmd_slip, "[point percent] - show or change length correction of active cable profile"},
+    {"job", cmd_job, "[list | add <lengthMm> <count> [widthMm] | clear] - show or change the production job queue"},
+    {"vfd", cmd_vfd, "- show vfd feedback (frequency, current, run state) and modbus statistics"},
+    {"help", cmd_help, "- list commands"},
+};
+
+static void cmd_help(const char *args){
+    for (const consoleCommand_t &command : commands) {
+        printf("%s %s\n", command.name, command.help);
+    }
+}
+
+
+
+//-----------------------
+//--- executeLine -------
+//-----------------------
+//split line into command name and arguments and run the matching handler
+static void executeLine(char *line){
+    char *args = strchr(line, ' ');
+    if (args != NULL) {
+        *args++ = '\0';
+        while (*args == ' ') args++;
+    } else {
+        args = line + strlen(line);
+    }
+    if (*line == '\0') return;
+    for (const consoleCommand_t &command : commands) {
+        if (strcmp(line, command.name) == 0) {
+            command.handler(args);
+            fflush(stdout);
+            return;
+        }
+    }
+    printf("unknown command '%s', try 'help'\n", line);
+}
+
+
+
+//====================
+//=== task_console ===
+//====================
+void task_console(void *pvParameter){
+    //install driver for receiving (output still goes through the default console)
+    if (uart_driver_install(CONSOLE_UART, CONSOLE_RX_BUFFER, 0, 0, NULL, 0) != ESP_OK) {
+        ESP_LOGE(TAG, "installing uart driver failed - console disabled");
+        vTaskDelete(NULL);
+    }
+    char line[CONSOLE_LINE_LENGTH];
+    size_t length = 0;
+    while (1) {
+        uint8_t c;
+        //blocks until a character was received
+        if (uart_read_bytes(CONSOLE_UART, &c, 1, portMAX_DELAY) != 1) continue;
+        if (c == '\r' || c == '\n') {
+            line[length] = '\0';
+            executeLine(line);
+            length = 0;
+        } else if (length < sizeof(line) - 1) {
+            line[length++] = c;
+        }
+    }
+}
@@ -0,0 +1,15 @@
+#pragma once
+
+//commands read line by line from the console uart (CONSOLE_UART, same as log output):
+//  telemetry               print telemetry records as csv (telemetry.hpp)
+//  telemetry clear         remove all telemetry records
+//  param                   list runtime parameters with value, default and bounds (params.hpp)
+//  param <name>            print one parameter
+//  param <name> <value>    change parameter (stored in nvs)
+//  param <name> default    reset parameter to default
+//  slip                    show length correction table of active cable profile (slip.hpp)
+//  slip <point> <percent>  change correction at speed point
+//  help                    list commands
+
+//task that reads and executes console commands (has to be created as task in main function)
+void task_console(void *pvParameter);
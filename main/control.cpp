@@ -7,6 +7,7 @@ extern "C"
 #include "freertos/queue.h"
 #include "esp_system.h"
 #include "esp_log.h"
+#include "esp_timer.h"
 #include "driver/adc.h"
 
 #include "max7219.h"
@@ -15,7 +16,6 @@ extern "C"
 #include <cmath>
 #include "config.h"
 #include "gpio_evaluateSwitch.hpp"
-#include "gpio_adc.hpp"
 #include "buzzer.hpp"
 #include "vfd.hpp"
 #include "display.hpp"
@@ -24,6 +24,11 @@ extern "C"
 #include "guide-stepper.hpp"
 #include "global.hpp"
 #include "control.hpp"
+#include "coast.hpp"
+#include "adc-service.hpp"
+#include "persist.hpp"
+#include "telemetry.hpp"
+#include "params.hpp"
 
 
 //-----------------------------------------
@@ -32,7 +37,7 @@ extern "C"
 static const char *TAG = "control"; //tag for logging
 
 //control
-const char* systemStateStr[7] = {"COUNTING", "WINDING_START", "WINDING", "TARGET_REACHED", "AUTO_CUT_WAITING", "CUTTING", "MANUAL"};
+const char* systemStateStr[8] = {"COUNTING", "WINDING_START", "WINDING", "TARGET_REACHED", "AUTO_CUT_WAITING", "CUTTING", "MANUAL", "CALIBRATION"};
 systemState_t controlState = systemState_t::COUNTING;
 static uint32_t timestamp_lastStateChange = 0;
 
@@ -40,6 +45,7 @@ static uint32_t timestamp_lastStateChange = 0;
 static char buf_disp1[10];// 8 digits + decimal point + \0
 static char buf_disp2[10];// 8 digits + decimal point + \0
 static char buf_tmp[15];
+static controlJob_t jobShown; //progress of active job
 
 //track length
 static int lengthNow = 0; //length measured in mm
@@ -51,9 +57,39 @@ static uint32_t timestamp_motorStarted = 0; //timestamp winding started
 //automatic cut
 static int cut_msRemaining = 0;
 static uint32_t timestamp_cut_lastBeep = 0;
-static uint32_t autoCut_delayMs = 2500; //TODO add this to config
 static bool autoCutEnabled = false; //store state of toggle switch (no hotswitch)
 
+//telemetry
+static telemetryRecord_t telemetryNow = {}; //piece in progress (since control continued after last cut)
+static telemetryRecord_t telemetryCut = {}; //cut piece, complete when cutter is back at idle position
+static bool cutterReturning = false; //control continued before cutter finished its cycle
+static uint32_t timestamp_cutterStarted = 0;
+static uint32_t timestamp_cableCleared = 0;
+static uint32_t timestamp_levelUpdate = 0;
+
+//production jobs
+static controlJob_t jobs[JOB_QUEUE_LENGTH];
+static int jobCount = 0;
+static portMUX_TYPE jobsMux = portMUX_INITIALIZER_UNLOCKED; //jobs are added by other tasks
+static bool jobPieceRunning = false; //current piece belongs to a job -> cut automatically
+
+//encoder calibration
+static bool calibrationEditing = false; //SET pressed in calibration state -> poti sets true length
+static int calibrationTrueMm = 0; //true length of wound reference, 0 = not entered yet
+static int calibrationSteps = 0; //encoder steps counted for that length
+static int lengthBeeped = 0;
+
+//events
+static QueueHandle_t eventQueue = NULL;
+static esp_timer_handle_t wakeTimer = NULL;
+static bool lengthWatched = false; //stop length is watched by encoder isr
+static volatile bool lengthTripped = false; //motor was turned off by encoder isr at stop length
+
+#ifdef VFD_MODBUS
+//stall / empty spool detection
+static uint32_t timestamp_loadOk = 0; //last time no load fault condition was present
+#endif
+
 //user interface
 static uint32_t timestamp_lastWidthSelect = 0;
 //ignore new set events for that time after last value set using poti
@@ -75,10 +111,327 @@ void changeState (systemState_t stateNew) {
     }
     //log change
     ESP_LOGW(TAG, "changed state from %s to %s", systemStateStr[(int)controlState], systemStateStr[(int)stateNew]);
+    //telemetry: time spent in previous state
+    uint32_t now = esp_log_timestamp();
+    telemetryNow.stateMs[(int)controlState] += now - timestamp_lastStateChange;
     //change state
     controlState = stateNew;
     //update timestamp
-    timestamp_lastStateChange = esp_log_timestamp();
+    timestamp_lastStateChange = now;
+}
+
+
+
+//=========================
+//=== control_getState ====
+//=========================
+systemState_t control_getState(){
+    return controlState;
+}
+
+
+
+//===============================
+//=== control_getLengthTarget ===
+//===============================
+int control_getLengthTarget(){
+    return lengthTarget;
+}
+
+
+
+//======================
+//=== control_addJob ===
+//======================
+bool control_addJob(int lengthMm, int count, uint8_t windingWidthMm){
+    if (lengthMm <= 0 || count <= 0 || windingWidthMm > GUIDE_MAX_MM) {
+        return false;
+    }
+    bool added = false;
+    portENTER_CRITICAL(&jobsMux);
+    if (jobCount < JOB_QUEUE_LENGTH) {
+        jobs[jobCount++] = {lengthMm, count, windingWidthMm, 0};
+        added = true;
+    }
+    portEXIT_CRITICAL(&jobsMux);
+    if (added) {
+        ESP_LOGW(TAG, "added job: %d x %dmm", count, lengthMm);
+        control_postEvent(CONTROL_EVENT_REQUEST);
+    }
+    return added;
+}
+
+
+
+//=========================
+//=== control_clearJobs ===
+//=========================
+void control_clearJobs(){
+    portENTER_CRITICAL(&jobsMux);
+    jobCount = 0;
+    portEXIT_CRITICAL(&jobsMux);
+    control_postEvent(CONTROL_EVENT_REQUEST);
+}
+
+
+
+//=======================
+//=== control_getJobs ===
+//=======================
+int control_getJobs(controlJob_t *list, int maxCount){
+    portENTER_CRITICAL(&jobsMux);
+    int count = jobCount < maxCount ? jobCount : maxCount;
+    for (int i = 0; i < count; i++) {
+        list[i] = jobs[i];
+    }
+    portEXIT_CRITICAL(&jobsMux);
+    return count;
+}
+
+
+
+//============================
+//=== control_getActiveJob ===
+//============================
+//jobs are processed in order: first job with pieces left
+//returns index of active job and copies it to job (optional), -1 when no piece is pending
+static int getActiveJob(controlJob_t *job = NULL){
+    int index = -1;
+    portENTER_CRITICAL(&jobsMux);
+    for (int i = 0; i < jobCount; i++) {
+        if (jobs[i].done < jobs[i].count) {
+            index = i;
+            if (job != NULL) *job = jobs[i];
+            break;
+        }
+    }
+    portEXIT_CRITICAL(&jobsMux);
+    return index;
+}
+
+int control_getActiveJob(){
+    return getActiveJob();
+}
+
+
+
+//====================
+//=== loadJobPiece ===
+//====================
+//apply length and winding width of the next piece of the active job
+//returns false when no piece is pending
+static bool loadJobPiece(){
+    controlJob_t job;
+    if (getActiveJob(&job) < 0) {
+        return false;
+    }
+    lengthTarget = job.lengthMm;
+    uint8_t width = job.windingWidthMm ? job.windingWidthMm : guide_targetLength2WindingWidth(job.lengthMm);
+    if (width != guide_getWindingWidth()) {
+        guide_setWindingWidth(width);
+    }
+    return true;
+}
+
+
+
+//=====================
+//=== countJobPiece ===
+//=====================
+//count cut piece for the active job
+//returns true when more pieces are pending (same or next job)
+static bool countJobPiece(){
+    //look up and count in one critical section (jobs may be cleared / added by the console meanwhile)
+    controlJob_t job = {};
+    int index = -1;
+    portENTER_CRITICAL(&jobsMux);
+    for (int i = 0; i < jobCount; i++) {
+        if (jobs[i].done < jobs[i].count) {
+            index = i;
+            job = jobs[i]; //before counting: done is the number of the piece
+            jobs[i].done++;
+            break;
+        }
+    }
+    portEXIT_CRITICAL(&jobsMux);
+    if (index < 0) {
+        return false; //jobs were cleared meanwhile
+    }
+    ESP_LOGW(TAG, "job %d: piece %d/%d done (%dmm)", index + 1, job.done + 1, job.count, job.lengthMm);
+    return getActiveJob() >= 0;
+}
+
+
+
+//===================
+//=== commitPiece ===
+//===================
+//cutter finished: complete telemetry record of the cut piece
+static void commitPiece(){
+    telemetryCut.cutterMs = esp_log_timestamp() - timestamp_cutterStarted;
+    if (cutter_getState() != cutter_state_t::IDLE) {
+        telemetryCut.flags |= TELEMETRY_FLAG_CUTTER_FAULT;
+    }
+    telemetry_add(&telemetryCut);
+}
+
+
+
+//===================
+//=== finishPiece ===
+//===================
+//piece was cut and control continues: start record of next piece,
+//complete the cut one now or when the cutter is back at idle position
+static void finishPiece(){
+    telemetryCut = telemetryNow;
+    telemetryNow = {};
+    telemetryNow.timestampMs = esp_log_timestamp();
+    if (cutter_isRunning()) {
+        cutterReturning = true;
+        timestamp_cableCleared = telemetryNow.timestampMs;
+        telemetryCut.flags |= TELEMETRY_FLAG_PIPELINED;
+    } else {
+        commitPiece();
+    }
+}
+
+
+
+//====================
+//=== startWinding ===
+//====================
+//start motor at low speed
+static void startWinding(){
+    changeState(systemState_t::WINDING_START);
+    vfd_setSpeedLevel(1); //start at low speed 
+    vfd_setState(true); //start motor
+    timestamp_motorStarted = esp_log_timestamp(); //save time started
+    timestamp_levelUpdate = timestamp_motorStarted;
+    lengthTripped = false;
+    buzzer.beep(1, 100, 0);
+}
+
+
+
+//========================
+//=== storeCalibration ===
+//========================
+//calculate steps per meter from entered true length and store it
+//returns false when no or a too short true length was entered
+static bool storeCalibration(){
+    if (calibrationTrueMm < CALIBRATION_MIN_LENGTH_MM) {
+        ESP_LOGE(TAG, "calibration: reference length %dmm too short", calibrationTrueMm);
+        return false;
+    }
+    float stepsPerMeterOld = param_getFloat(PARAM_ENC_STEPS_PER_M);
+    float stepsPerMeter = (float)calibrationSteps * 1000 / calibrationTrueMm;
+    if (!param_set(PARAM_ENC_STEPS_PER_M, stepsPerMeter)) {
+        ESP_LOGE(TAG, "calibration: %.1f steps per meter out of range", stepsPerMeter);
+        return false;
+    }
+    //drift compared to default indicates wear of the encoder roller
+    ESP_LOGW(TAG, "calibration: %d steps for %dmm -> %.1f steps/m (was %.1f, default %d, %+.2f%%)",
+            calibrationSteps, calibrationTrueMm, stepsPerMeter, stepsPerMeterOld, ENCODER_STEPS_PER_METER,
+            (stepsPerMeter / ENCODER_STEPS_PER_METER - 1) * 100);
+    return true;
+}
+
+
+
+//=========================
+//=== control_postEvent ===
+//=========================
+bool control_postEvent(controlEventType_t type, int32_t value){
+    if (eventQueue == NULL) return false;
+    controlEvent_t event = {type, value};
+    return xQueueSend(eventQueue, &event, 0) == pdTRUE;
+}
+
+bool control_postEventFromIsr(controlEventType_t type, int32_t value, BaseType_t *taskWoken){
+    if (eventQueue == NULL) return false;
+    controlEvent_t event = {type, value};
+    return xQueueSendFromISR(eventQueue, &event, taskWoken) == pdTRUE;
+}
+
+
+
+//===========================
+//=== control_onInputEdge ===
+//===========================
+void control_onInputEdge(const gpioInputEvent_t *event){
+    control_postEvent(CONTROL_EVENT_INPUT, event->input->getGpioNum());
+}
+
+
+
+//---------------------------
+//---- event sources --------
+//---------------------------
+//encoder isr: stop length reached
+static void isr_lengthReached(BaseType_t *taskWoken){
+#ifdef TARGET_TRIP_IN_ISR
+    //turn motor off without task latency, handleStopCondition completes the stop
+    vfd_stopFromIsr();
+    lengthTripped = true;
+#endif
+    control_postEventFromIsr(CONTROL_EVENT_LENGTH, 0, taskWoken);
+}
+
+//esp_timer: wake up time requested with wakeIn()
+static void timer_wake(void *arg){
+    control_postEvent(CONTROL_EVENT_TIMER);
+}
+
+//run control task again after ms at the latest (replaces previous request)
+static void wakeIn(uint32_t ms){
+    esp_timer_stop(wakeTimer);
+    esp_timer_start_once(wakeTimer, (uint64_t)ms * 1000);
+}
+
+
+
+//===================
+//=== handleEvent ===
+//===================
+//most events only wake the task, the cycle evaluates the machine state
+static void handleEvent(const controlEvent_t *event){
+    switch (event->type) {
+        case CONTROL_EVENT_POWER_FAIL:
+            //stop motor and pending cut, the remaining length can be wound after restart
+            ESP_LOGE(TAG, "power fail in state %s at %dmm", systemStateStr[(int)controlState], lengthNow);
+            if (controlState == systemState_t::WINDING_START || controlState == systemState_t::WINDING
+                    || controlState == systemState_t::AUTO_CUT_WAITING) {
+                vfd_setState(false);
+                changeState(systemState_t::COUNTING);
+            }
+            break;
+        case CONTROL_EVENT_LENGTH:
+            lengthWatched = false; //fired once
+            break;
+        default:
+            ESP_LOGD(TAG, "event %d (%d)", (int)event->type, event->value);
+            break;
+    }
+}
+
+
+
+//========================
+//=== getCyclePeriodMs ===
+//========================
+//time the control task waits for events until it runs again:
+//short while anything moves or runs on time, long while waiting for the operator
+static uint32_t getCyclePeriodMs(handledDisplay *displayTop, handledDisplay *displayBot){
+    bool active = controlState == systemState_t::WINDING_START || controlState == systemState_t::WINDING
+        || controlState == systemState_t::AUTO_CUT_WAITING || controlState == systemState_t::CUTTING
+        || controlState == systemState_t::MANUAL
+        || cutter_isRunning() || cutterReturning || jobPieceRunning
+        || coast_isCoasting() || coast_getSpeed() != 0 //length display, slip correction
+        || displayTop->isBlinking() || displayBot->isBlinking()
+        //held switches (msPressed, poti), AUTO_CUT is a toggle switch
+        || SW_START.state || SW_RESET.state || SW_CUT.state || SW_SET.state
+        || SW_PRESET1.state || SW_PRESET2.state || SW_PRESET3.state;
+    return active ? CONTROL_CYCLE_MS : CONTROL_IDLE_CYCLE_MS;
 }
 
 
@@ -93,9 +446,19 @@ bool handleStopCondition(handledDisplay * displayTop, handledDisplay * displayBo
     //--- stop conditions ---
     //stop conditions that are checked in any mode
     //target reached -> reached state, stop motor, display message
-    if (lengthRemaining <= 0 ) {
+    //(motor may be off already: turned off by encoder isr at the stop length, see TARGET_TRIP_IN_ISR)
+#ifdef COAST_MODEL_ENABLED
+    //turn motor off early, reel coasts the remaining length
+    if (lengthRemaining <= coast_predictStopMm() || lengthTripped) {
+#else
+    if (lengthRemaining <= 0 || lengthTripped) {
+#endif
+        if (lengthTripped) ESP_LOGI(TAG, "motor turned off by encoder isr, remaining %dmm", lengthRemaining);
+        lengthTripped = false;
         changeState(systemState_t::TARGET_REACHED);
         vfd_setState(false);
+        telemetryNow.lengthTargetMm = lengthTarget;
+        telemetryNow.lengthMotorOffMm = lengthNow;
         displayTop->blink(1, 0, 1000, "  S0LL  ");
         displayBot->blink(1, 0, 1000, "ERREICHT");
         buzzer.beep(2, 100, 100);
@@ -116,6 +479,63 @@ bool handleStopCondition(handledDisplay * displayTop, handledDisplay * displayBo
 
 
 
+#ifdef VFD_MODBUS
+//=================================
+//====== handle Motor Load ========
+//=================================
+//stop winding when the vfd feedback shows a problem for VFD_LOAD_FAULT_MS (used in winding states):
+//no feedback (communication lost), vfd fault or stopped itself, current above stall current,
+//or the cable does not move while the vfd runs: stall (current) or empty supply spool (no load current)
+//returns true when the motor was stopped
+static bool handleMotorLoad(handledDisplay * displayTop, handledDisplay * displayBot){
+    uint32_t now = esp_log_timestamp();
+    //acceleration, feedback may still be from before start
+    if (now - timestamp_motorStarted < VFD_LOAD_CHECK_DELAY_MS) {
+        timestamp_loadOk = now;
+        return false;
+    }
+    //--- check feedback ---
+    vfdFeedback_t feedback;
+    const char *fault = NULL, *message = NULL;
+    if (!vfd_getFeedback(&feedback)) {
+        fault = "communication lost";
+        message = " RS485  ";
+    } else if (feedback.faultCode != 0 || feedback.runState == 2) { //2 = stop although run terminal is on
+        fault = "vfd fault";
+        message = "  VFD   ";
+    } else if (feedback.currentA > param_getFloat(PARAM_STALL_CURRENT)) {
+        fault = "stall (current)";
+        message = " BL0CK  ";
+    } else if (fabsf(encoder_getSpeed()) < VFD_LOAD_MOVING_SPEED && feedback.frequencyHz > VFD_LOAD_MIN_FREQUENCY) {
+        if (feedback.currentA < param_getFloat(PARAM_IDLE_CURRENT)) {
+            fault = "empty spool (cable not moving, no load)";
+            message = "  LEER  ";
+        } else {
+            fault = "stall (cable not moving)";
+            message = " BL0CK  ";
+        }
+    }
+    if (fault == NULL) {
+        timestamp_loadOk = now;
+        return false;
+    } else if (now - timestamp_loadOk < VFD_LOAD_FAULT_MS) {
+        return false;
+    }
+    //--- stop ---
+    ESP_LOGE(TAG, "stopped winding at %dmm: %s - output %.1fHz, %.2fA, run state %d, fault %d, cable %.0fmm/s",
+            lengthNow, fault, feedback.frequencyHz, feedback.currentA, feedback.runState, feedback.faultCode,
+            encoder_getSpeed());
+    changeState(systemState_t::COUNTING);
+    vfd_setState(false);
+    displayTop->blink(3, 900, 1000, " FEHLER ");
+    displayBot->blink(3, 900, 1000, message);
+    buzzer.beep(6, 300, 100);
+    return true;
+}
+#endif
+
+
+
 //===================================
 //===== set dynamic speed level =====
 //===================================
@@ -123,22 +543,39 @@ bool handleStopCondition(handledDisplay * displayTop, handledDisplay * displayBo
 //closer to target -> slower
 void setDynSpeedLvl(uint8_t lvlMax = 3){
     uint8_t lvl;
+#ifdef COAST_MODEL_ENABLED
+    //thresholds depend on learned coast distance of each level
+    lvl = coast_getSpeedLevel(lengthRemaining);
+#else
     //define speed level according to difference
-    if (lengthRemaining < 40) {
+    if (lengthRemaining < param_getInt(PARAM_LEVEL1_BELOW)) {
         lvl = 0;
-    } else if (lengthRemaining < 300) {
+    } else if (lengthRemaining < param_getInt(PARAM_LEVEL2_BELOW)) {
         lvl = 1;
-    } else if (lengthRemaining < 700) {
+    } else if (lengthRemaining < param_getInt(PARAM_LEVEL3_BELOW)) {
         lvl = 2;
     } else { //more than last step remaining
         lvl = 3;
     }
+#endif
     //limit to max lvl
     if (lvl > lvlMax) {
         lvl = lvlMax;
     }
+#ifdef VFD_CONTINUOUS_SPEED
+    //continuous profile instead of the levels, level is only used as speed limit and for telemetry
+    static const float levelPercent[4] = VFD_LEVEL_PERCENT;
+    vfd_setSpeedPercent(coast_getSpeedPercent(lengthRemaining, levelPercent[lvlMax > 3 ? 3 : lvlMax]));
+    lvl = vfd_getSpeedLevel();
+#endif
+    //telemetry: time wound at each level
+    uint32_t now = esp_log_timestamp();
+    telemetryNow.levelMs[lvl] += now - timestamp_levelUpdate;
+    timestamp_levelUpdate = now;
+#ifndef VFD_CONTINUOUS_SPEED
     //update vfd speed level
     vfd_setSpeedLevel(lvl);
+#endif
 }
 
 
@@ -150,6 +587,13 @@ void setDynSpeedLvl(uint8_t lvlMax = 3){
 //task that controls the entire machine
 void task_control(void *pvParameter)
 {
+    //-- events --
+    eventQueue = xQueueCreate(CONTROL_EVENT_QUEUE_LENGTH, sizeof(controlEvent_t));
+    esp_timer_create_args_t timerArgs = {};
+    timerArgs.callback = timer_wake;
+    timerArgs.name = "controlWake";
+    ESP_ERROR_CHECK(esp_timer_create(&timerArgs, &wakeTimer));
+
     //-- initialize display --
     max7219_t two7SegDisplays = display_init();
     //create two separate custom handled display instances
@@ -162,14 +606,41 @@ void task_control(void *pvParameter)
     display_ShowWelcomeMsg(two7SegDisplays);
 
     //-- set initial winding width for default length --
-    guide_setWindingWidth(guide_targetLength2WindingWidth(lengthTarget));
+    //or continue with length and width used before power loss, or settings used last time
+    powerFailState_t resume;
+    persistSettings_t settings = persist_getSettings();
+    if (persist_getResumeState(&resume)) {
+        lengthTarget = resume.lengthTargetMm;
+        guide_setWindingWidth(resume.windingWidthSteps / STEPPER_STEPS_PER_MM);
+        //winding is not started automatically, operator has to press start to wind the remaining length
+        ESP_LOGW(TAG, "resumed after power loss in state %s: length=%dmm target=%dmm",
+                systemStateStr[resume.controlState], encoder_getLenMm(), lengthTarget);
+        buzzer.beep(2, 300, 100);
+    } else if (settings.lengthTargetMm > 0) {
+        lengthTarget = settings.lengthTargetMm;
+        guide_setWindingWidth(settings.windingWidthMm);
+    } else {
+        guide_setWindingWidth(guide_targetLength2WindingWidth(lengthTarget));
+    }
+
+    //-- load learned coast distances --
+    coast_init();
 
     // ##############################
     // ######## control loop ########
     // ##############################
     // repeatedly handle the machine
     while(1){
-        vTaskDelay(10 / portTICK_PERIOD_MS);
+        //------ wait for event ------
+        //or until cycle period passed (depends on state)
+        controlEvent_t event;
+        TickType_t waitTicks = getCyclePeriodMs(&displayTop, &displayBot) / portTICK_PERIOD_MS;
+        if (xQueueReceive(eventQueue, &event, waitTicks) == pdTRUE) {
+            //handle all pending events in this cycle
+            do {
+                handleEvent(&event);
+            } while (xQueueReceive(eventQueue, &event, 0) == pdTRUE);
+        }
 
 
         //------ handle switches ------
@@ -187,11 +658,19 @@ void task_control(void *pvParameter)
         //------ handle cutter ------
         //TODO: separate task for cutter?
         cutter_handle();
+        //cutter finished returning to idle position after control continued (pipelined cut)
+        if (cutterReturning && !cutter_isRunning()) {
+            cutterReturning = false;
+            telemetryCut.cutterReturnMs = esp_log_timestamp() - timestamp_cableCleared;
+            commitPiece();
+        }
 
 
         //------ rotary encoder ------
         //get current length since last reset
         lengthNow = encoder_getLenMm();
+        //measure speed, learn coast distance after motor stop
+        coast_handle(lengthNow);
 
         
         //--------- buttons ---------
@@ -202,6 +681,7 @@ void task_control(void *pvParameter)
                 guide_moveToZero(); //move axis guiding the cable to start position
                 encoder_reset(); //reset length measurement
                 lengthNow = 0;
+                calibrationTrueMm = 0;
                 buzzer.beep(1, 700, 100);
                 displayTop.blink(2, 100, 100, "1ST     ");
                 //TODO: stop cutter with reset switch?
@@ -222,8 +702,10 @@ void task_control(void *pvParameter)
             }
             //start cutter when motor not active
             else if (controlState != systemState_t::WINDING_START //TODO use vfd state here?
-                    && controlState != systemState_t::WINDING) {
+                    && controlState != systemState_t::WINDING
+                    && !(controlState == systemState_t::CALIBRATION && vfd_getState())) {
                 cutter_start();
+                persist_addCut(lengthNow);
                 buzzer.beep(1, 70, 50);
             }
             //error cant cut while motor is on
@@ -253,20 +735,36 @@ void task_control(void *pvParameter)
 
         //#### manual mode ####
         //switch to manual motor control (2 buttons + poti)
-        if ( SW_PRESET2.state && (SW_PRESET1.state || SW_PRESET3.state) && controlState != systemState_t::MANUAL ) {
+        if ( SW_PRESET2.state && (SW_PRESET1.state || SW_PRESET3.state)
+                && controlState != systemState_t::MANUAL && controlState != systemState_t::CALIBRATION ) {
             //enable manual control
             changeState(systemState_t::MANUAL);
             buzzer.beep(3, 100, 60);
         }
 
+        //#### calibration mode ####
+        //hold SET + PRESET3 -> measure a reference length and store encoder steps per meter
+        if ( controlState == systemState_t::COUNTING && SW_SET.state && SW_PRESET3.state
+                && SW_SET.msPressed > CALIBRATION_ENTER_MS && SW_PRESET3.msPressed > CALIBRATION_ENTER_MS ) {
+            changeState(systemState_t::CALIBRATION);
+            //measurement starts at current cable position
+            guide_moveToZero();
+            encoder_reset();
+            lengthNow = 0;
+            lengthBeeped = 0;
+            calibrationTrueMm = 0;
+            calibrationEditing = false;
+            buzzer.beep(4, 100, 60);
+        }
+
         //##### SET switch + Potentiometer #####
         //## set winding-width (SET+PRESET1+POTI) ##
         // set winding width (axis travel) with poti position
         // when SET and PRESET1 button are pressed
-        if (SW_SET.state == true && SW_PRESET1.state == true) {
+        if (controlState != systemState_t::CALIBRATION && SW_SET.state == true && SW_PRESET1.state == true) {
             timestamp_lastWidthSelect = esp_log_timestamp();
             //read adc
-            potiRead = gpio_readAdc(ADC_CHANNEL_POTI); //0-4095
+            potiRead = adcService_get(ADC_CHANNEL_POTI); //0-4095
             //scale to target length range
             uint8_t windingWidthNew = (float)potiRead / 4095 * MAX_SELECTABLE_WINDING_WIDTH_MM;
             //apply hysteresis and round to whole meters //TODO optimize this
@@ -292,9 +790,11 @@ void task_control(void *pvParameter)
         //## set target length (SET+POTI) ##
         //set target length to poti position when only SET button is pressed and certain dead time passed after last setWindingWidth (SET and PRESET1 button) to prevent set target at release
         // FIXME: when going to edit the winding width (SET+PRESET1) sometimes the target-length also updates when initially pressing SET -> update only at actual poti change (works sometimes)
-        else if (SW_SET.state == true && (esp_log_timestamp() - timestamp_lastWidthSelect > DEAD_TIME_POTI_SET_VALUE)) {
+        //(not while holding SET + PRESET3 for calibration mode)
+        else if (controlState != systemState_t::CALIBRATION && SW_SET.state == true && SW_PRESET3.state == false
+                && (esp_log_timestamp() - timestamp_lastWidthSelect > DEAD_TIME_POTI_SET_VALUE)) {
             //read adc
-            potiRead = gpio_readAdc(ADC_CHANNEL_POTI); //0-4095
+            potiRead = adcService_get(ADC_CHANNEL_POTI); //0-4095
             //scale to target length range
             int lengthTargetNew = (float)potiRead / 4095 * MAX_SELECTABLE_LENGTH_POTI_MM;
             //apply hysteresis and round to whole meters //TODO optimize this
@@ -323,12 +823,13 @@ void task_control(void *pvParameter)
         }
         if (SW_SET.fallingEdge) {
             buzzer.beep(2, 70, 50);
-            displayBot.blink(2, 100, 100, "S0LL    ");
+            if (controlState != systemState_t::CALIBRATION) displayBot.blink(2, 100, 100, "S0LL    ");
         }
 
 
         //##### target length preset buttons #####
-        if (controlState != systemState_t::MANUAL && SW_SET.state == false) { //dont apply preset length while controlling motor with preset buttons
+        //dont apply preset length while controlling motor with preset buttons or calibrating
+        if (controlState != systemState_t::MANUAL && controlState != systemState_t::CALIBRATION && SW_SET.state == false) {
             if (SW_PRESET1.risingEdge) {
                 lengthTarget = 5000;
                 guide_setWindingWidth(guide_targetLength2WindingWidth(lengthTarget));
@@ -356,7 +857,7 @@ void task_control(void *pvParameter)
         //statemachine handling the sequential winding process
 
         //calculate current length difference
-        lengthRemaining = lengthTarget - lengthNow + TARGET_LENGTH_OFFSET;
+        lengthRemaining = lengthTarget - lengthNow + param_getInt(PARAM_LENGTH_OFFSET);
 
         //--- statemachine ---
         switch (controlState) {
@@ -365,12 +866,10 @@ void task_control(void *pvParameter)
                 //TODO check stop condition before starting - prevents motor from starting 2 cycles when already at target
                 //--- start winding to length ---
                 if (SW_START.risingEdge) {
-                    changeState(systemState_t::WINDING_START);
-                    vfd_setSpeedLevel(1); //start at low speed 
-                    vfd_setState(true); //start motor
-                    timestamp_motorStarted = esp_log_timestamp(); //save time started
-                    buzzer.beep(1, 100, 0);
-                } 
+                    //next piece of a programmed job replaces the selected length
+                    jobPieceRunning = loadJobPiece();
+                    startWinding();
+                }
                 break;
 
             case systemState_t::WINDING_START: //wind slow for certain time
@@ -380,27 +879,36 @@ void task_control(void *pvParameter)
                 if (esp_log_timestamp() - timestamp_motorStarted > 3000) {
                     changeState(systemState_t::WINDING);
                 }
-                handleStopCondition(&displayTop, &displayBot); //stops if button released or target reached
-                //TODO: cancel when there was no cable movement during start time?
+                if (handleStopCondition(&displayTop, &displayBot)) break; //stops if button released or target reached
+#ifdef VFD_MODBUS
+                handleMotorLoad(&displayTop, &displayBot); //stops at stall or empty spool
+#endif
                 break;
 
             case systemState_t::WINDING: //wind fast, slow down when close
                 //set vfd speed depending on remaining distance 
                 setDynSpeedLvl(); //set motor speed, slow down when close to target
-                handleStopCondition(&displayTop, &displayBot); //stops if button released or target reached
-                //TODO: cancel when there is no cable movement anymore e.g. empty / timeout?
+                if (handleStopCondition(&displayTop, &displayBot)) break; //stops if button released or target reached
+#ifdef VFD_MODBUS
+                handleMotorLoad(&displayTop, &displayBot); //stops at stall or empty spool
+#endif
                 break;
 
             case systemState_t::TARGET_REACHED: //prevent further motor rotation and start auto-cut
                 vfd_setState(false);
                 //switch to counting state when no longer at or above target length
-                if ( lengthNow < lengthTarget - TARGET_REACHED_TOLERANCE ) {
-                    changeState(systemState_t::COUNTING);
+                //note: motor is turned off before target is reached when coast model is used -> wait until reel stopped
+                if ( lengthNow < lengthTarget - param_getInt(PARAM_REACHED_TOLERANCE) ) {
+                    if (!coast_isCoasting()) changeState(systemState_t::COUNTING);
                 }
                 //initiate countdown to auto-cut if enabled
-                else if ( (autoCutEnabled)
-                        && (esp_log_timestamp() - timestamp_lastStateChange > 300) ) { //wait for dislay msg "reached" to finish
-                    changeState(systemState_t::AUTO_CUT_WAITING);
+                else if (autoCutEnabled || jobPieceRunning) {
+                    uint32_t msPassed = esp_log_timestamp() - timestamp_lastStateChange;
+                    if (msPassed > 300) { //wait for dislay msg "reached" to finish
+                        changeState(systemState_t::AUTO_CUT_WAITING);
+                    } else {
+                        wakeIn(301 - msPassed);
+                    }
                 }
                 //show msg when trying to start, but target is already reached (-> reset button has to be pressed)
                 if (SW_START.risingEdge) {
@@ -411,10 +919,18 @@ void task_control(void *pvParameter)
                 break;
 
             case systemState_t::AUTO_CUT_WAITING: //handle delayed start of cut
-                cut_msRemaining = autoCut_delayMs - (esp_log_timestamp() - timestamp_lastStateChange);
+            {
+                uint32_t delayMs = param_getInt(PARAM_CUT_DELAY);
+#ifdef AUTO_CUT_PIPELINED
+                //shorten countdown when reel stands still and cutter is ready
+                if (encoder_getSpeed() == 0 && !cutter_isRunning()) {
+                    delayMs = param_getInt(PARAM_CUT_DELAY_MIN);
+                }
+#endif
+                cut_msRemaining = delayMs - (esp_log_timestamp() - timestamp_lastStateChange);
                 //- countdown stop conditions -
                 //stop with any button
-                if (!autoCutEnabled
+                if ((!autoCutEnabled && !jobPieceRunning)
                         || SW_RESET.state || SW_CUT.state 
                         || SW_SET.state || SW_PRESET1.state
                         || SW_PRESET2.state || SW_PRESET3.state) {//TODO: also stop when target not reached anymore?
@@ -424,33 +940,100 @@ void task_control(void *pvParameter)
                 //- trigger cut if delay passed -
                 else if (cut_msRemaining <= 0) {
                     cutter_start();
+                    timestamp_cutterStarted = esp_log_timestamp();
+                    telemetryNow.lengthTargetMm = lengthTarget;
+                    telemetryNow.lengthMeasuredMm = lengthNow;
+                    telemetryNow.overshootMm = lengthNow - lengthTarget;
+                    if (jobPieceRunning) telemetryNow.flags |= TELEMETRY_FLAG_JOB;
+                    persist_addCut(lengthNow);
                     changeState(systemState_t::CUTTING);
                 }
                 //- beep countdown -
-                //time passed since last beep  >  time remaining / 6
-                else if ( (esp_log_timestamp() - timestamp_cut_lastBeep)  > (cut_msRemaining / 6)
+                //time passed since last beep  >  time remaining / 6 (remaining is positive here)
+                else if ( (esp_log_timestamp() - timestamp_cut_lastBeep)  > ((uint32_t)cut_msRemaining / 6)
                         && (esp_log_timestamp() - timestamp_cut_lastBeep) > 50 ) { //dont trigger beeps faster than beep time
                     buzzer.beep(1, 50, 0);
                     timestamp_cut_lastBeep = esp_log_timestamp();
                 }
                 break;
+            }
 
             case systemState_t::CUTTING: //prevent any action while cutter is active
+#ifdef AUTO_CUT_PIPELINED
+                //exit when finished cutting or as soon as the blade passed the cable (cutter continues to idle position)
+                if (cutter_isRunning() == false || cutter_cableCleared()) {
+#else
                 //exit when finished cutting
                 if (cutter_isRunning() == false) {
+#endif
                     //TODO stop if start buttons released?
                     changeState(systemState_t::COUNTING);
+                    finishPiece(); //telemetry
                     //TODO reset automatically or wait for manual reset?
                     guide_moveToZero(); //move axis guiding the cable to start position
                     encoder_reset(); //reset length measurement
                     lengthNow = 0;
                     buzzer.beep(1, 700, 100);
+                    //--- production job ---
+                    //continue with next piece right away while START is still on
+                    if (jobPieceRunning) {
+                        jobPieceRunning = false;
+                        if (!countJobPiece()) {
+                            ESP_LOGW(TAG, "all jobs finished");
+                            displayTop.blink(3, 500, 500, "  JOBS  ");
+                            displayBot.blink(3, 500, 500, " FERTIG ");
+                            buzzer.beep(3, 300, 100);
+                        } else if (SW_START.state) {
+                            jobPieceRunning = loadJobPiece();
+                            startWinding();
+                        }
+                    }
+                }
+                break;
+
+            case systemState_t::CALIBRATION: //wind reference length, enter true length, store steps per meter
+                //wind slowly while START is held
+                if (SW_START.state && !calibrationEditing) {
+                    vfd_setSpeedLevel(1);
+                    vfd_setState(true);
+                    calibrationTrueMm = 0; //length changes -> enter again
+                } else {
+                    vfd_setState(false);
+                }
+                //enter true length with poti while SET is held (measured length +-CALIBRATION_RANGE_PERCENT)
+                if (SW_SET.risingEdge) {
+                    calibrationEditing = true;
+                    calibrationSteps = encoder_getSteps();
+                }
+                if (calibrationEditing) {
+                    potiRead = adcService_get(ADC_CHANNEL_POTI); //0-4095
+                    float deviation = ((float)potiRead / 4095 * 2 - 1) * CALIBRATION_RANGE_PERCENT / 100;
+                    float measuredMm = (float)calibrationSteps * 1000 / param_getFloat(PARAM_ENC_STEPS_PER_M);
+                    calibrationTrueMm = round(measuredMm * (1 + deviation));
+                    if (SW_SET.state == false) calibrationEditing = false;
+                }
+                //PRESET1: store result and exit
+                else if (SW_PRESET1.risingEdge) {
+                    if (storeCalibration()) {
+                        changeState(systemState_t::COUNTING);
+                        buzzer.beep(3, 300, 100);
+                        displayTop.blink(2, 600, 500, " CAL 0K ");
+                        sprintf(buf_tmp, "%8.1f", param_getFloat(PARAM_ENC_STEPS_PER_M));
+                        displayBot.blink(2, 600, 500, buf_tmp);
+                    } else {
+                        buzzer.beep(6, 100, 50);
+                    }
+                }
+                //PRESET3: exit without change
+                else if (SW_PRESET3.risingEdge) {
+                    changeState(systemState_t::COUNTING);
+                    buzzer.beep(1, 1000, 100);
                 }
                 break;
 
             case systemState_t::MANUAL: //manually control motor via preset buttons + poti
                 //read poti value
-                potiRead = gpio_readAdc(ADC_CHANNEL_POTI); //0-4095
+                potiRead = adcService_get(ADC_CHANNEL_POTI); //0-4095
                 //scale poti to speed levels 0-3
                 uint8_t level = round( (float)potiRead / 4095 * 3 );
                 //exit manual mode if preset2 released
@@ -478,27 +1061,37 @@ void task_control(void *pvParameter)
                 }
         }
 
+        //--- watch stop length ---
+        //encoder isr turns the motor off (TARGET_TRIP_IN_ISR) and wakes the task at the stop length,
+        //the reaction does not wait for the cycle period
+        if (controlState == systemState_t::WINDING_START || controlState == systemState_t::WINDING) {
+#ifdef COAST_MODEL_ENABLED
+            int stopDistanceMm = coast_predictOffDistanceMm(lengthRemaining);
+#else
+            int stopDistanceMm = lengthRemaining;
+#endif
+            if (stopDistanceMm > 0) {
+                encoder_watchLength(lengthNow + stopDistanceMm, isr_lengthReached);
+                lengthWatched = true;
+            }
+        } else if (lengthWatched) {
+            encoder_unwatch();
+            lengthWatched = false;
+        }
+
 
-#ifdef ENCODER_TEST
         //--------------------------
-        //------ encoder test ------
+        //-------- display1 --------
         //--------------------------
-        //mode for calibrating the cable length measurement (determine ENCODER_STEPS_PER_METER in config.h)
-        //run display handle functions
+        //run handle function
         displayTop.handle();
-        displayBot.handle();
-        //-- show encoder steps on display1 ---
-        sprintf(buf_disp1, "EN %05d", encoder_getSteps()); //count
-        displayTop.showString(buf_disp1);
-        //--- show converted distance on display2 ---
-        sprintf(buf_disp2, "Met %5.3f", (float)lengthNow/1000); //m
-        displayBot.showString(buf_disp2);
-        //--- beep every 0.5m ---
-        //note: only works precisely in forward/positive direction, in reverse it it beeps by tolerance too early
-        static int lengthBeeped = 0;
-        if (lengthNow % 500 < 50) { //with tolerance in case of missed exact value
-            if (fabs(lengthNow - lengthBeeped) >= 400) { //dont beep multiple times at same distance
-                //TODO: add case for reverse direction. currently beeps 50mm too early
+        //calibration: show measured length, beep every 0.5m
+        if (controlState == systemState_t::CALIBRATION) {
+            sprintf(buf_tmp, "CAL %5.4f", (float)lengthNow/1000);
+            sprintf(buf_disp1, "%.9s", buf_tmp);
+            displayTop.showString(buf_disp1);
+            //note: only works precisely in forward/positive direction, in reverse it beeps by tolerance too early
+            if (lengthNow % 500 < 50 && abs(lengthNow - lengthBeeped) >= 400) { //tolerance in case of missed exact value
                 if (lengthNow % 1000 < 50) // 1m beep
                     buzzer.beep(1, 400, 100);
                 else // 0.5m beep
@@ -506,15 +1099,8 @@ void task_control(void *pvParameter)
                 lengthBeeped = lengthNow;
             }
         }
-#else //not in encoder calibration mode
-
-        //--------------------------
-        //-------- display1 --------
-        //--------------------------
-        //run handle function
-        displayTop.handle();
         //indicate upcoming cut when pending
-        if (controlState == systemState_t::AUTO_CUT_WAITING) {
+        else if (controlState == systemState_t::AUTO_CUT_WAITING) {
             displayTop.blinkStrings(" CUT 1N ", "        ", 70, 30);
         }
         //setting winding width: blink info message
@@ -545,6 +1131,19 @@ void task_control(void *pvParameter)
             //displayBot.showString(buf_disp2); //TODO:blink "erreicht" overrides this. for now using blink as workaround
             displayBot.blinkStrings(buf_disp2, buf_disp2, 100, 100);
         }
+        //calibration: blink true length while entering, then alternate with resulting steps per meter
+        else if (controlState == systemState_t::CALIBRATION) {
+            sprintf(buf_tmp, "ECHT%5.3f", (float)calibrationTrueMm/1000);
+            if (calibrationEditing) {
+                displayBot.blinkStrings(buf_tmp, "ECHT    ", 300, 100);
+            } else if (calibrationTrueMm > 0) {
+                sprintf(buf_disp2, "%8.1f", (float)calibrationSteps * 1000 / calibrationTrueMm);
+                displayBot.blinkStrings(buf_tmp, buf_disp2, 2000, 1000);
+            } else {
+                sprintf(buf_disp2, "EN %05d", encoder_getSteps());
+                displayBot.showString(buf_disp2);
+            }
+        }
         //manual state: blink "manual"
         else if (controlState == systemState_t::MANUAL) {
             displayBot.blinkStrings(" MANUAL ", buf_disp2, 400, 800);
@@ -559,6 +1158,17 @@ void task_control(void *pvParameter)
             sprintf(buf_tmp, "S0LL%5.3f", (float)lengthTarget/1000);
             displayBot.blinkStrings(buf_tmp, "S0LL    ", 300, 100);
         }
+        //job piece: alternate target length and piece number / count
+        else if (jobPieceRunning && getActiveJob(&jobShown) >= 0) {
+            sprintf(buf_tmp, "S0LL%5.3f", (float)lengthTarget/1000);
+            //limit to 3 digits each
+            unsigned shownPiece = jobShown.done + 1;
+            unsigned shownCount = jobShown.count;
+            if (shownPiece > 999) shownPiece = 999;
+            if (shownCount > 999) shownCount = 999;
+            snprintf(buf_disp2, sizeof(buf_disp2), " %03u-%03u", shownPiece, shownCount);
+            displayBot.blinkStrings(buf_tmp, buf_disp2, 2000, 1000);
+        }
         //otherwise show target length
         else {
             //sprintf(buf_disp2, "%06.1f cm", (float)lengthTarget/10); //cm
@@ -567,8 +1177,6 @@ void task_control(void *pvParameter)
             displayBot.showString(buf_tmp);
         }
 
-#endif // end else ifdef ENCODER_TEST
-
         //----------------------------
         //------- control lamp -------
         //----------------------------
@@ -584,6 +1192,9 @@ void task_control(void *pvParameter)
             gpio_set_level(GPIO_LAMP, 0);
         }
 
+        //--- send changed digits of both displays at once ---
+        display_flush(two7SegDisplays);
+
     } //end while(1)
 
 } //end task_control
@@ -1,12 +1,68 @@
 #pragma once
+extern "C" {
+#include <freertos/FreeRTOS.h>
+}
+#include "gpio_inputEvents.hpp"
 
 
 //enum describing the state of the system
-enum class systemState_t {COUNTING, WINDING_START, WINDING, TARGET_REACHED, AUTO_CUT_WAITING, CUTTING, MANUAL};
+enum class systemState_t {COUNTING, WINDING_START, WINDING, TARGET_REACHED, AUTO_CUT_WAITING, CUTTING, MANUAL, CALIBRATION};
 
 //array with enum as strings for logging states
-extern const char* systemStateStr[7];
+extern const char* systemStateStr[8];
 
 
 //task that controls the entire machine (has to be created as task in main function)
 void task_control(void *pvParameter);
+
+//get current state of control task
+systemState_t control_getState();
+
+//get currently selected target length in mm
+int control_getLengthTarget();
+
+
+//events that wake the control task (it also runs periodically, see CONTROL_CYCLE_MS)
+//each run evaluates the complete machine state, thus a lost event (queue full) only delays the reaction
+typedef enum {
+    CONTROL_EVENT_INPUT,      //debounced switch edge (value: gpio)
+    CONTROL_EVENT_LENGTH,     //watched length reached (encoder isr)
+    CONTROL_EVENT_CUTTER,     //cutter position switch changed (value: 1 = pressed)
+    CONTROL_EVENT_TIMER,      //requested wake up time reached
+    CONTROL_EVENT_POWER_FAIL, //supply voltage dropped, state is stored already
+    CONTROL_EVENT_REQUEST     //job list changed (console)
+} controlEventType_t;
+
+typedef struct {
+    controlEventType_t type;
+    int32_t value;
+} controlEvent_t;
+
+//send event to control task, returns false when the queue is full or the task did not start yet
+bool control_postEvent(controlEventType_t type, int32_t value = 0);
+bool control_postEventFromIsr(controlEventType_t type, int32_t value, BaseType_t *taskWoken);
+
+//callback for gpioInputs_add(): wake control task at switch edges
+void control_onInputEdge(const gpioInputEvent_t *event);
+
+
+//production job: wind and cut a batch of pieces with the same length back-to-back
+typedef struct {
+    int lengthMm;
+    int count;              //pieces to produce
+    uint8_t windingWidthMm; //0 = derived from length
+    int done;               //pieces cut so far
+} controlJob_t;
+
+//append job to the queue (processed in order while START stays on, pieces are cut automatically)
+//returns false when the queue is full or the values are invalid
+bool control_addJob(int lengthMm, int count, uint8_t windingWidthMm = 0);
+
+//remove all jobs (a piece already started is still cut)
+void control_clearJobs();
+
+//copy jobs including progress into list, returns number of jobs
+int control_getJobs(controlJob_t *list, int maxCount);
+
+//index of the job currently processed, -1 when no piece is pending
+int control_getActiveJob();
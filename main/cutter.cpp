@@ -1,6 +1,7 @@
 #include "cutter.hpp"
 #include "config.h"
 #include "global.hpp"
+#include "control.hpp"
 
 const char* cutter_stateStr[5] = {"IDLE", "START", "CUTTING", "CANCELED", "TIMEOUT"}; //define strings for logging the state
                                                                           
@@ -17,9 +18,13 @@ bool checkTimeout();
 //---------------------------
 //----- local variables -----
 //---------------------------
-static cutter_state_t cutter_state = cutter_state_t::IDLE;
+//written by the control task only (setState via cutter_start/stop/handle),
+//also read by the input debounce task (cutter_onPositionEdge) -> volatile, set before switching the relay
+static volatile cutter_state_t cutter_state = cutter_state_t::IDLE;
 static uint32_t timestamp_turnedOn;
 static uint32_t msTimeout = 3000;
+static uint32_t timestamp_cuttingStarted; //position switch closed
+static uint32_t msCuttingLearned = 0; //duration position switch is closed per cycle, 0 = not known yet
 static const char *TAG = "cutter"; //tag for logging
 
 
@@ -68,6 +73,18 @@ bool cutter_isRunning(){
 
 
 
+//===============================
+//===== cutter_cableCleared =====
+//===============================
+bool cutter_cableCleared(){
+    if (cutter_state != cutter_state_t::CUTTING || msCuttingLearned == 0) {
+        return false;
+    }
+    return esp_log_timestamp() - timestamp_cuttingStarted > msCuttingLearned * CUTTER_CLEAR_FRACTION;
+}
+
+
+
 //---------------------------
 //-------- setState ---------
 //---------------------------
@@ -121,6 +138,20 @@ bool checkTimeout(){
 
 
 
+//=============================
+//=== cutter_onPositionEdge ===
+//=============================
+//runs in input debounce task: only switch the motor off, state is changed by cutter_handle() (single writer)
+void cutter_onPositionEdge(const gpioInputEvent_t *event){
+    cutter_state_t state = cutter_state; //read once
+    if (!event->pressed && state == cutter_state_t::CUTTING) { //contact open -> at idle pos
+        gpio_set_level(GPIO_RELAY, 0);
+    }
+    control_postEvent(CONTROL_EVENT_CUTTER, event->pressed);
+}
+
+
+
 //========================
 //======== handle ========
 //========================
@@ -144,6 +175,7 @@ void cutter_handle(){
             //if (gpio_get_level(GPIO_CUTTER_POS_SW) == 0){ //contact closed
             if (SW_CUTTER_POS.state == true) { //contact closed -> not at idle pos anymore
                 setState(cutter_state_t::CUTTING);
+                timestamp_cuttingStarted = esp_log_timestamp();
             }
             //--- timeout ---
             else {
@@ -157,6 +189,15 @@ void cutter_handle(){
             //TODO: add min on duration
             if (SW_CUTTER_POS.state == false) { //contact open -> at idle pos
                 setState(cutter_state_t::IDLE);
+                //learn duration of cutting phase: follow slower cycles at once, faster ones slowly
+                //(the blade must not be assumed to have passed the cable too early)
+                uint32_t msCutting = esp_log_timestamp() - timestamp_cuttingStarted;
+                if (msCutting > msCuttingLearned) {
+                    msCuttingLearned = msCutting;
+                } else {
+                    msCuttingLearned -= (msCuttingLearned - msCutting) / 4;
+                }
+                ESP_LOGI(TAG, "cutting phase took %dms, learned %dms", msCutting, msCuttingLearned);
             }
             //--- timeout ---
             else {
@@ -9,6 +9,7 @@ extern "C"
 #include "buzzer.hpp"
 #include "display.hpp"
 #include "gpio_evaluateSwitch.hpp"
+#include "gpio_inputEvents.hpp"
 
 
 //--- variables ---
@@ -33,5 +34,13 @@ cutter_state_t cutter_getState();
 //check if cutter is currently operating
 bool cutter_isRunning();
 
+//check if the blade already passed the cable in the running cycle
+//estimated from the duration of previous cycles -> always false before the first cycle finished
+bool cutter_cableCleared();
+
 //handle function - has to be run repeatedly
 void cutter_handle();
+
+//callback for debounced edges of the position switch (interrupt driven input, see gpio_inputEvents.hpp)
+//turns the motor off as soon as the idle position is reached, cutter_handle() completes the cycle
+void cutter_onPositionEdge(const gpioInputEvent_t *event);
@@ -36,6 +36,8 @@ max7219_t display_init(){
     ESP_ERROR_CHECK(max7219_init(&dev));
     //0...15
     ESP_ERROR_CHECK(max7219_set_brightness(&dev, DISPLAY_BRIGHTNESS));
+    //draw to framebuffer, only changed digits are sent by display_flush()
+    ESP_ERROR_CHECK(max7219_enable_framebuffer(&dev));
     return dev;
     //display = dev;
     ESP_LOGI(TAG, "initializing display - done");
@@ -53,12 +55,14 @@ void display_ShowWelcomeMsg(max7219_t dev){
     max7219_clear(&dev);
     max7219_draw_text_7seg(&dev, 0, "CUTTER  15.03.2024");
     //                                   1234567812 34 5678
+    display_flush(dev);
     vTaskDelay(pdMS_TO_TICKS(700));
     //scroll "hello" over 2 displays
     for (int offset = 0; offset < 23; offset++) {
         max7219_clear(&dev);
         char hello[40] = "                HELL0                 ";
         max7219_draw_text_7seg(&dev, 0, hello + (22 - offset) );
+        display_flush(dev);
         vTaskDelay(pdMS_TO_TICKS(50));
     }
 
@@ -72,11 +76,36 @@ void display_ShowWelcomeMsg(max7219_t dev){
 
 
 
+//=================================
+//========= display flush =========
+//=================================
+//send digits changed since last flush to the display (queued, does not wait for spi)
+//note: handledDisplay instances only draw to the framebuffer, call once per cycle after all updates
+//all digits are sent every DISPLAY_REFRESH_MS, configuration registers every DISPLAY_CONFIG_REFRESH_MS
+void display_flush(max7219_t dev){
+    static uint32_t timestamp_lastRefresh = 0;
+    static uint32_t timestamp_lastConfigRefresh = 0;
+    uint32_t now = esp_log_timestamp();
+    if (now - timestamp_lastRefresh >= DISPLAY_REFRESH_MS) {
+        bool config = now - timestamp_lastConfigRefresh >= DISPLAY_CONFIG_REFRESH_MS;
+        if (config) timestamp_lastConfigRefresh = now;
+        timestamp_lastRefresh = now;
+        esp_err_t err = max7219_refresh(&dev, config);
+        if (err != ESP_OK) ESP_LOGE(TAG, "refresh failed: %s", esp_err_to_name(err));
+    }
+    esp_err_t err = max7219_flush(&dev);
+    if (err != ESP_OK) ESP_LOGE(TAG, "flush failed: %s", esp_err_to_name(err));
+}
+
+
+
+
+
 //---------------------------------
 //---------- constructor ----------
 //---------------------------------
 handledDisplay::handledDisplay(max7219_t displayDevice, uint8_t posStart_f) {
-    ESP_LOGI(TAG, "Creating handledDisplay instance with startPos at %i", posStart);
+    ESP_LOGI(TAG, "Creating handledDisplay instance with startPos at %i", posStart_f);
     //copy variables
     dev = displayDevice;
     posStart = posStart_f;
@@ -23,6 +23,10 @@ max7219_t display_init();
 //show welcome message on the entire display
 void display_ShowWelcomeMsg(max7219_t displayDevice);
 
+//send digits changed since last flush to the display
+//(drawing only updates the framebuffer, descriptor copies share it)
+void display_flush(max7219_t displayDevice);
+
 enum class displayMode {NORMAL, BLINK_STRINGS, BLINK};
 
 class handledDisplay {
@@ -39,6 +43,8 @@ class handledDisplay {
         void blink(uint8_t count, uint32_t msOn, uint32_t msOff, const char * strOff = "        ");
         //function that handles time based modes and writes text to display
         void handle(); //has to be run regularly when blink method is used
+        //true while a blink mode is active (handle has to be run at least at the blink interval)
+        bool isBlinking() { return mode != displayMode::NORMAL; }
 
         //TODO: blinkStrings and blink are very similar - optimize?
         //TODO: add 'scroll string' method
@@ -3,6 +3,10 @@ extern "C" {
 #include <freertos/task.h>
 #include "esp_system.h"
 #include "esp_log.h"
+#include "esp_timer.h"
+#include <stdlib.h>
+#include <math.h>
+#include "driver/pcnt.h"
 
 #include "rotary_encoder.h"
 }
@@ -10,13 +14,33 @@ extern "C" {
 #include "encoder.hpp"
 #include "config.h"
 #include "global.hpp"
+#include "params.hpp"
+#include "slip.hpp"
+
+
+//---------------------
+//--- configuration ---
+//---------------------
+//window speed is averaged over at high speed (limited by ROTARY_ENCODER_TIMESTAMPS steps)
+#define ENCODER_SPEED_WINDOW_US 20000
+//speed is 0 when there was no step for that time
+#define ENCODER_STOP_TIMEOUT_US 500000
+
 
 
 //----------------------------
 //----- global variables -----
 //----------------------------
+static const char *TAG = "encoder";
 static rotary_encoder_info_t encoder; //encoder device/info
 QueueHandle_t encoder_queue = NULL; //encoder event queue
+static volatile int stepsOffset = 0; //added to counted steps (restored length after power loss)
+
+//slip correction: sum of the corrections of all length increments since last reset
+//(encoder_getLenMm is called from several tasks)
+static float slipCorrectionMm = 0;
+static int slipStepsPrev = 0; //steps at last correction update
+static portMUX_TYPE slipMux = portMUX_INITIALIZER_UNLOCKED;
 
 
 
@@ -29,11 +53,20 @@ QueueHandle_t encoder_queue = NULL; //encoder event queue
 //======================
 //initialize encoder and return event queue
 QueueHandle_t encoder_init(){
+#ifdef ENCODER_PCNT_ENABLED
+    // count edges in pulse counter hardware, isr only runs every ENCODER_PCNT_EVENT_STEPS steps
+    // (registers its own pcnt interrupt, the pcnt isr service is not used)
+    ESP_ERROR_CHECK(rotary_encoder_init_pcnt(&encoder, ROT_ENC_A_GPIO, ROT_ENC_B_GPIO,
+                ENCODER_PCNT_UNIT, ENCODER_PCNT_FILTER, ENCODER_PCNT_EVENT_STEPS));
+    ESP_LOGI(TAG, "using pcnt unit %d, filter %d cycles, event every %d steps",
+            ENCODER_PCNT_UNIT, ENCODER_PCNT_FILTER, ENCODER_PCNT_EVENT_STEPS);
+#else
     // esp32-rotary-encoder requires that the GPIO ISR service is installed before calling rotary_encoder_register()
     ESP_ERROR_CHECK(gpio_install_isr_service(0));
 
     // Initialise the rotary encoder device with the GPIOs for A and B signals
     ESP_ERROR_CHECK(rotary_encoder_init(&encoder, ROT_ENC_A_GPIO, ROT_ENC_B_GPIO));
+#endif
     ESP_ERROR_CHECK(rotary_encoder_enable_half_steps(&encoder, ENABLE_HALF_STEPS));
 #ifdef FLIP_DIRECTION
     ESP_ERROR_CHECK(rotary_encoder_flip_direction(&encoder));
@@ -47,6 +80,46 @@ QueueHandle_t encoder_init(){
 }
 
 
+//=============================
+//=== encoder_setNotifyTask ===
+//=============================
+//notify task from encoder isr each time the count changed by at least 'steps'
+void encoder_setNotifyTask(TaskHandle_t task, int steps){
+    ESP_ERROR_CHECK(rotary_encoder_set_notify_task(&encoder, task, steps));
+}
+
+
+//===========================
+//=== encoder_watchLength ===
+//===========================
+static void (*watchCallback)(BaseType_t *taskWoken) = NULL;
+
+static void isr_watch(void *arg, BaseType_t *taskWoken){
+    if (watchCallback != NULL) watchCallback(taskWoken);
+}
+
+void encoder_watchLength(int lengthMm, void (*callbackFromIsr)(BaseType_t *taskWoken)){
+    int steps = encoder_getSteps();
+    float stepsPerMm = param_getFloat(PARAM_ENC_STEPS_PER_M) / 1000;
+    float factor = 1;
+#ifdef ENCODER_SLIP_CORRECTION
+    factor = slip_getFactor(encoder_getSpeed());
+#endif
+    //remaining distance in steps at the current correction
+    int watchSteps = steps + round((lengthMm - encoder_getLenMm()) * stepsPerMm / factor);
+    watchCallback = callbackFromIsr;
+    rotary_encoder_set_watch(&encoder, watchSteps - stepsOffset, isr_watch, NULL);
+}
+
+
+//=======================
+//=== encoder_unwatch ===
+//=======================
+void encoder_unwatch(){
+    rotary_encoder_set_watch(&encoder, 0, NULL, NULL);
+}
+
+
 //========================
 //=== encoder_getSteps ===
 //========================
@@ -56,7 +129,7 @@ int encoder_getSteps(){
     rotary_encoder_state_t encoderState;
     rotary_encoder_get_state(&encoder, &encoderState);
     //calculate total distance since last reset
-    return encoderState.position; 
+    return encoderState.position + stepsOffset;
 }
 
 
@@ -65,7 +138,80 @@ int encoder_getSteps(){
 //========================
 //get current length in Mm since last reset
 int encoder_getLenMm(){
-    return (float)encoder_getSteps() * 1000 / ENCODER_STEPS_PER_METER; 
+    int steps = encoder_getSteps();
+    float lengthMm = (float)steps * 1000 / param_getFloat(PARAM_ENC_STEPS_PER_M);
+#ifdef ENCODER_SLIP_CORRECTION
+    //correct the steps counted since last call with the factor at the current speed
+    float factor = slip_getFactor(encoder_getSpeed());
+    portENTER_CRITICAL(&slipMux);
+    slipCorrectionMm += (float)(steps - slipStepsPrev) * 1000 / param_getFloat(PARAM_ENC_STEPS_PER_M) * (factor - 1);
+    slipStepsPrev = steps;
+    lengthMm += slipCorrectionMm;
+    portEXIT_CRITICAL(&slipMux);
+#endif
+    return lengthMm;
+}
+
+
+//=========================
+//=== encoder_getMotion ===
+//=========================
+encoderMotion_t encoder_getMotion(){
+    encoderMotion_t motion = {0, 0};
+    rotary_encoder_timestamps_t steps;
+    rotary_encoder_get_timestamps(&encoder, &steps);
+    uint32_t now = (uint32_t)esp_timer_get_time();
+    const uint32_t * t = steps.time; //t[0] = newest, unsigned differences handle overflow
+    const rotary_encoder_position_t * p = steps.position; //position at each event (1 or more steps apart)
+    if (steps.count < 2 || now - t[0] > ENCODER_STOP_TIMEOUT_US) {
+        return motion;
+    }
+
+    //--- speed ---
+    //use as many events as fit in window, at least the last period
+    uint32_t k = 1;
+    while (k + 1 < steps.count && t[0] - t[k + 1] <= ENCODER_SPEED_WINDOW_US) k++;
+    uint32_t windowUs = t[0] - t[k];
+    float speed = (float)abs(p[0] - p[k]) * 1e6 / windowUs; //steps/s
+    //no event for longer than the last period -> actual speed is lower
+    uint32_t sinceLastStep = now - t[0];
+    float speedBound = (float)abs(p[0] - p[1]) * 1e6 / (sinceLastStep > 0 ? sinceLastStep : 1);
+    bool decaying = speedBound < speed;
+
+    //--- acceleration ---
+    //difference of speed in the newer and older half of the window
+    float accel = 0;
+    if (k < 2 && steps.count >= 3) k = 2;
+    if (k >= 2) {
+        uint32_t m = k / 2;
+        float speedNew = (float)abs(p[0] - p[m]) * 1e6 / (t[0] - t[m]);
+        float speedOld = (float)abs(p[m] - p[k]) * 1e6 / (t[m] - t[k]);
+        accel = (speedNew - speedOld) * 2e6 / (t[0] - t[k]);
+        if (decaying) {
+            accel = (speedBound - speedNew) * 2e6 / (sinceLastStep + t[0] - t[m]);
+        }
+    }
+    if (decaying) {
+        speed = speedBound;
+    } else {
+        //speed is the average of the window -> extrapolate to now (compensates delay of window/2)
+        speed += accel * (sinceLastStep + windowUs / 2) / 1e6;
+    }
+
+    //--- convert to mm ---
+    float sign = (steps.direction == ROTARY_ENCODER_DIRECTION_COUNTER_CLOCKWISE) ? -1 : 1;
+    float stepsPerMeter = param_getFloat(PARAM_ENC_STEPS_PER_M);
+    motion.speedMmPerS = sign * speed * 1000 / stepsPerMeter;
+    motion.accelMmPerS2 = sign * accel * 1000 / stepsPerMeter;
+    return motion;
+}
+
+
+//========================
+//=== encoder_getSpeed ===
+//========================
+float encoder_getSpeed(){
+    return encoder_getMotion().speedMmPerS;
 }
 
 
@@ -75,5 +221,25 @@ int encoder_getLenMm(){
 //reset counted steps / length to 0
 void encoder_reset(){
     rotary_encoder_reset(&encoder);
+    stepsOffset = 0;
+    portENTER_CRITICAL(&slipMux);
+    slipCorrectionMm = 0;
+    slipStepsPrev = 0;
+    portEXIT_CRITICAL(&slipMux);
     return;
+}
+
+
+//============================
+//=== encoder_restoreSteps ===
+//============================
+//continue counting at steps (e.g. length stored at power loss)
+void encoder_restoreSteps(int steps){
+    rotary_encoder_reset(&encoder);
+    stepsOffset = steps;
+    //correction of the restored length is not known
+    portENTER_CRITICAL(&slipMux);
+    slipCorrectionMm = 0;
+    slipStepsPrev = steps;
+    portEXIT_CRITICAL(&slipMux);
 }    
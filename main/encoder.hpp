@@ -23,6 +23,23 @@ extern QueueHandle_t encoder_queue; //encoder event queue
 //init encoder
 QueueHandle_t encoder_init();
 
+//--- encoder_setNotifyTask ---
+//notify task (xTaskNotifyGive) directly from encoder isr each time the count changed by at least 'steps'
+//the task can wait for cable movement with ulTaskNotifyTake()
+void encoder_setNotifyTask(TaskHandle_t task, int steps);
+
+
+//--- encoder_watchLength ---
+//call function once from the encoder isr when the length reaches lengthMm (coming from the current
+//length, either direction), replaces the previous watch, removed by encoder_reset/encoder_restoreSteps
+//the length is converted to steps at the current slip factor, thus watch again while the speed changes
+void encoder_watchLength(int lengthMm, void (*callbackFromIsr)(BaseType_t *taskWoken));
+
+//--- encoder_unwatch ---
+//remove watch set by encoder_watchLength
+void encoder_unwatch();
+
+
 //--- encoder_getSteps ---
 //get steps counted since last reset
 int encoder_getSteps();
@@ -30,9 +47,33 @@ int encoder_getSteps();
 
 //--- encoder_getLenMm ---
 //get current length in Mm since last reset
+//with ENCODER_SLIP_CORRECTION each increment is corrected by the factor at the current speed (slip.hpp),
+//thus it has to be called frequently while the cable moves (control loop)
 int encoder_getLenMm();
 
+
+//--- encoder_getMotion ---
+//cable speed and acceleration estimated from the times of the last encoder events (captured in isr,
+//every step or every ENCODER_PCNT_EVENT_STEPS steps with the pulse counter)
+//- high speed: average over the events of the last ENCODER_SPEED_WINDOW_US (or the event history)
+//- low speed: period of the last event, decays with the time since the last step until
+//  ENCODER_STOP_TIMEOUT_US, then 0
+typedef struct {
+    float speedMmPerS;      //negative when moving backwards
+    float accelMmPerS2;
+} encoderMotion_t;
+encoderMotion_t encoder_getMotion();
+
+//--- encoder_getSpeed ---
+//current cable speed in mm/s (see encoder_getMotion)
+float encoder_getSpeed();
+
     
 //--- encoder_reset ---
 //reset counted steps / length to 0
 void encoder_reset();
+
+
+//--- encoder_restoreSteps ---
+//continue counting at certain steps (e.g. length stored at power loss)
+void encoder_restoreSteps(int steps);
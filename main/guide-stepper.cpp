@@ -12,9 +12,12 @@ extern "C"
 #include "stepper.hpp"
 #include "config.h"
 #include "global.hpp"
+#include "params.hpp"
 #include "guide-stepper.hpp"
 #include "encoder.hpp"
-#include "shutdown.hpp"
+#include "persist.hpp"
+#include "seqlock.hpp"
+#include "adc-service.hpp"
 
 
 //macro to get smaller value out of two
@@ -31,7 +34,7 @@ extern "C"
 // speeds for testing with potentiometer (test task only)
 #define SPEED_MIN 2.0   // mm/s
 #define SPEED_MAX 70.0  // mm/s
-//note: actual speed is currently defined in config.h with STEPPER_SPEED_DEFAULT
+//note: actual speed is set by the guide (initial speed is parameter axisSpeed, default STEPPER_SPEED_DEFAULT)
 //simulate encoder with reset button to test stepper ctl task
 //note STEPPER_TEST has to be defined as well
 //#define STEPPER_SIMULATE_ENCODER
@@ -56,11 +59,15 @@ static int layerCount = 0;
 // queue for sending commands to task handling guide movement
 static QueueHandle_t queue_commandsGuideTask;
 
-// mutex to prevent multiple axis to config variables also accessed/modified by control task
-SemaphoreHandle_t configVariables_mutex = xSemaphoreCreateMutex();
+// handle of guide task, woken by encoder isr and commands
+static TaskHandle_t guideTaskHandle = NULL;
 
 // configured winding width: position the axis returns again in steps
-static uint32_t posMaxSteps = GUIDE_MAX_MM * STEPPER_STEPS_PER_MM; //assign default width
+// written by control task only, guide task reads it once per movement
+static volatile uint32_t posMaxSteps = GUIDE_MAX_MM * STEPPER_STEPS_PER_MM; //assign default width
+
+// axis position and layer count published by guide task for other tasks
+static seqlock_t<guideState_t> guideState;
 
 
 //----------------------
@@ -70,10 +77,27 @@ static uint32_t posMaxSteps = GUIDE_MAX_MM * STEPPER_STEPS_PER_MM; //assign defa
 //=============================
 //=== guide_getAxisPosSteps ===
 //=============================
-// return local variable posNow
-// needed at shutdown detection to store last axis position in nvs
+// return last axis target position published by guide task
 int guide_getAxisPosSteps(){
-    return posNow;
+    return guideState.read().posSteps;
+}
+
+
+//======================
+//=== guide_getState ===
+//======================
+// get consistent snapshot of guide position and layer count (does not block guide task)
+guideState_t guide_getState(){
+    return guideState.read();
+}
+
+
+//--------------------
+//--- publishState ---
+//--------------------
+// publish local position and layer count (guide task only)
+static void publishState(){
+    guideState.write({posNow, layerCount, posMaxSteps, currentAxisDirection == AXIS_MOVING_RIGHT});
 }
 
 
@@ -83,12 +107,11 @@ int guide_getAxisPosSteps(){
 // set custom winding width (axis position the guide returns in mm)
 void guide_setWindingWidth(uint8_t maxPosMm)
 {
-    if (xSemaphoreTake(configVariables_mutex, portMAX_DELAY) == pdTRUE) // mutex to prevent multiple access by control and stepper-ctl task
-    {
-        posMaxSteps = maxPosMm * STEPPER_STEPS_PER_MM;
-        ESP_LOGI(TAG, "set winding width / max pos to %dmm", maxPosMm);
-        xSemaphoreGive(configVariables_mutex);
-    }
+    // single 32 bit write, guide task copies the value before using it
+    posMaxSteps = maxPosMm * STEPPER_STEPS_PER_MM;
+    ESP_LOGI(TAG, "set winding width / max pos to %dmm", maxPosMm);
+    // wake guide task in case it waits for encoder movement
+    if (guideTaskHandle != NULL) xTaskNotifyGive(guideTaskHandle);
 }
 
 
@@ -128,13 +151,7 @@ uint8_t guide_targetLength2WindingWidth(int lenMm)
 // get currently configured winding width (axis position at which the guide returns in mm)
 uint8_t guide_getWindingWidth()
 {
-    if (xSemaphoreTake(configVariables_mutex, portMAX_DELAY) == pdTRUE) // mutex to prevent multiple access by control and stepper-ctl task
-    {
-        uint8_t returnValue = posMaxSteps / STEPPER_STEPS_PER_MM;
-        xSemaphoreGive(configVariables_mutex);
-        return returnValue;
-    }
-    return 0;
+    return posMaxSteps / STEPPER_STEPS_PER_MM;
 }
 
 
@@ -145,6 +162,8 @@ uint8_t guide_getWindingWidth()
 void guide_moveToZero(){
     bool valueToSend = true; // or false
     xQueueSend(queue_commandsGuideTask, &valueToSend, portMAX_DELAY);
+    // wake guide task in case it waits for encoder movement
+    if (guideTaskHandle != NULL) xTaskNotifyGive(guideTaskHandle);
     ESP_LOGI(TAG, "sending command to stepper_ctl task via queue");
 }
 
@@ -157,8 +176,11 @@ void travelSteps(int stepsTarget){
 	//TODO simplify this function, one simple calculation of new position?
 	//with new custom driver no need to detect direction change
 
+    // copy width, may be changed by control task meanwhile
+    const uint32_t posMax = posMaxSteps;
+
     // cancel when width is zero or no steps received
-    if (posMaxSteps == 0 || stepsTarget == 0){
+    if (posMax == 0 || stepsTarget == 0){
         ESP_LOGD(TAG, "travelSteps: MaxSteps or stepsTarget = 0 -> nothing to do");
         return;
     }
@@ -175,12 +197,11 @@ void travelSteps(int stepsTarget){
     while (stepsToGo != 0){
         //--- currently moving right ---
         if (currentAxisDirection == AXIS_MOVING_RIGHT){               //currently moving right
-        if (xSemaphoreTake(configVariables_mutex, portMAX_DELAY) == pdTRUE) { //prevent multiple acces on posMaxSteps by control-task
-            remaining = posMaxSteps - posNow;     //calc remaining distance fom current position to limit
+            remaining = posMax - posNow;     //calc remaining distance fom current position to limit
             if (stepsToGo > remaining){             //new distance will exceed limit
-                stepper_setTargetPosSteps(posMaxSteps);        //move to limit
+                stepper_setTargetPosSteps(posMax);        //move to limit
 				stepper_waitForStop(1000);
-                posNow = posMaxSteps;
+                posNow = posMax;
                 currentAxisDirection = AXIS_MOVING_LEFT;            //change current direction for next iteration
                 //increment/decrement layer count depending on current cable direction
                 layerCount += (stepsTarget > 0) - (stepsTarget < 0);
@@ -194,8 +215,6 @@ void travelSteps(int stepsTarget){
                 posNow += stepsToGo;
                 stepsToGo = 0;                      //finished, reset target length (could as well exit loop/break)
             }
-            xSemaphoreGive(configVariables_mutex);
-        }
         }
 
         //--- currently moving left ---
@@ -225,6 +244,7 @@ void travelSteps(int stepsTarget){
     if (stepsTarget < 0) {
     currentAxisDirection = (currentAxisDirection == AXIS_MOVING_LEFT) ? AXIS_MOVING_RIGHT : AXIS_MOVING_LEFT; //toggle between RIGHT<->Left
     }
+    publishState();
 
     return;
 }
@@ -239,6 +259,84 @@ void travelMm(int length){
 }
 
 
+#ifdef GUIDE_VELOCITY_FOLLOWING
+//---------------------
+//---- followSteps ----
+//---------------------
+//velocity following: advance the ideal axis position by steps (negative = cable spooled off)
+//reverses at the winding edges and counts layers like travelSteps, but does not move the axis
+static double posExact = 0;       //ideal axis position in steps
+static int motionDir = 1;         //direction the ideal position currently moves in (1 = right)
+static double followTarget = 0;   //target position last sent to the stepper
+
+static void followSteps(double steps, uint32_t posMax){
+    if (steps == 0) return;
+    int dir = (currentAxisDirection == AXIS_MOVING_RIGHT) ? 1 : -1;
+    // invert direction in reverse mode (cable gets spooled off reel)
+    if (steps < 0) dir = -dir;
+    double stepsToGo = fabs(steps);
+    while (stepsToGo > 0){
+        double edge = (dir > 0) ? posMax : POS_MIN_STEPS;
+        double remaining = (edge - posExact) * dir;
+        if (remaining < 0) remaining = 0; //width was reduced below current position
+        if (stepsToGo < remaining){
+            posExact += dir * stepsToGo;
+            break;
+        }
+        //reached edge -> reverse
+        posExact = edge;
+        stepsToGo -= remaining;
+        dir = -dir;
+        layerCount += (steps > 0) - (steps < 0);
+        if (layerCount < 0) layerCount = 0; //negative layers are not possible
+        ESP_LOGI(TAG, " --- follow: reached %s -> change direction, layer=%d --- ", dir < 0 ? "max" : "min", layerCount);
+    }
+    motionDir = dir;
+    currentAxisDirection = ((dir > 0) != (steps < 0)) ? AXIS_MOVING_RIGHT : AXIS_MOVING_LEFT;
+    posNow = posExact;
+}
+
+
+//-----------------------
+//---- followCommand ----
+//-----------------------
+//velocity following: set stepper speed from cable speed (feed forward) plus correction of the lag,
+//keep target ahead of the ideal position so the stepper does not stop while the cable moves.
+//At the edges the target is the edge, the reversed target is sent as soon as the ideal position
+//reversed, thus the stepper isr only decelerates to min speed and changes direction.
+//Once the cable stopped the guide moves back to the ideal position at min speed (lead is not needed anymore).
+static void followCommand(float cableSpeedMmPerS, float diameter, uint32_t posMax){
+    if (cableSpeedMmPerS == 0) {
+        stepper_setSpeedSteps(0);
+        if ((uint32_t)posExact != (uint32_t)followTarget) {
+            stepper_setTargetPosSteps((uint32_t)posExact);
+        }
+        followTarget = posExact;
+        return;
+    }
+    float guideSpeed = fabs(cableSpeedMmPerS) * param_getInt(PARAM_CABLE_DIAMETER) / (PI * diameter) * STEPPER_STEPS_PER_MM; //steps/s
+    float lag = (posExact - (double)stepper_getState().posSteps) * motionDir; //steps behind ideal position
+    float speed = guideSpeed + lag * GUIDE_FOLLOW_GAIN;
+    stepper_setSpeedSteps(speed > 0 ? speed : 0);
+
+    //lead has to exceed the decel distance, otherwise the stepper isr already decelerates
+    double lead = guideSpeed * GUIDE_FOLLOW_LEAD_MS / 1000
+        + (double)speed * speed / (2 * param_getInt(PARAM_AXIS_DECEL) * STEPPER_STEPS_PER_MM);
+    double target = posExact + motionDir * lead;
+    if (target > posMax) target = posMax;
+    if (target < POS_MIN_STEPS) target = POS_MIN_STEPS;
+    //lead shrinks while cable slows down -> do not pull target back (would reverse the stepper)
+    if ((target - followTarget) * motionDir < 0 && (followTarget - posExact) * motionDir > 0) {
+        target = followTarget;
+    }
+    if ((uint32_t)target != (uint32_t)followTarget) {
+        stepper_setTargetPosSteps((uint32_t)target);
+    }
+    followTarget = target;
+}
+#endif
+
+
 //----------------------
 //---- init_stepper ----
 //----------------------
@@ -258,7 +356,7 @@ void init_stepper() {
 //--------------------------
 //function that updates speed value using ADC input and configured MIN/MAX - used for testing only
 void updateSpeedFromAdc() {
-    int potiRead = gpio_readAdc(ADC_CHANNEL_POTI); //0-4095 GPIO34
+    int potiRead = adcService_get(ADC_CHANNEL_POTI); //0-4095 GPIO34
     double poti = potiRead/4095.0;
     int speed = poti*(SPEED_MAX-SPEED_MIN) + SPEED_MIN;
 	stepper_setSpeed(speed);
@@ -360,7 +458,6 @@ void task_stepper_ctl(void *pvParameter)
 
     double cableLen = 0;
     double travelStepsExact = 0; //steps axis has to travel
-    int travelStepsFull = 0;
     double travelMm = 0;
     double turns = 0;
     float currentDiameter;
@@ -371,19 +468,48 @@ void task_stepper_ctl(void *pvParameter)
     init_stepper();
     //define zero-position
     // use last known position stored at last shutdown to reduce time crashing into hardware limit
-    int posLastShutdown = nvsReadLastAxisPosSteps();
-    if (posLastShutdown >= 0)
-    { // would be -1 when failed
+    powerFailState_t resume;
+    bool resumeValid = persist_getResumeState(&resume);
+    if (resumeValid)
+    {
+        int posLastShutdown = resume.axisPosSteps;
         ESP_LOGW(TAG, "auto-home: considerting pos last shutdown %dmm + tolerance %dmm",
         posLastShutdown / STEPPER_STEPS_PER_MM, 
         AUTO_HOME_TRAVEL_ADD_TO_LAST_POS_MM);
         // home considering last position and offset, but limit to max distance possible
         stepper_home(MIN((posLastShutdown/STEPPER_STEPS_PER_MM + AUTO_HOME_TRAVEL_ADD_TO_LAST_POS_MM), MAX_TOTAL_AXIS_TRAVEL_MM));
     }
-    else { // default to max travel when read from nvs failed
+    else { // default to max travel when no position was stored
         stepper_home(MAX_TOTAL_AXIS_TRAVEL_MM);
     }
 
+    // continue partially wound reel: restore layers, direction and position
+    if (resumeValid)
+    {
+        posMaxSteps = resume.windingWidthSteps;
+        layerCount = resume.layerCount;
+        currentAxisDirection = resume.guideMovingRight ? AXIS_MOVING_RIGHT : AXIS_MOVING_LEFT;
+        posNow = resume.guidePosSteps;
+#ifdef GUIDE_VELOCITY_FOLLOWING
+        posExact = posNow;
+        followTarget = posNow;
+        motionDir = resume.guideMovingRight ? 1 : -1;
+#endif
+        stepper_setTargetPosSteps(posNow);
+        stepper_waitForStop();
+        // length was restored already, only follow cable movement from now on
+        encStepsPrev = encoder_getSteps();
+        publishState();
+        ESP_LOGW(TAG, "resumed guide at %dmm, layer %d, moving %s",
+                posNow / STEPPER_STEPS_PER_MM, layerCount, resume.guideMovingRight ? "right" : "left");
+    }
+
+    // get woken by encoder isr when cable moved instead of polling the encoder
+    guideTaskHandle = xTaskGetCurrentTaskHandle();
+#ifndef STEPPER_SIMULATE_ENCODER
+    encoder_setNotifyTask(guideTaskHandle, GUIDE_ENCODER_NOTIFY_STEPS);
+#endif
+
     //repeatedly read changes in measured cable length and move axis accordingly
     while(1){
 
@@ -426,6 +552,12 @@ void task_stepper_ctl(void *pvParameter)
             posNow = 0;
             layerCount = 0;
             currentAxisDirection = AXIS_MOVING_RIGHT;
+#ifdef GUIDE_VELOCITY_FOLLOWING
+            posExact = 0;
+            followTarget = 0;
+            motionDir = 1;
+#endif
+            publishState();
             ESP_LOGW(TAG, "at position 0, reset variables, resuming normal cable guiding operation");
         }
 
@@ -441,14 +573,24 @@ void task_stepper_ctl(void *pvParameter)
         //ESP_LOGI(TAG, "current poti-modifier = %f", potiModifier);
 
         //calculate steps to move
-        cableLen = (double)encStepsDelta * 1000 / ENCODER_STEPS_PER_METER;
+        cableLen = (double)encStepsDelta * 1000 / param_getFloat(PARAM_ENC_STEPS_PER_M);
         //effective diameter increases each layer
-        currentDiameter = D_REEL + LAYER_THICKNESS_MM * 2 * layerCount;
+        currentDiameter = param_getInt(PARAM_REEL_DIAMETER) + param_getInt(PARAM_LAYER_THICKNESS) * 2 * layerCount;
         turns = cableLen / (PI * currentDiameter);
-        travelMm = turns * D_CABLE;
+        travelMm = turns * param_getInt(PARAM_CABLE_DIAMETER);
         travelStepsExact = travelMm * STEPPER_STEPS_PER_MM  +  travelStepsPartial; //convert mm to steps and add not moved partial steps
+#ifdef GUIDE_VELOCITY_FOLLOWING
+        //follow continuously, partial steps are kept in the ideal position
+        {
+            const uint32_t posMax = posMaxSteps; // may be changed by control task meanwhile
+            followSteps(travelStepsExact, posMax);
+            followCommand(encoder_getSpeed(), currentDiameter, posMax);
+        }
+        encStepsPrev = encStepsNow;
+        publishState();
+#else
         travelStepsPartial = 0;
-        travelStepsFull = (int)travelStepsExact;
+        int travelStepsFull = (int)travelStepsExact;
 
         //move axis when ready to move at least 1 full step
         if (abs(travelStepsFull) > 1){
@@ -458,10 +600,20 @@ void task_stepper_ctl(void *pvParameter)
             travelSteps(travelStepsExact);
             encStepsPrev = encStepsNow; //update previous length
         }
-        else {
-            //TODO use encoder queue to only run this check at encoder event?
-            vTaskDelay(5);
-        }
-		vTaskDelay(5 / portTICK_PERIOD_MS);
+#endif
+
+#ifdef STEPPER_SIMULATE_ENCODER
+        vTaskDelay(5);
+#else
+        //sleep until encoder isr reports cable movement (or command received)
+        //notifications while moving accumulate, thus no movement is missed
+#ifdef GUIDE_VELOCITY_FOLLOWING
+        //no notification arrives when the cable stops: while the target is ahead of the ideal position
+        //wake up after the lead time to update the speed and finally retarget to the ideal position
+        ulTaskNotifyTake(pdTRUE, followTarget == posExact ? portMAX_DELAY : pdMS_TO_TICKS(GUIDE_FOLLOW_LEAD_MS));
+#else
+        ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+#endif
+#endif
     }
 }
@@ -1,4 +1,13 @@
 #pragma once
+#include <stdint.h>
+
+//state of the cable guide, published by guide task
+typedef struct {
+    uint32_t posSteps;      //axis target position calculated from cable movement
+    int layerCount;         //cable layers on reel
+    uint32_t maxPosSteps;   //winding width the position was calculated with
+    bool movingRight;       //current direction of the guide
+} guideState_t;
 
 //task that initializes and controls the stepper motor
 //current functionality: 
@@ -16,10 +25,12 @@ void task_stepper_ctl(void *pvParameter);
 void guide_moveToZero();
 
 
-// return local variable posNow that stores the current position of cable guide axis in steps
-// needed by shutdown to store last axis position in nvs
+// return last published position of cable guide axis in steps
 int guide_getAxisPosSteps();
 
+// get consistent snapshot of guide position and layer count without blocking the guide task
+guideState_t guide_getState();
+
 // set custom winding width (axis position the guide returns in mm)
 void guide_setWindingWidth(uint8_t maxPosMm);
 
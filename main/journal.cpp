@@ -0,0 +1,275 @@
+#include <string.h>
+#include "journal.hpp"
+
+//---------------------
+//--- configuration ---
+//---------------------
+//largest supported slot (record buffer is on the stack of the appending task)
+#define JOURNAL_MAX_SLOT_SIZE 256
+//bytes read at once when checking that a sector is erased
+#define ERASED_CHECK_CHUNK 64
+
+#define ERASED_WORD 0xFFFFFFFF
+
+//slot layout: sequence | payload (padded to 4 bytes) | crc | mark
+#define SEQUENCE_OFFSET 0
+#define PAYLOAD_OFFSET 4
+#define PADDED(size) (((size) + 3) & ~3u)
+#define CRC_OFFSET(journal) (PAYLOAD_OFFSET + PADDED((journal)->payloadSize))
+#define MARK_OFFSET(journal) (CRC_OFFSET(journal) + 4)
+
+
+
+//----------------------
+//----- functions ------
+//----------------------
+
+//---------------
+//---- crc32 ----
+//---------------
+//crc-32 (ieee, same as esp_rom_crc32_le), bitwise: records are small
+static uint32_t crc32(const uint8_t *data, uint32_t length){
+    uint32_t crc = ERASED_WORD;
+    for (uint32_t i = 0; i < length; i++) {
+        crc ^= data[i];
+        for (int bit = 0; bit < 8; bit++) {
+            crc = (crc >> 1) ^ (0xEDB88320 & -(crc & 1));
+        }
+    }
+    return ~crc;
+}
+
+
+//--- helpers ---
+static uint32_t slotOffset(const journal_t *journal, uint32_t sector, uint32_t slot){
+    return sector * journal->flash.sectorSize + slot * journal->slotSize;
+}
+
+static int readWord(journal_t *journal, uint32_t offset, uint32_t *word){
+    journal->openReads++;
+    return journal->flash.read(journal->flash.ctx, offset, word, sizeof(*word));
+}
+
+
+//------------------
+//---- readSlot ----
+//------------------
+//read slot at offset into buf (without mark), returns true when crc is valid
+static bool readSlot(journal_t *journal, uint32_t offset, uint8_t *buf){
+    journal->openReads++;
+    uint32_t length = CRC_OFFSET(journal) + 4;
+    if (journal->flash.read(journal->flash.ctx, offset, buf, length) != 0) return false;
+    uint32_t sequence, crc;
+    memcpy(&sequence, buf + SEQUENCE_OFFSET, 4);
+    memcpy(&crc, buf + CRC_OFFSET(journal), 4);
+    return sequence != ERASED_WORD && crc == crc32(buf, CRC_OFFSET(journal));
+}
+
+
+//-----------------------
+//---- sectorErased -----
+//-----------------------
+//check that every byte of a sector is erased (an erase may have been interrupted by power loss)
+static bool sectorErased(journal_t *journal, uint32_t sector){
+    uint8_t chunk[ERASED_CHECK_CHUNK];
+    for (uint32_t pos = 0; pos < journal->flash.sectorSize; pos += sizeof(chunk)) {
+        journal->openReads++;
+        if (journal->flash.read(journal->flash.ctx, sector * journal->flash.sectorSize + pos, chunk, sizeof(chunk)) != 0) return false;
+        for (uint8_t byte : chunk) {
+            if (byte != 0xFF) return false;
+        }
+    }
+    return true;
+}
+
+
+
+//====================
+//=== journal_open ===
+//====================
+int journal_open(journal_t *journal, const journalFlash_t *flash, uint32_t payloadSize){
+    memset(journal, 0, sizeof(*journal));
+    journal->flash = *flash;
+    journal->payloadSize = payloadSize;
+    journal->slotSize = (MARK_OFFSET(journal) + 4 + 15) & ~15u;
+    journal->latestOffset = -1;
+    if (flash->sectorCount < 3 || journal->slotSize > JOURNAL_MAX_SLOT_SIZE || journal->slotSize > flash->sectorSize) {
+        return -1;
+    }
+    journal->slotsPerSector = flash->sectorSize / journal->slotSize;
+    uint8_t buf[JOURNAL_MAX_SLOT_SIZE];
+
+    //--- find head sector: newest valid first record ---
+    //first slot of a sector is written first, its sequence orders the sectors
+    bool found = false;
+    uint32_t sequenceMax = 0;
+    for (uint32_t sector = 0; sector < flash->sectorCount; sector++) {
+        if (!readSlot(journal, slotOffset(journal, sector, 0), buf)) continue;
+        uint32_t sequence;
+        memcpy(&sequence, buf + SEQUENCE_OFFSET, 4);
+        if (!found || sequence > sequenceMax) {
+            found = true;
+            sequenceMax = sequence;
+            journal->headSector = sector;
+        }
+    }
+
+    if (!found) {
+        //--- empty journal: start at sector 0 ---
+        journal->headSector = 0;
+        journal->headSlot = 0;
+        journal->sequence = 1;
+        if (!sectorErased(journal, 0) && flash->erase(flash->ctx, 0, flash->sectorSize) != 0) return -1;
+    } else {
+        //--- find first unused slot in head sector (slots are used in order) ---
+        uint32_t low = 1, high = journal->slotsPerSector;
+        while (low < high) {
+            uint32_t mid = (low + high) / 2;
+            uint32_t sequence;
+            if (readWord(journal, slotOffset(journal, journal->headSector, mid) + SEQUENCE_OFFSET, &sequence) != 0) return -1;
+            if (sequence == ERASED_WORD) high = mid;
+            else low = mid + 1;
+        }
+        journal->headSlot = low;
+
+        //--- latest valid record: last used slot, unless its write was torn ---
+        for (int slot = journal->headSlot - 1; slot >= 0; slot--) {
+            uint32_t offset = slotOffset(journal, journal->headSector, slot);
+            if (readSlot(journal, offset, buf)) {
+                journal->latestOffset = offset;
+                memcpy(&journal->sequence, buf + SEQUENCE_OFFSET, 4);
+                journal->sequence++;
+                break;
+            }
+        }
+    }
+
+    //--- sector ahead of head ---
+    journal->aheadErased = sectorErased(journal, (journal->headSector + 1) % flash->sectorCount);
+    return 0;
+}
+
+
+
+//==========================
+//=== journal_readLatest ===
+//==========================
+bool journal_readLatest(journal_t *journal, void *payload, uint32_t *mark){
+    if (journal->latestOffset < 0) return false;
+    uint8_t buf[JOURNAL_MAX_SLOT_SIZE];
+    uint32_t length = MARK_OFFSET(journal) + 4;
+    if (journal->flash.read(journal->flash.ctx, journal->latestOffset, buf, length) != 0) return false;
+    memcpy(payload, buf + PAYLOAD_OFFSET, journal->payloadSize);
+    if (mark != nullptr) memcpy(mark, buf + MARK_OFFSET(journal), 4);
+    return true;
+}
+
+
+
+//======================
+//=== journal_append ===
+//======================
+int journal_append(journal_t *journal, const void *payload, bool useReserve){
+    //--- head sector full (except reserved slot): sector ahead has to be erased ---
+    uint32_t reserved = (journal->aheadErased || useReserve) ? 0 : 1;
+    if (journal->headSlot + reserved >= journal->slotsPerSector) {
+        uint32_t next = (journal->headSector + 1) % journal->flash.sectorCount;
+        if (!journal->aheadErased) {
+            if (journal->erasing) return JOURNAL_BUSY;
+            //maintenance was missed, erase now (slow)
+            if (journal->flash.erase(journal->flash.ctx, next * journal->flash.sectorSize, journal->flash.sectorSize) != 0) return -1;
+            journal->aheadErased = true;
+        }
+    }
+
+    //--- head sector full: continue in erased sector ahead ---
+    if (journal->headSlot >= journal->slotsPerSector) {
+        uint32_t next = (journal->headSector + 1) % journal->flash.sectorCount;
+        journal->headSector = next;
+        journal->headSlot = 0;
+        journal->aheadErased = false; //contains the oldest records
+    }
+
+    //--- build and program slot (without mark) ---
+    uint8_t buf[JOURNAL_MAX_SLOT_SIZE];
+    uint32_t length = CRC_OFFSET(journal) + 4;
+    memset(buf, 0, length);
+    memcpy(buf + SEQUENCE_OFFSET, &journal->sequence, 4);
+    memcpy(buf + PAYLOAD_OFFSET, payload, journal->payloadSize);
+    uint32_t crc = crc32(buf, CRC_OFFSET(journal));
+    memcpy(buf + CRC_OFFSET(journal), &crc, 4);
+
+    uint32_t offset = slotOffset(journal, journal->headSector, journal->headSlot);
+    //slot is used even if programming failed
+    journal->headSlot++;
+    journal->sequence++;
+    if (journal->flash.write(journal->flash.ctx, offset, buf, length) != 0) return -1;
+    journal->latestOffset = offset;
+    return 0;
+}
+
+
+
+//==========================
+//=== journal_markLatest ===
+//==========================
+int journal_markLatest(journal_t *journal, uint32_t mark){
+    if (journal->latestOffset < 0) return -1;
+    return journal->flash.write(journal->flash.ctx, journal->latestOffset + MARK_OFFSET(journal), &mark, sizeof(mark));
+}
+
+
+
+//================================
+//=== journal_needsMaintenance ===
+//================================
+bool journal_needsMaintenance(const journal_t *journal){
+    return !journal->aheadErased;
+}
+
+
+
+//========================
+//=== journal_maintain ===
+//========================
+int journal_maintain(journal_t *journal){
+    uint32_t sector;
+    if (!journal_maintainBegin(journal, &sector)) return 0;
+    int err = journal_maintainErase(journal, sector);
+    journal_maintainEnd(journal, sector, err);
+    return err;
+}
+
+
+
+//=============================
+//=== journal_maintainBegin ===
+//=============================
+bool journal_maintainBegin(journal_t *journal, uint32_t *sector){
+    if (journal->aheadErased || journal->erasing) return false;
+    //head does not move while erasing: only into an erased sector ahead
+    *sector = (journal->headSector + 1) % journal->flash.sectorCount;
+    journal->erasing = true;
+    return true;
+}
+
+
+
+//=============================
+//=== journal_maintainErase ===
+//=============================
+int journal_maintainErase(const journal_t *journal, uint32_t sector){
+    return journal->flash.erase(journal->flash.ctx, sector * journal->flash.sectorSize, journal->flash.sectorSize);
+}
+
+
+
+//===========================
+//=== journal_maintainEnd ===
+//===========================
+void journal_maintainEnd(journal_t *journal, uint32_t sector, int err){
+    journal->erasing = false;
+    if (err == 0 && sector == (journal->headSector + 1) % journal->flash.sectorCount) {
+        journal->aheadErased = true;
+    }
+}
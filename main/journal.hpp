@@ -0,0 +1,72 @@
+#pragma once
+#include <stdint.h>
+
+//append-only journal of fixed-size records in a raw flash area (used as ring over all sectors)
+//- each record holds the complete state (payload), only the latest record is of interest
+//- slot: sequence | payload | crc | mark, written in address order -> a torn write fails the crc
+//- sectors are erased one ahead of the head (journal_maintain), appending only programs flash
+//- last slot of the head sector is reserved for urgent records while the sector ahead is not erased,
+//  the erase can run without lock (journal_maintainBegin/Erase/End), urgent records never wait for it
+//- open: find head with one read per sector plus binary search in the head sector
+//- wear is distributed evenly, every sector is erased once per pass through the ring
+//no dependency on esp-idf, flash access is provided by the caller (tested on host in testing/journal)
+
+
+//flash access used by the journal, offsets relative to start of the journal area
+//functions return 0 on success
+typedef struct {
+    int (*read)(void *ctx, uint32_t offset, void *dst, uint32_t size);
+    int (*write)(void *ctx, uint32_t offset, const void *src, uint32_t size); //can only clear bits
+    int (*erase)(void *ctx, uint32_t offset, uint32_t size);                  //whole sectors, sets bits
+    void *ctx;
+    uint32_t sectorSize;
+    uint32_t sectorCount;   //at least 3
+} journalFlash_t;
+
+typedef struct {
+    journalFlash_t flash;
+    uint32_t payloadSize;
+    uint32_t slotSize;
+    uint32_t slotsPerSector;
+    uint32_t headSector;        //sector the next record is written to
+    uint32_t headSlot;          //slot in head sector the next record is written to
+    uint32_t sequence;          //sequence number of the next record
+    int64_t latestOffset;       //offset of latest valid record, -1 if none
+    bool aheadErased;           //sector after head sector is erased
+    bool erasing;               //sector after head sector is being erased (journal_maintainBegin)
+    uint32_t openReads;         //flash reads needed by journal_open (statistics)
+} journal_t;
+
+
+//find latest record and head, journal is empty when no valid record exists
+//returns 0 on success, -1 on invalid configuration or flash error
+int journal_open(journal_t *journal, const journalFlash_t *flash, uint32_t payloadSize);
+
+//copy payload of latest record, returns false when journal is empty
+//mark: value programmed with journal_markLatest(), 0xFFFFFFFF if not marked (optional)
+bool journal_readLatest(journal_t *journal, void *payload, uint32_t *mark = nullptr);
+
+//returned by journal_append when the record needs the sector that is currently being erased
+#define JOURNAL_BUSY -2
+
+//write payload as new latest record
+//only programs flash, except when journal_maintain() was not called since the head entered a new sector
+//useReserve: urgent record (power loss) may use the reserved slot, does not wait for a running erase
+int journal_append(journal_t *journal, const void *payload, bool useReserve = false);
+
+//program the mark word of the latest record once (not covered by crc), e.g. time it took to write
+int journal_markLatest(journal_t *journal, uint32_t mark);
+
+//true when the sector ahead of the head has to be erased
+bool journal_needsMaintenance(const journal_t *journal);
+
+//erase the sector ahead of the head (slow, call from a low priority context)
+int journal_maintain(journal_t *journal);
+
+//journal_maintain in steps, for erasing without holding the lock that serializes the other calls:
+//begin (locked): returns false when nothing has to be erased, otherwise sector to pass to erase and end
+bool journal_maintainBegin(journal_t *journal, uint32_t *sector);
+//erase (unlocked, slow): only accesses the flash, appends continue in the head sector meanwhile
+int journal_maintainErase(const journal_t *journal, uint32_t sector);
+//end (locked): err is the result of journal_maintainErase
+void journal_maintainEnd(journal_t *journal, uint32_t sector, int err);
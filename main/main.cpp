@@ -19,6 +19,14 @@ extern "C"
 #include "guide-stepper.hpp"
 #include "encoder.hpp"
 #include "shutdown.hpp"
+#include "persist.hpp"
+#include "adc-service.hpp"
+#include "console.hpp"
+#include "cutter.hpp"
+#include "vfd.hpp"
+#include "params.hpp"
+#include "slip.hpp"
+#include "gpio_inputEvents.hpp"
 
 #include "stepper.hpp"
 
@@ -58,11 +66,8 @@ void init_gpios(){
     gpio_configure_output(GPIO_NUM_17);
 
     //--- inputs ---
-    //initialize and configure ADC
-    adc1_config_width(ADC_WIDTH_BIT_12); //=> max resolution 4096
-    adc1_config_channel_atten(ADC_CHANNEL_POTI, ADC_ATTEN_DB_11); //max voltage
-
-    adc1_config_channel_atten(ADC_CHANNEL_SUPPLY_VOLTAGE, ADC_ATTEN_DB_11); //max voltage
+    //initialize and configure ADC, start background sampling
+    adcService_init();
 }
 
 
@@ -86,12 +91,27 @@ extern "C" void app_main()
 {
     //init outputs and adc
     init_gpios();
+    //analog or modbus speed reference (VFD_ANALOG_SPEED, VFD_MODBUS)
+    vfd_init();
 
     //enable 5V volage regulator (needed for display)
     gpio_set_level(GPIO_NUM_17, 1);
 
     //init encoder (global)
     encoder_queue = encoder_init();
+
+#ifdef INPUTS_INTERRUPT_DRIVEN
+    //detect edges of gpio switches by interrupt (installs the gpio isr service unless the gpio encoder did already,
+    //the pcnt encoder registers its own interrupt)
+    //edges wake the control task (no queue, control reads the debounced state of the switches)
+    gpioInputs_init(INPUTS_TASK_PRIORITY, 0);
+    gpioInputs_add(&SW_START, control_onInputEdge);
+    gpioInputs_add(&SW_RESET, control_onInputEdge);
+    gpioInputs_add(&SW_CUT, control_onInputEdge);
+    gpioInputs_add(&SW_AUTO_CUT, control_onInputEdge);
+    //stop cutter motor right at the debounced idle position edge
+    gpioInputs_add(&SW_CUTTER_POS, cutter_onPositionEdge);
+#endif
     
     //define loglevel
     esp_log_level_set("*", ESP_LOG_INFO); //default loglevel
@@ -109,16 +129,31 @@ extern "C" void app_main()
     xTaskCreate(task_stepper_test, "task_stepper_test", configMINIMAL_STACK_SIZE * 3, NULL, 2, NULL);
     //xTaskCreate(task_stepper_debug, "task_stepper_test", configMINIMAL_STACK_SIZE * 3, NULL, 2, NULL);
 #else
+    //init nvs and load state stored at last power loss
+    shutdown_init();
+    //load parameters changed at runtime (defaults from config.h until then)
+    param_init();
+    //load length correction tables
+    slip_init();
+    //continue counting length of a partially wound reel
+    powerFailState_t resume;
+    if (persist_getResumeState(&resume)) encoder_restoreSteps(resume.encoderSteps);
+
+    //create task for storing counters and settings
+    xTaskCreate(&task_persist, "task_persist", 2560, NULL, 1, NULL);
+
     //create task for detecting power-off
-    xTaskCreate(&task_shutDownDetection, "task_shutdownDet", 2048, NULL, 2, NULL);
-    // wait for nvs to be initialized in shutDownDetection task
-    vTaskDelay(50 / portTICK_PERIOD_MS);
+    //highest priority: has to store the state before the supply drops further
+    xTaskCreate(&task_shutDownDetection, "task_shutdownDet", 2048, NULL, 6, NULL);
 
     //create task for controlling the machine
     xTaskCreate(task_control, "task_control", configMINIMAL_STACK_SIZE * 3, NULL, 4, NULL);
 
     //create task for controlling the stepper motor (linear axis that guids the cable)
     xTaskCreate(task_stepper_ctl, "task_stepper_ctl", configMINIMAL_STACK_SIZE * 3, NULL, 2, NULL);
+
+    //create task for console commands (e.g. telemetry export)
+    xTaskCreate(task_console, "task_console", 3072, NULL, 1, NULL);
 #endif
 
     //create task for handling the buzzer
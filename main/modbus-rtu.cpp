@@ -0,0 +1,166 @@
+extern "C"
+{
+#include <string.h>
+#include <freertos/FreeRTOS.h>
+#include <freertos/task.h>
+#include "esp_log.h"
+#include "driver/uart.h"
+}
+
+#include "modbus-rtu.hpp"
+
+
+//----------------------
+//----- variables ------
+//----------------------
+static const char *TAG = "modbus";
+const char *modbusResultStr[5] = {"OK", "TIMEOUT", "CRC_ERROR", "EXCEPTION", "INVALID_RESPONSE"};
+
+#define FUNCTION_READ_REGISTERS 0x03
+#define FUNCTION_WRITE_REGISTER 0x06
+#define FUNCTION_EXCEPTION_FLAG 0x80
+#define REGISTERS_MAX 125
+//slave id + function + byte count + 2 * REGISTERS_MAX + crc
+#define FRAME_LENGTH_MAX (3 + 2 * REGISTERS_MAX + 2)
+#define RX_BUFFER_SIZE 512 //driver minimum is larger than a frame
+
+
+
+//----------------------
+//----- functions ------
+//----------------------
+static void appendCrc(uint8_t *frame, size_t length){
+    uint16_t crc = modbus_crc16(frame, length);
+    frame[length] = crc & 0xFF;
+    frame[length + 1] = crc >> 8;
+}
+
+//send request and read response of expected length (exception responses are shorter)
+//the response length is known after the first 3 bytes, thus no frame gap detection is needed
+static modbusResult_t transaction(modbus_t *bus, const uint8_t *request, size_t requestLength,
+        uint8_t *response, size_t responseLength){
+    bus->transactions++;
+    //drop late response of a previous transaction
+    uart_flush_input(bus->uart);
+    uart_write_bytes(bus->uart, (const char *)request, requestLength);
+    uart_wait_tx_done(bus->uart, pdMS_TO_TICKS(bus->timeoutMs));
+
+    //--- header ---
+    TickType_t deadline = xTaskGetTickCount() + pdMS_TO_TICKS(bus->timeoutMs);
+    int received = uart_read_bytes(bus->uart, response, 3, pdMS_TO_TICKS(bus->timeoutMs));
+    modbusResult_t result = MODBUS_OK;
+    if (received < 3) {
+        result = MODBUS_TIMEOUT;
+    } else if (response[0] != request[0] || (response[1] & ~FUNCTION_EXCEPTION_FLAG) != request[1]) {
+        result = MODBUS_INVALID_RESPONSE;
+    } else {
+        //--- remaining bytes ---
+        size_t length = (response[1] & FUNCTION_EXCEPTION_FLAG) ? 5 : responseLength;
+        TickType_t now = xTaskGetTickCount();
+        TickType_t ticksLeft = (int32_t)(deadline - now) > 0 ? deadline - now : 0;
+        received += uart_read_bytes(bus->uart, response + 3, length - 3, ticksLeft);
+        if ((size_t)received < length) {
+            result = MODBUS_TIMEOUT;
+        } else if (modbus_crc16(response, length - 2) != (response[length - 2] | (response[length - 1] << 8))) {
+            result = MODBUS_CRC_ERROR;
+        } else if (response[1] & FUNCTION_EXCEPTION_FLAG) {
+            bus->exceptionCode = response[2];
+            result = MODBUS_EXCEPTION;
+        }
+    }
+    if (result != MODBUS_OK) {
+        bus->errors++;
+        ESP_LOGD(TAG, "function 0x%02x: %s (%d bytes received)", request[1], modbusResultStr[result], received);
+    }
+    return result;
+}
+
+
+
+//===================
+//=== modbus_init ===
+//===================
+esp_err_t modbus_init(modbus_t *bus, uart_port_t uart, int baud, int txPin, int rxPin, int dePin,
+        uint8_t slaveId, uint32_t timeoutMs){
+    memset(bus, 0, sizeof(*bus));
+    bus->uart = uart;
+    bus->slaveId = slaveId;
+    bus->timeoutMs = timeoutMs;
+
+    uart_config_t config = {};
+    config.baud_rate = baud;
+    config.data_bits = UART_DATA_8_BITS;
+    config.parity = UART_PARITY_DISABLE;
+    config.stop_bits = UART_STOP_BITS_1;
+    config.flow_ctrl = UART_HW_FLOWCTRL_DISABLE;
+    config.source_clk = UART_SCLK_APB;
+    esp_err_t err = uart_driver_install(uart, RX_BUFFER_SIZE, 0, 0, NULL, 0);
+    if (err == ESP_OK) err = uart_param_config(uart, &config);
+    //driver enable of the transceiver is the rts pin
+    if (err == ESP_OK) err = uart_set_pin(uart, txPin, rxPin, dePin, UART_PIN_NO_CHANGE);
+    if (err == ESP_OK && dePin != UART_PIN_NO_CHANGE) err = uart_set_mode(uart, UART_MODE_RS485_HALF_DUPLEX);
+    if (err != ESP_OK) {
+        ESP_LOGE(TAG, "uart %d: init failed (%s)", (int)uart, esp_err_to_name(err));
+        return err;
+    }
+    ESP_LOGI(TAG, "uart %d: %d baud, slave %d", (int)uart, baud, slaveId);
+    return ESP_OK;
+}
+
+
+
+//============================
+//=== modbus_readRegisters ===
+//============================
+modbusResult_t modbus_readRegisters(modbus_t *bus, uint16_t address, uint16_t count, uint16_t *values){
+    if (count == 0 || count > REGISTERS_MAX) return MODBUS_INVALID_RESPONSE;
+    uint8_t request[8] = {bus->slaveId, FUNCTION_READ_REGISTERS,
+            (uint8_t)(address >> 8), (uint8_t)address, (uint8_t)(count >> 8), (uint8_t)count};
+    appendCrc(request, 6);
+    uint8_t response[FRAME_LENGTH_MAX];
+    modbusResult_t result = transaction(bus, request, sizeof(request), response, 3 + 2 * count + 2);
+    if (result == MODBUS_OK && response[2] != 2 * count) {
+        bus->errors++;
+        result = MODBUS_INVALID_RESPONSE;
+    }
+    if (result != MODBUS_OK) return result;
+    for (int i = 0; i < count; i++) {
+        values[i] = (response[3 + 2 * i] << 8) | response[4 + 2 * i];
+    }
+    return MODBUS_OK;
+}
+
+
+
+//============================
+//=== modbus_writeRegister ===
+//============================
+modbusResult_t modbus_writeRegister(modbus_t *bus, uint16_t address, uint16_t value){
+    uint8_t request[8] = {bus->slaveId, FUNCTION_WRITE_REGISTER,
+            (uint8_t)(address >> 8), (uint8_t)address, (uint8_t)(value >> 8), (uint8_t)value};
+    appendCrc(request, 6);
+    //response is an echo of the request
+    uint8_t response[8];
+    modbusResult_t result = transaction(bus, request, sizeof(request), response, sizeof(response));
+    if (result == MODBUS_OK && memcmp(request, response, sizeof(request)) != 0) {
+        bus->errors++;
+        result = MODBUS_INVALID_RESPONSE;
+    }
+    return result;
+}
+
+
+
+//====================
+//=== modbus_crc16 ===
+//====================
+uint16_t modbus_crc16(const uint8_t *data, size_t length){
+    uint16_t crc = 0xFFFF;
+    for (size_t i = 0; i < length; i++) {
+        crc ^= data[i];
+        for (int bit = 0; bit < 8; bit++) {
+            crc = (crc & 1) ? (crc >> 1) ^ 0xA001 : crc >> 1;
+        }
+    }
+    return crc;
+}
@@ -0,0 +1,47 @@
+#pragma once
+#include <stdint.h>
+#include <stddef.h>
+extern "C" {
+#include "driver/uart.h"
+}
+
+//modbus rtu client (master) on a uart with rs485 transceiver, used for the vfd (VFD_MODBUS, vfd.cpp)
+//Transactions are blocking: request is sent, the response is read with timeout and checked
+//(slave id, function code, length, crc). Only one task may use a bus.
+//Supported: read holding registers (0x03), write single register (0x06).
+
+
+//result of a transaction
+typedef enum {
+    MODBUS_OK,
+    MODBUS_TIMEOUT,          //no or incomplete response
+    MODBUS_CRC_ERROR,
+    MODBUS_EXCEPTION,        //slave responded with exception code (modbus_t.exceptionCode)
+    MODBUS_INVALID_RESPONSE  //other slave id, function or length
+} modbusResult_t;
+
+extern const char *modbusResultStr[5];
+
+typedef struct {
+    uart_port_t uart;
+    uint8_t slaveId;
+    uint32_t timeoutMs;      //response has to be complete within this time after the request was sent
+    //statistics
+    uint32_t transactions;
+    uint32_t errors;
+    uint8_t exceptionCode;   //of the last MODBUS_EXCEPTION
+} modbus_t;
+
+
+//install uart driver (8N1, rs485 half duplex when dePin is a gpio, UART_PIN_NO_CHANGE = auto direction transceiver)
+esp_err_t modbus_init(modbus_t *bus, uart_port_t uart, int baud, int txPin, int rxPin, int dePin,
+        uint8_t slaveId, uint32_t timeoutMs);
+
+//read count consecutive holding registers starting at address into values (one transaction, max 125)
+modbusResult_t modbus_readRegisters(modbus_t *bus, uint16_t address, uint16_t count, uint16_t *values);
+
+//write one holding register
+modbusResult_t modbus_writeRegister(modbus_t *bus, uint16_t address, uint16_t value);
+
+//crc16 of a frame (polynomial 0xA001, initial 0xFFFF), appended low byte first
+uint16_t modbus_crc16(const uint8_t *data, size_t length);
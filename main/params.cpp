@@ -0,0 +1,226 @@
+extern "C"
+{
+#include <string.h>
+#include <math.h>
+#include "freertos/FreeRTOS.h"
+#include "esp_log.h"
+#include "nvs_flash.h"
+#include "nvs.h"
+}
+
+#include "params.hpp"
+
+
+//----------------------
+//----- variables ------
+//----------------------
+static const char *TAG = "params";
+
+//cached values, 32 bit each -> written and read without lock
+typedef union {
+    int32_t i;
+    float f;
+} paramValue_t;
+
+#define PARAM_VALUE_INT(value) {.i = (int32_t)(value)}
+#define PARAM_VALUE_FLOAT(value) {.f = (float)(value)}
+#define PARAM_DEFAULT(id, type, name, defaultValue, ...) PARAM_VALUE_##type(defaultValue),
+static paramValue_t values[PARAM_COUNT] = {
+    PARAM_LIST(PARAM_DEFAULT)
+};
+#undef PARAM_DEFAULT
+
+#define PARAM_INFO(id, type, name, defaultValue, min, max, unit) \
+    {PARAM_TYPE_##type, name, (float)(defaultValue), (float)(min), (float)(max), unit},
+static const paramInfo_t info[PARAM_COUNT] = {
+    PARAM_LIST(PARAM_INFO)
+};
+#undef PARAM_INFO
+
+static void (*callbacks[PARAM_COUNT])(paramId_t id) = {};
+static nvs_handle_t nvsHandle = 0;
+
+//changes not yet written to nvs, written by the persist task (param_persist)
+typedef enum { NVS_NOTHING = 0, NVS_STORE, NVS_ERASE } nvsPending_t;
+static nvsPending_t pending[PARAM_COUNT] = {};
+static portMUX_TYPE pendingMux = portMUX_INITIALIZER_UNLOCKED;
+
+
+
+//----------------------
+//----- functions ------
+//----------------------
+//value as stored in the cache, INT is rounded
+static paramValue_t toValue(paramId_t id, float value){
+    paramValue_t result;
+    if (info[id].type == PARAM_TYPE_INT) result.i = (int32_t)lroundf(value);
+    else result.f = value;
+    return result;
+}
+
+static bool inBounds(paramId_t id, float value){
+    return value >= info[id].min && value <= info[id].max;
+}
+
+
+
+//==================
+//=== param_init ===
+//==================
+void param_init(){
+    esp_err_t err = nvs_open("params", NVS_READWRITE, &nvsHandle);
+    if (err != ESP_OK) {
+        ESP_LOGE(TAG, "nvs: failed opening (%s), using defaults, changes are not stored", esp_err_to_name(err));
+        nvsHandle = 0;
+        return;
+    }
+    //--- load changed parameters ---
+    for (int i = 0; i < PARAM_COUNT; i++) {
+        paramId_t id = (paramId_t)i;
+        float value;
+        if (info[id].type == PARAM_TYPE_INT) {
+            int32_t stored;
+            if (nvs_get_i32(nvsHandle, info[id].name, &stored) != ESP_OK) continue;
+            value = stored;
+        } else {
+            size_t length = sizeof(value);
+            if (nvs_get_blob(nvsHandle, info[id].name, &value, &length) != ESP_OK || length != sizeof(value)) continue;
+        }
+        //bounds may have changed with a firmware update
+        if (!inBounds(id, value)) {
+            ESP_LOGE(TAG, "stored value %.3f of '%s' out of bounds, using default", value, info[id].name);
+            continue;
+        }
+        values[id] = toValue(id, value);
+        ESP_LOGW(TAG, "loaded %s = %.3f %s (default %.3f)", info[id].name, value, info[id].unit, info[id].defaultValue);
+    }
+}
+
+
+
+//====================
+//=== param_getInt ===
+//====================
+int32_t param_getInt(paramId_t id){
+    if (info[id].type == PARAM_TYPE_FLOAT) return (int32_t)lroundf(values[id].f);
+    return values[id].i;
+}
+
+
+
+//======================
+//=== param_getFloat ===
+//======================
+float param_getFloat(paramId_t id){
+    if (info[id].type == PARAM_TYPE_INT) return values[id].i;
+    return values[id].f;
+}
+
+
+
+//=================
+//=== param_set ===
+//=================
+bool param_set(paramId_t id, float value){
+    if (id >= PARAM_COUNT || !inBounds(id, value)) {
+        return false;
+    }
+    values[id] = toValue(id, value);
+    ESP_LOGW(TAG, "changed %s to %.3f %s", info[id].name, param_getFloat(id), info[id].unit);
+    portENTER_CRITICAL(&pendingMux);
+    pending[id] = NVS_STORE;
+    portEXIT_CRITICAL(&pendingMux);
+    if (callbacks[id] != NULL) callbacks[id](id);
+    return true;
+}
+
+
+
+//===================
+//=== param_reset ===
+//===================
+void param_reset(paramId_t id){
+    if (id >= PARAM_COUNT) return;
+    values[id] = toValue(id, info[id].defaultValue);
+    ESP_LOGW(TAG, "reset %s to default %.3f %s", info[id].name, info[id].defaultValue, info[id].unit);
+    portENTER_CRITICAL(&pendingMux);
+    pending[id] = NVS_ERASE;
+    portEXIT_CRITICAL(&pendingMux);
+    if (callbacks[id] != NULL) callbacks[id](id);
+}
+
+
+
+//=====================
+//=== param_persist ===
+//=====================
+void param_persist(){
+    if (nvsHandle == 0) return;
+    for (int i = 0; i < PARAM_COUNT; i++) {
+        paramId_t id = (paramId_t)i;
+        //take action and value together: a change while writing is stored at the next call
+        portENTER_CRITICAL(&pendingMux);
+        nvsPending_t action = pending[id];
+        pending[id] = NVS_NOTHING;
+        paramValue_t value = values[id];
+        portEXIT_CRITICAL(&pendingMux);
+        if (action == NVS_NOTHING) continue;
+        esp_err_t err;
+        if (action == NVS_ERASE) {
+            err = nvs_erase_key(nvsHandle, info[id].name);
+            if (err == ESP_ERR_NVS_NOT_FOUND) err = ESP_OK;
+        } else if (info[id].type == PARAM_TYPE_INT) {
+            err = nvs_set_i32(nvsHandle, info[id].name, value.i);
+        } else {
+            err = nvs_set_blob(nvsHandle, info[id].name, &value.f, sizeof(float));
+        }
+        if (err == ESP_OK) err = nvs_commit(nvsHandle);
+        if (err != ESP_OK) ESP_LOGE(TAG, "nvs: failed storing '%s' (%s)", info[id].name, esp_err_to_name(err));
+    }
+}
+
+
+
+//=====================
+//=== param_getInfo ===
+//=====================
+const paramInfo_t *param_getInfo(paramId_t id){
+    return &info[id];
+}
+
+
+
+//==================
+//=== param_find ===
+//==================
+paramId_t param_find(const char *name){
+    for (int i = 0; i < PARAM_COUNT; i++) {
+        if (strcmp(info[i].name, name) == 0) return (paramId_t)i;
+    }
+    return PARAM_COUNT;
+}
+
+
+
+//======================
+//=== param_onChange ===
+//======================
+void param_onChange(paramId_t id, void (*callback)(paramId_t id)){
+    callbacks[id] = callback;
+}
+
+
+
+//===================
+//=== param_print ===
+//===================
+void param_print(FILE *out, paramId_t id){
+    const paramInfo_t &p = info[id];
+    if (p.type == PARAM_TYPE_INT) {
+        fprintf(out, "%-14s = %d %s (default %d, %d..%d)\n", p.name, values[id].i, p.unit,
+                (int)p.defaultValue, (int)p.min, (int)p.max);
+    } else {
+        fprintf(out, "%-14s = %.3f %s (default %.3f, %.3f..%.3f)\n", p.name, values[id].f, p.unit,
+                p.defaultValue, p.min, p.max);
+    }
+}
@@ -0,0 +1,88 @@
+#pragma once
+#include <stdint.h>
+#include <stdio.h>
+#include "config.h"
+
+//runtime parameters: typed values with default, bounds and unit, changed ones are stored in nvs
+//(namespace "params") and loaded at startup, thus retuning does not require a rebuild.
+//Values are cached in RAM: getters are cheap and can be used in every control cycle.
+//The defaults are the macros in config.h. Change with console command "param" (console.cpp).
+
+
+//--- list of parameters ---
+//X(id, type INT/FLOAT, name (nvs key, max 15 chars), default, min, max, unit)
+#define PARAM_LIST(X) \
+    X(ENC_STEPS_PER_M,   FLOAT, "encStepsPerM",  ENCODER_STEPS_PER_METER,  500, 10000, "steps/m") \
+    X(LENGTH_OFFSET,     INT,   "lengthOffset",  TARGET_LENGTH_OFFSET,     -500, 500, "mm")      \
+    X(REACHED_TOLERANCE, INT,   "reachedTol",    TARGET_REACHED_TOLERANCE, 0, 200,    "mm")      \
+    X(AXIS_SPEED,        INT,   "axisSpeed",     STEPPER_SPEED_DEFAULT,    STEPPER_SPEED_MIN, STEPPER_SPEED_MAX, "mm/s") \
+    X(AXIS_ACCEL,        INT,   "axisAccel",     STEPPER_ACCEL,            5, 500,    "mm/s2")   \
+    X(AXIS_DECEL,        INT,   "axisDecel",     STEPPER_DECEL,            5, 500,    "mm/s2")   \
+    X(CABLE_DIAMETER,    INT,   "dCable",        D_CABLE,                  1, 40,     "mm")      \
+    X(REEL_DIAMETER,     INT,   "dReel",         D_REEL,                   20, 600,   "mm")      \
+    X(LAYER_THICKNESS,   INT,   "layerThick",    LAYER_THICKNESS_MM,       1, 40,     "mm")      \
+    X(LEVEL1_BELOW,      INT,   "lvl1Below",     40,                       0, 5000,   "mm")      \
+    X(LEVEL2_BELOW,      INT,   "lvl2Below",     300,                      0, 10000,  "mm")      \
+    X(LEVEL3_BELOW,      INT,   "lvl3Below",     700,                      0, 20000,  "mm")      \
+    X(CUT_DELAY,         INT,   "cutDelay",      2500,                     0, 10000,  "ms")      \
+    X(CUT_DELAY_MIN,     INT,   "cutDelayMin",   AUTO_CUT_DELAY_MIN_MS,    0, 10000,  "ms")      \
+    X(CABLE_PROFILE,     INT,   "cableProfile",  0,                        0, SLIP_PROFILE_COUNT - 1, "") \
+    X(PROFILE_DECEL,     INT,   "profDecel",     VFD_PROFILE_DECEL,        100, 10000, "mm/s2")   \
+    X(PROFILE_STOP_SPEED, INT,  "profStopSpeed", VFD_PROFILE_STOP_SPEED,   20, 1500,   "mm/s")  \
+    X(STALL_CURRENT,     FLOAT, "stallCurrent",  VFD_STALL_CURRENT,        0.1, 20,   "A")       \
+    X(IDLE_CURRENT,      FLOAT, "idleCurrent",   VFD_IDLE_CURRENT,         0, 20,     "A")
+
+//LEVELn_BELOW: speed level n-1 is used while the remaining length is below this
+//(setDynSpeedLvl, with coast model only until the coast distance of the level is learned)
+//CUT_DELAY: countdown to auto-cut, CUT_DELAY_MIN: shortened countdown (AUTO_CUT_PIPELINED)
+//CABLE_PROFILE: slip correction table used (slip.hpp)
+//PROFILE_*: continuous deceleration profile with analog or modbus speed reference (VFD_CONTINUOUS_SPEED, coast.hpp)
+//STALL_CURRENT, IDLE_CURRENT: stall / empty spool detection from the vfd current (VFD_MODBUS, control.cpp)
+
+typedef enum {
+#define PARAM_ENUM(id, ...) PARAM_##id,
+    PARAM_LIST(PARAM_ENUM)
+#undef PARAM_ENUM
+    PARAM_COUNT
+} paramId_t;
+
+typedef enum {PARAM_TYPE_INT, PARAM_TYPE_FLOAT} paramType_t;
+
+typedef struct {
+    paramType_t type;
+    const char *name;
+    float defaultValue;
+    float min;
+    float max;
+    const char *unit;
+} paramInfo_t;
+
+
+//load values stored in nvs (nvs has to be initialized already), until then the defaults are used
+void param_init();
+
+//current value (cached)
+int32_t param_getInt(paramId_t id);
+float param_getFloat(paramId_t id);
+
+//set value and store it in nvs (param_persist), runs the change callback
+//INT parameters are rounded, returns false when the value is out of bounds
+bool param_set(paramId_t id, float value);
+
+//set default value and remove it from nvs (param_persist)
+void param_reset(paramId_t id);
+
+//write changes of param_set / param_reset to nvs (persist task, blocks during nvs commit)
+void param_persist();
+
+//description of a parameter
+const paramInfo_t *param_getInfo(paramId_t id);
+
+//find parameter by name, returns PARAM_COUNT when not found
+paramId_t param_find(const char *name);
+
+//function called after the value changed (one per parameter, task context of the caller of param_set)
+void param_onChange(paramId_t id, void (*callback)(paramId_t id));
+
+//print "name = value unit (default, min..max)"
+void param_print(FILE *out, paramId_t id);
@@ -0,0 +1,312 @@
+extern "C"
+{
+#include <string.h>
+#include <freertos/FreeRTOS.h>
+#include <freertos/task.h>
+#include "freertos/semphr.h"
+#include "esp_log.h"
+#include "esp_timer.h"
+#include "esp_partition.h"
+}
+
+#include "config.h"
+#include "persist.hpp"
+#include "journal.hpp"
+#include "control.hpp"
+#include "guide-stepper.hpp"
+#include "vfd.hpp"
+#include "coast.hpp"
+#include "params.hpp"
+#include "slip.hpp"
+
+
+//---------------------
+//--- configuration ---
+//---------------------
+#define PERSIST_PARTITION_LABEL "journal"
+//write changed state at most this often (power-fail record is written immediately)
+//with 16 sectors of 41 records (one slot reserved for the power-fail record) and 100k erase cycles:
+//~21 years of continuous running
+#define PERSIST_INTERVAL_MS 10000
+//task checks for changes this often
+#define PERSIST_POLL_MS 1000
+//increase when the layout of persistRecord_t changes, records with other version are ignored
+#define PERSIST_LAYOUT_VERSION 1
+
+//flags of persistRecord_t
+#define PERSIST_FLAG_RESUME 0x01    //record was written at power loss, resume state is valid
+
+
+
+//----------------------
+//----- variables ------
+//----------------------
+static const char *TAG = "persist";
+
+//complete state, one record in the journal
+typedef struct {
+    uint32_t version;
+    uint32_t flags;
+    persistCounters_t counters;
+    persistSettings_t settings;
+    powerFailState_t resume;
+} persistRecord_t;
+
+//current state, written by several tasks -> short critical sections only
+static persistRecord_t state = {};
+static portMUX_TYPE stateMux = portMUX_INITIALIZER_UNLOCKED;
+static bool dirty = false;
+
+//journal state and programming -> mutex, erasing is done without it (journal_maintainErase)
+static journal_t journal;
+static bool journalOpen = false;
+static SemaphoreHandle_t journalMutex = NULL;
+
+static powerFailState_t resumeState;
+static bool resumeStateValid = false;
+static persistSettings_t settingsLoaded = {};
+
+
+
+//--------------------------
+//--- flash via partition ---
+//--------------------------
+static int partitionRead(void *ctx, uint32_t offset, void *dst, uint32_t size){
+    return esp_partition_read((const esp_partition_t *)ctx, offset, dst, size) == ESP_OK ? 0 : -1;
+}
+static int partitionWrite(void *ctx, uint32_t offset, const void *src, uint32_t size){
+    return esp_partition_write((const esp_partition_t *)ctx, offset, src, size) == ESP_OK ? 0 : -1;
+}
+static int partitionErase(void *ctx, uint32_t offset, uint32_t size){
+    return esp_partition_erase_range((const esp_partition_t *)ctx, offset, size) == ESP_OK ? 0 : -1;
+}
+
+
+//-------------------
+//--- writeRecord ---
+//-------------------
+//append copy of current state to journal
+static int writeRecord(){
+    persistRecord_t record;
+    portENTER_CRITICAL(&stateMux);
+    record = state;
+    dirty = false;
+    portEXIT_CRITICAL(&stateMux);
+    if (!journalOpen) return -1;
+    xSemaphoreTake(journalMutex, portMAX_DELAY);
+    int err = journal_append(&journal, &record);
+    xSemaphoreGive(journalMutex);
+    if (err == JOURNAL_BUSY) {
+        //sector ahead is being erased, write again later
+        portENTER_CRITICAL(&stateMux);
+        dirty = true;
+        portEXIT_CRITICAL(&stateMux);
+        ESP_LOGD(TAG, "journal busy erasing, record deferred");
+    } else if (err != 0) {
+        ESP_LOGE(TAG, "writing record failed");
+    }
+    return err;
+}
+
+
+
+//====================
+//=== persist_init ===
+//====================
+void persist_init(){
+    journalMutex = xSemaphoreCreateMutex();
+    state.version = PERSIST_LAYOUT_VERSION;
+
+    //--- open journal ---
+    const esp_partition_t *partition = esp_partition_find_first(ESP_PARTITION_TYPE_DATA, ESP_PARTITION_SUBTYPE_ANY, PERSIST_PARTITION_LABEL);
+    if (partition == NULL) {
+        ESP_LOGE(TAG, "partition '%s' not found - state is not stored", PERSIST_PARTITION_LABEL);
+        return;
+    }
+    journalFlash_t flash = {partitionRead, partitionWrite, partitionErase, (void *)partition,
+        SPI_FLASH_SEC_SIZE, partition->size / SPI_FLASH_SEC_SIZE};
+    if (journal_open(&journal, &flash, sizeof(persistRecord_t)) != 0) {
+        ESP_LOGE(TAG, "opening journal failed");
+        return;
+    }
+    journalOpen = true;
+
+    //--- load latest record ---
+    persistRecord_t record;
+    uint32_t writeTimeUs;
+    if (journal_readLatest(&journal, &record, &writeTimeUs) && record.version == PERSIST_LAYOUT_VERSION) {
+        state = record;
+        settingsLoaded = record.settings;
+        ESP_LOGW(TAG, "loaded record %d (%d reads): %d cuts, %.1fm total, runtime %dh%02dm",
+                journal.sequence - 1, journal.openReads, state.counters.cuts, state.counters.cutLengthMm / 1000.0,
+                state.counters.runtimeS / 3600, state.counters.runtimeS / 60 % 60);
+        //write time of power-fail record is programmed after the record itself
+        if (writeTimeUs != 0xFFFFFFFF) {
+            if (writeTimeUs > state.counters.powerFailWriteUsMax) state.counters.powerFailWriteUsMax = writeTimeUs;
+            ESP_LOGW(TAG, "power-fail record was written in %dus, worst so far %dus", writeTimeUs, state.counters.powerFailWriteUsMax);
+        }
+        if (state.flags & PERSIST_FLAG_RESUME) {
+            resumeState = state.resume;
+            resumeStateValid = true;
+            ESP_LOGW(TAG, "resuming state at power loss: encoderSteps=%d target=%dmm layer=%d guidePos=%d axisPos=%d width=%d",
+                     resumeState.encoderSteps, resumeState.lengthTargetMm, resumeState.layerCount,
+                     resumeState.guidePosSteps, resumeState.axisPosSteps, resumeState.windingWidthSteps);
+            //consume: not used again at next startup
+            state.flags &= ~PERSIST_FLAG_RESUME;
+            writeRecord();
+        }
+    } else {
+        ESP_LOGW(TAG, "journal is empty, starting with default state");
+    }
+
+    //--- prepare flash for next records (startup: erasing does not disturb anything) ---
+    journal_maintain(&journal);
+}
+
+
+
+//==============================
+//=== persist_getResumeState ===
+//==============================
+bool persist_getResumeState(powerFailState_t *resume){
+    if (resumeStateValid) *resume = resumeState;
+    return resumeStateValid;
+}
+
+
+
+//===========================
+//=== persist_getCounters ===
+//===========================
+persistCounters_t persist_getCounters(){
+    portENTER_CRITICAL(&stateMux);
+    persistCounters_t counters = state.counters;
+    portEXIT_CRITICAL(&stateMux);
+    return counters;
+}
+
+
+
+//===========================
+//=== persist_getSettings ===
+//===========================
+persistSettings_t persist_getSettings(){
+    return settingsLoaded;
+}
+
+
+
+//======================
+//=== persist_addCut ===
+//======================
+void persist_addCut(int lengthMm){
+    portENTER_CRITICAL(&stateMux);
+    state.counters.cuts++;
+    if (lengthMm > 0) state.counters.cutLengthMm += lengthMm;
+    dirty = true;
+    portEXIT_CRITICAL(&stateMux);
+}
+
+
+
+//==============================
+//=== persist_storePowerFail ===
+//==============================
+uint32_t persist_storePowerFail(const powerFailState_t *resume){
+    int64_t timeStart = esp_timer_get_time();
+    if (!journalOpen) return 0;
+    persistRecord_t record;
+    portENTER_CRITICAL(&stateMux);
+    state.resume = *resume;
+    state.flags |= PERSIST_FLAG_RESUME;
+    record = state;
+    portEXIT_CRITICAL(&stateMux);
+
+    //mutex is never held during an erase, reserved slot: does not wait for the erase (persist task)
+    xSemaphoreTake(journalMutex, portMAX_DELAY);
+    int err = journal_append(&journal, &record, true);
+    uint32_t writeTimeUs = esp_timer_get_time() - timeStart;
+    if (err == 0) journal_markLatest(&journal, writeTimeUs);
+    xSemaphoreGive(journalMutex);
+    if (err != 0) ESP_LOGE(TAG, "writing power-fail record failed");
+    return writeTimeUs;
+}
+
+
+
+//==============================
+//=== persist_clearPowerFail ===
+//==============================
+void persist_clearPowerFail(){
+    portENTER_CRITICAL(&stateMux);
+    state.flags &= ~PERSIST_FLAG_RESUME;
+    portEXIT_CRITICAL(&stateMux);
+    writeRecord();
+}
+
+
+
+//====================
+//=== task_persist ===
+//====================
+void task_persist(void *pvParameter){
+    uint32_t timestamp_lastWrite = esp_log_timestamp();
+    uint32_t timestamp_lastPoll = esp_log_timestamp();
+    uint32_t runtimeMs = 0; //not yet counted part of a second
+    while (1) {
+        vTaskDelay(PERSIST_POLL_MS / portTICK_PERIOD_MS);
+        uint32_t now = esp_log_timestamp();
+
+        //--- track runtime and settings ---
+        int lengthTarget = control_getLengthTarget();
+        uint8_t windingWidth = guide_getWindingWidth();
+        if (vfd_getState()) runtimeMs += now - timestamp_lastPoll;
+        timestamp_lastPoll = now;
+        portENTER_CRITICAL(&stateMux);
+        if (runtimeMs >= 1000) {
+            state.counters.runtimeS += runtimeMs / 1000;
+            runtimeMs %= 1000;
+            dirty = true;
+        }
+        if (state.settings.lengthTargetMm != lengthTarget || state.settings.windingWidthMm != windingWidth) {
+            state.settings.lengthTargetMm = lengthTarget;
+            state.settings.windingWidthMm = windingWidth;
+            dirty = true;
+        }
+        bool writeNow = dirty && now - timestamp_lastWrite >= PERSIST_INTERVAL_MS;
+        portEXIT_CRITICAL(&stateMux);
+
+        //no flash access while the vfd runs: would hold off the stop trip isr (see TARGET_TRIP_IN_ISR in config.h)
+        if (vfd_getState()) continue;
+
+        //--- write changes ---
+        if (writeNow) {
+            writeRecord();
+            timestamp_lastWrite = now;
+            ESP_LOGD(TAG, "wrote record %d", journal.sequence - 1);
+        }
+
+        //--- nvs: learned coast model, changed parameters and slip tables ---
+        //nvs commit takes several ms, not done in the control or console task
+        coast_persist();
+        param_persist();
+        slip_persist();
+
+        //--- erase sector ahead ---
+        //erase without holding the mutex: power-fail record can be written to the reserved slot meanwhile
+        uint32_t sector;
+        if (journalOpen) {
+            xSemaphoreTake(journalMutex, portMAX_DELAY);
+            bool erase = journal_maintainBegin(&journal, &sector);
+            xSemaphoreGive(journalMutex);
+            if (erase) {
+                int err = journal_maintainErase(&journal, sector);
+                xSemaphoreTake(journalMutex, portMAX_DELAY);
+                journal_maintainEnd(&journal, sector, err);
+                xSemaphoreGive(journalMutex);
+                if (err == 0) ESP_LOGI(TAG, "erased sector %d ahead of journal head", sector);
+                else ESP_LOGE(TAG, "erasing sector %d failed", sector);
+            }
+        }
+    }
+}
@@ -0,0 +1,63 @@
+#pragma once
+#include <stdint.h>
+
+//persistent machine state: counters, settings and resume state
+//stored as complete record in a wear-leveled journal (journal.cpp) in the raw partition "journal"
+//the persist task writes changes at most every PERSIST_INTERVAL_MS and erases flash ahead while the vfd is off,
+//it also commits the nvs changes of coast model, parameters and slip tables (coast_persist, param_persist, slip_persist),
+//the power-fail path appends immediately (flash is only programmed, no erase, no nvs commit)
+
+
+//state at power loss, used to resume a partially wound reel
+typedef struct {
+    int32_t encoderSteps;       //cable length in encoder steps since last reset
+    int32_t lengthTargetMm;
+    int32_t layerCount;
+    uint32_t guidePosSteps;     //axis position calculated by guide task
+    uint32_t axisPosSteps;      //actual stepper position
+    uint32_t windingWidthSteps;
+    uint8_t guideMovingRight;
+    uint8_t controlState;       //systemState_t at power loss
+    uint16_t reserved;
+} powerFailState_t;
+
+//totals over machine lifetime
+typedef struct {
+    uint64_t cutLengthMm;       //sum of the length of all cut pieces
+    uint32_t cuts;
+    uint32_t runtimeS;          //time the motor was running
+    uint32_t powerFailWriteUsMax; //worst time it took to store the state at power loss
+} persistCounters_t;
+
+//settings selected by the operator, restored at startup
+typedef struct {
+    int32_t lengthTargetMm;     //0 = not stored yet
+    uint8_t windingWidthMm;
+} persistSettings_t;
+
+
+//open journal and load latest state (call once at startup before other tasks are created)
+void persist_init();
+
+//get state stored at last power loss
+//returns false when there is none (or the voltage recovered after it was stored)
+bool persist_getResumeState(powerFailState_t *state);
+
+//get counters (loaded at startup and updated since)
+persistCounters_t persist_getCounters();
+
+//get settings stored at last run (loaded at startup, lengthTargetMm is 0 when nothing was stored)
+persistSettings_t persist_getSettings();
+
+//count a cut piece (control task)
+void persist_addCut(int lengthMm);
+
+//store state at power loss immediately, bounded time
+//returns time it took to collect and write the record in us
+uint32_t persist_storePowerFail(const powerFailState_t *state);
+
+//supply voltage recovered: state stored at power loss is outdated, do not resume from it
+void persist_clearPowerFail();
+
+//task that tracks runtime and settings, writes changes and prepares flash for the next records
+void task_persist(void *pvParameter);
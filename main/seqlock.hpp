@@ -0,0 +1,55 @@
+#pragma once
+#include <atomic>
+#include <cstdint>
+
+extern "C" {
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+}
+
+
+//=====================
+//====== seqlock ======
+//=====================
+//publish a small struct from ONE writer (isr or task) to any number of reading tasks without locking:
+//- writer increments the sequence before (odd = write in progress) and after writing the data
+//- reader copies the data and retries when the sequence was odd or changed meanwhile
+//Note: a writing task suspends the scheduler of its core while copying, otherwise a higher
+//      priority reader on the same core could preempt it and spin forever
+template <typename T>
+class seqlock_t {
+public:
+    //write new value from task context
+    void write(const T &value){
+        vTaskSuspendAll();
+        writeFromIsr(value);
+        xTaskResumeAll();
+    }
+
+    //write new value from isr context (or while the writing task can not be preempted)
+    void writeFromIsr(const T &value){
+        uint32_t seq = sequence.load(std::memory_order_relaxed);
+        sequence.store(seq + 1, std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_release);
+        data = value;
+        std::atomic_thread_fence(std::memory_order_release);
+        sequence.store(seq + 2, std::memory_order_relaxed);
+    }
+
+    //get consistent copy of the last written value (task context only)
+    T read() const {
+        T copy;
+        uint32_t seqStart, seqEnd;
+        do {
+            seqStart = sequence.load(std::memory_order_acquire);
+            copy = data;
+            std::atomic_thread_fence(std::memory_order_acquire);
+            seqEnd = sequence.load(std::memory_order_relaxed);
+        } while ((seqStart & 1) || seqStart != seqEnd);
+        return copy;
+    }
+
+private:
+    std::atomic<uint32_t> sequence{0};
+    T data{};
+};
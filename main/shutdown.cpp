@@ -12,59 +12,51 @@ extern "C"
 
 #include "config.h"
 #include "shutdown.hpp"
+#include "adc-service.hpp"
 
+#include "snapshot.hpp"
 #include "guide-stepper.hpp"
+#include "control.hpp"
+#include "persist.hpp"
 
 #define ADC_LOW_VOLTAGE_THRESHOLD 3200 // adc value where shut down is detected (store certain values before complete power loss)
 
 static const char *TAG = "lowVoltage"; // tag for logging
-nvs_handle_t nvsHandle; // access nvs that was opened once, in any function
 
 
 
-// store a u32 value in nvs as "lastPosSteps"
-void nvsWriteLastAxisPos(uint32_t value)
+//-------------------------
+//---- storeState ---------
+//-------------------------
+// collect current machine state and store it in the journal
+// time is bounded: state is read without locks, flash is only programmed (no erase, no nvs)
+static void storeState()
 {
-    // update nvs value
-    esp_err_t err = nvs_set_u32(nvsHandle, "lastPosSteps", value);
-    if (err != ESP_OK)
-        ESP_LOGE(TAG, "nvs: failed writing");
-    err = nvs_commit(nvsHandle);
-    if (err != ESP_OK)
-        ESP_LOGE(TAG, "nvs: failed committing updates");
-    else
-        ESP_LOGI(TAG, "nvs: successfully committed updates");
-    ESP_LOGW(TAG, "updated value in nvs to %d", value);
+    machineSnapshot_t snapshot = snapshot_get();
+    guideState_t guide = guide_getState();
+    powerFailState_t state = {};
+    state.encoderSteps = snapshot.encoderSteps;
+    state.lengthTargetMm = control_getLengthTarget();
+    state.layerCount = guide.layerCount;
+    state.guidePosSteps = guide.posSteps;
+    state.axisPosSteps = snapshot.axisPosSteps;
+    state.windingWidthSteps = guide.maxPosSteps;
+    state.guideMovingRight = guide.movingRight;
+    state.controlState = (uint8_t)snapshot.controlState;
+    uint32_t writeTimeUs = persist_storePowerFail(&state);
+
+    // log after writing, there is no time to lose before
+    ESP_LOGW(TAG, "stored state in %dus (encoderSteps=%d layer=%d guidePos=%d)",
+             writeTimeUs, state.encoderSteps, state.layerCount, state.guidePosSteps);
 }
 
 
 
-// read "lastPosSteps" from nvs, returns -1 if failed
-int nvsReadLastAxisPosSteps()
-{
-    uint32_t valueRead;
-    esp_err_t err = nvs_get_u32(nvsHandle, "lastPosSteps", &valueRead);
-    switch (err)
-    {
-    case ESP_OK:
-        ESP_LOGW(TAG, "Successfully read value %d from nvs", valueRead);
-        return valueRead;
-        break;
-    case ESP_ERR_NVS_NOT_FOUND:
-        ESP_LOGE(TAG, "nvs: the value '%s' is not initialized yet", "lastPosSteps");
-        return -1;
-        break;
-    default:
-        ESP_LOGE(TAG, "Error (%s) reading nvs!", esp_err_to_name(err));
-        return -1;
-    }
-}
-
-
-
-// task that repeatedly checks supply voltage (12V) and saves certain values to nvs in case of power off detected
-// note: with the 2200uF capacitor in the 12V supply and measuring if 12V start do drop here, there is more than enough time to take action until the 3v3 regulator turns off
-void task_shutDownDetection(void *pvParameter)
+//=====================
+//=== shutdown_init ===
+//=====================
+// initialize nvs and load persistent state (counters, settings, state stored at last power loss)
+void shutdown_init()
 {
     //--- Initialize NVS ---
     ESP_LOGW(TAG, "initializing nvs...");
@@ -77,31 +69,36 @@ void task_shutDownDetection(void *pvParameter)
         err = nvs_flash_init();
     }
 
-    //--- open nvs-flash ---
-    ESP_LOGW(TAG, "opening NVS-handle...");
-    // create handle available for all functions in this file
-    err = nvs_open("storage", NVS_READWRITE, &nvsHandle);
-    if (err != ESP_OK)
-        ESP_LOGE(TAG, "Error (%s) opening NVS handle!\n", esp_err_to_name(err));
+    //--- persistent state ---
+    persist_init();
+}
+
 
-    // read stored value (returns 0 if unitialized/failed)
-    //int lastPosSteps = nvsReadLastAxisPosSteps();
-    //ESP_LOGW(TAG, "=> read value %d from nvs (stored at last shutdown)", lastPosSteps);
 
-    // repeatedly read ADC and check if below low voltage threshold
+// task that waits for supply voltage (12V) to drop and then stores the machine state to flash
+// note: with the 2200uF capacitor in the 12V supply and measuring if 12V start do drop here, there is more than enough time to take action until the 3v3 regulator turns off
+void task_shutDownDetection(void *pvParameter)
+{
+    // get notified by adc service as soon as supply voltage drops below threshold
+    // (without continuous adc the timeout below results in polling every 30ms)
+    adcService_notifyBelow(ADC_CHANNEL_SUPPLY_VOLTAGE, ADC_LOW_VOLTAGE_THRESHOLD, xTaskGetCurrentTaskHandle());
+
+    // repeatedly check if supply voltage is below low voltage threshold
     bool voltageBelowThreshold = false;
     while (1) //TODO limit save frequency in case voltage repeadedly varys between threshold for some reason (e.g. offset drift)
     {
-        // read adc
-        int adc_reading = adc1_get_raw(ADC_CHANNEL_SUPPLY_VOLTAGE);
+        // wait for notification or timeout, then get latest value
+        ulTaskNotifyTake(pdTRUE, 30 / portTICK_PERIOD_MS);
+        int adc_reading = adcService_get(ADC_CHANNEL_SUPPLY_VOLTAGE);
 
         // evaulate threshold
         if (adc_reading < ADC_LOW_VOLTAGE_THRESHOLD) // below threshold => POWER SHUTDOWN DETECTED
         {
-            // write to nvs and log once at change to below
+            // write record once at change to below
             if (!voltageBelowThreshold){
-                nvsWriteLastAxisPos(guide_getAxisPosSteps());
-                ESP_LOGE(TAG, "voltage now below threshold!  now=%d threshold=%d -> wrote last axis-pos to nvs", adc_reading, ADC_LOW_VOLTAGE_THRESHOLD);
+                storeState();
+                control_postEvent(CONTROL_EVENT_POWER_FAIL, adc_reading);
+                ESP_LOGE(TAG, "voltage now below threshold!  now=%d threshold=%d -> stored state for resuming", adc_reading, ADC_LOW_VOLTAGE_THRESHOLD);
                 voltageBelowThreshold = true;
             }
         }
@@ -110,11 +107,11 @@ void task_shutDownDetection(void *pvParameter)
             // log at change to above
             ESP_LOGE(TAG, "voltage above threshold again: %d > %d - issue with power supply, or too threshold too high?", adc_reading, ADC_LOW_VOLTAGE_THRESHOLD);
             voltageBelowThreshold = false;
+            // machine continues -> stored state is outdated, must not be used at next startup
+            persist_clearPowerFail();
         }
 
         // always log for debugging/calibrating
         ESP_LOGD(TAG, "read adc battery voltage: %d", adc_reading);
-
-        vTaskDelay(30 / portTICK_PERIOD_MS);
     }
-}
\ No newline at end of file
+}
@@ -1,7 +1,9 @@
+#pragma once
 
-// task that repeatedly checks supply voltage (12V) and saves certain values to nvs in case of it drops below a certain threshold (power off detected)
-void task_shutDownDetection(void *pvParameter);
+// initialize nvs and load persistent state (counters, settings, state stored at last power loss)
+// has to be called once at startup before other tasks are created
+void shutdown_init();
 
-// read last axis position in steps from nvs
-// returns -1 when reading from nvs failed
-int nvsReadLastAxisPosSteps();
\ No newline at end of file
+// task that waits for the supply voltage (12V) to drop below a certain threshold (power off detected)
+// and then stores the current machine state for resuming (see persist.hpp) within bounded time
+void task_shutDownDetection(void *pvParameter);
@@ -0,0 +1,139 @@
+extern "C" {
+#include "freertos/FreeRTOS.h"
+#include "esp_log.h"
+#include "nvs_flash.h"
+#include "nvs.h"
+}
+#include <cmath>
+#include <string.h>
+#include "config.h"
+#include "slip.hpp"
+#include "params.hpp"
+
+
+//---------------------
+//--- configuration ---
+//---------------------
+//used macros from config.h:
+//SLIP_SPEED_POINTS, SLIP_PROFILE_COUNT, SLIP_PERCENT_MAX
+
+#define NVS_KEY "slipTables"
+
+static const float speedPoints[SLIP_POINT_COUNT] = SLIP_SPEED_POINTS;
+
+
+
+//----------------------
+//----- variables ------
+//----------------------
+static const char *TAG = "slip";
+
+//tables of all profiles stored in nvs, correction in percent
+static float tables[SLIP_PROFILE_COUNT][SLIP_POINT_COUNT] = {};
+static nvs_handle_t nvsHandle = 0;
+//tables changed, written to nvs by the persist task (slip_persist)
+static volatile bool tablesChanged = false;
+
+//table of active profile, read by every encoder_getLenMm() call
+//(pointer is 32 bit -> switching profile needs no lock)
+static const float *active = tables[0];
+
+
+
+//---------------------------
+//----- local functions -----
+//---------------------------
+static void selectProfile(paramId_t id){
+    int profile = param_getInt(PARAM_CABLE_PROFILE);
+    active = tables[profile];
+    ESP_LOGW(TAG, "cable profile %d: %+.2f%% at %.0fmm/s ... %+.2f%% at %.0fmm/s", profile,
+            active[0], speedPoints[0], active[SLIP_POINT_COUNT - 1], speedPoints[SLIP_POINT_COUNT - 1]);
+}
+
+
+
+//==========================
+//======= slip_init ========
+//==========================
+void slip_init(){
+    static_assert(sizeof(speedPoints) / sizeof(speedPoints[0]) == SLIP_POINT_COUNT,
+            "SLIP_SPEED_POINTS needs SLIP_POINT_COUNT values");
+    esp_err_t err = nvs_open("storage", NVS_READWRITE, &nvsHandle);
+    if (err != ESP_OK) {
+        ESP_LOGE(TAG, "nvs: failed opening (%s), tables will not be stored", esp_err_to_name(err));
+        nvsHandle = 0;
+    } else {
+        size_t length = sizeof(tables);
+        err = nvs_get_blob(nvsHandle, NVS_KEY, tables, &length);
+        if (err != ESP_OK || length != sizeof(tables)) {
+            ESP_LOGW(TAG, "no tables in nvs (%s) -> no correction", esp_err_to_name(err));
+            memset(tables, 0, sizeof(tables));
+        }
+    }
+    selectProfile(PARAM_CABLE_PROFILE);
+    param_onChange(PARAM_CABLE_PROFILE, selectProfile);
+}
+
+
+
+//==========================
+//===== slip_getFactor =====
+//==========================
+float slip_getFactor(float speedMmPerS){
+    float speed = fabsf(speedMmPerS);
+    const float *table = active;
+    float percent;
+    if (speed <= speedPoints[0]) {
+        percent = table[0];
+    } else if (speed >= speedPoints[SLIP_POINT_COUNT - 1]) {
+        percent = table[SLIP_POINT_COUNT - 1];
+    } else {
+        int i = 1;
+        while (speed > speedPoints[i]) i++;
+        float fraction = (speed - speedPoints[i - 1]) / (speedPoints[i] - speedPoints[i - 1]);
+        percent = table[i - 1] + (table[i] - table[i - 1]) * fraction;
+    }
+    return 1 + percent / 100;
+}
+
+
+
+//==========================
+//===== slip_setPoint ======
+//==========================
+bool slip_setPoint(int point, float percent){
+    if (point < 0 || point >= SLIP_POINT_COUNT || fabsf(percent) > SLIP_PERCENT_MAX) {
+        return false;
+    }
+    int profile = param_getInt(PARAM_CABLE_PROFILE);
+    tables[profile][point] = percent;
+    ESP_LOGW(TAG, "cable profile %d: correction at %.0fmm/s set to %+.2f%%", profile, speedPoints[point], percent);
+    tablesChanged = true;
+    return true;
+}
+
+
+
+//==========================
+//====== slip_persist ======
+//==========================
+void slip_persist(){
+    if (!tablesChanged || nvsHandle == 0) return;
+    //clear first: a change while writing is stored at the next call
+    tablesChanged = false;
+    esp_err_t err = nvs_set_blob(nvsHandle, NVS_KEY, tables, sizeof(tables));
+    if (err == ESP_OK) err = nvs_commit(nvsHandle);
+    if (err != ESP_OK) ESP_LOGE(TAG, "nvs: failed storing tables (%s)", esp_err_to_name(err));
+}
+
+
+
+//==========================
+//======= slip_print =======
+//==========================
+void slip_print(FILE *out){
+    fprintf(out, "cable profile %d\n", (int)param_getInt(PARAM_CABLE_PROFILE));
+    for (int i = 0; i < SLIP_POINT_COUNT; i++) {
+        fprintf(out, "%d: %5.0f mm/s %+.2f %%\n", i, speedPoints[i], active[i]);
+    }
+}
@@ -0,0 +1,29 @@
+#pragma once
+#include <stdio.h>
+
+//correction of the encoder length for slip of the measuring roller
+//The roller slips more the faster the cable runs and depends on the cable (surface, stiffness).
+//For each cable profile a table holds the length correction in percent at the speeds
+//SLIP_SPEED_POINTS (config.h), linearly interpolated in between and constant beyond the ends.
+//Entries are relative to ENCODER_STEPS_PER_METER / parameter encStepsPerM (calibrated at
+//speed level 1), thus all 0 = no correction. The active profile is parameter cableProfile.
+//encoder_getLenMm() applies the factor of the current speed to each length increment.
+
+//number of points of each table
+#define SLIP_POINT_COUNT 4
+
+//load tables from nvs and select profile of parameter cableProfile (nvs has to be initialized already)
+void slip_init();
+
+//length correction factor at cable speed (sign ignored), 1 = no correction
+float slip_getFactor(float speedMmPerS);
+
+//change correction in percent at point of the active profile and store the tables in nvs (slip_persist)
+//returns false when point or value is invalid
+bool slip_setPoint(int point, float percent);
+
+//write the tables to nvs when changed since the last call (persist task, blocks during nvs commit)
+void slip_persist();
+
+//print table of active profile "speed: percent"
+void slip_print(FILE *out);
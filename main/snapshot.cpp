@@ -0,0 +1,23 @@
+#include "snapshot.hpp"
+#include "encoder.hpp"
+#include "stepper.hpp"
+#include "guide-stepper.hpp"
+
+
+//====================
+//=== snapshot_get ===
+//====================
+machineSnapshot_t snapshot_get(){
+    stepperState_t stepper = stepper_getState();
+    guideState_t guide = guide_getState();
+    machineSnapshot_t snapshot;
+    snapshot.encoderSteps = encoder_getSteps(); //single 32 bit value written by isr
+    snapshot.axisPosSteps = stepper.posSteps;
+    snapshot.axisSpeed = stepper.speed;
+    snapshot.axisMoving = stepper.running;
+    snapshot.guideTargetSteps = guide.posSteps;
+    snapshot.guideMaxPosSteps = guide.maxPosSteps;
+    snapshot.layerCount = guide.layerCount;
+    snapshot.controlState = control_getState();
+    return snapshot;
+}
@@ -0,0 +1,20 @@
+#pragma once
+#include <stdint.h>
+#include "control.hpp"
+
+//consistent view of cable length, axis and control state for any task
+//each part is published by its single writer (encoder isr, stepper isr, guide task, control task)
+//and read without mutex, thus reading never blocks the writers
+typedef struct {
+    int encoderSteps;           //cable length in encoder steps since last reset
+    uint64_t axisPosSteps;      //actual stepper position
+    uint32_t axisSpeed;         //current stepper speed in steps/s
+    bool axisMoving;
+    uint32_t guideTargetSteps;  //axis position calculated by guide task
+    uint32_t guideMaxPosSteps;  //winding width the guide currently uses
+    int layerCount;
+    systemState_t controlState;
+} machineSnapshot_t;
+
+//collect current snapshot (task context)
+machineSnapshot_t snapshot_get();
@@ -0,0 +1,80 @@
+#include <math.h>
+#include "stepper-ramp.hpp"
+
+//entries of interval table, more entries reduce interpolation error at low speed
+#define RAMP_TABLE_SIZE 1024
+//fixed point fraction bits of ramp index
+#define RAMP_FRAC_BITS 16
+
+
+//=====================
+//===== variables =====
+//=====================
+static uint32_t intervalTable[RAMP_TABLE_SIZE + 1];
+static float speedMinSquared = 0;
+static float speedSquaredPerEntry = 1; //increase of v^2 from one table entry to the next
+static uint32_t indexMax = 0;
+static uint32_t timerF = 1000000;
+
+
+
+//=====================
+//===== ramp_init =====
+//=====================
+void ramp_init(uint32_t speedMin, uint32_t speedMax, uint32_t timerFrequency){
+	if (speedMax <= speedMin) speedMax = speedMin + 1;
+	timerF = timerFrequency;
+	speedMinSquared = (float)speedMin * speedMin;
+	speedSquaredPerEntry = ((float)speedMax * speedMax - speedMinSquared) / RAMP_TABLE_SIZE;
+	for (int i = 0; i <= RAMP_TABLE_SIZE; i++) {
+		intervalTable[i] = lroundf(timerF / sqrtf(speedMinSquared + i * speedSquaredPerEntry));
+	}
+	indexMax = (uint32_t)RAMP_TABLE_SIZE << RAMP_FRAC_BITS;
+}
+
+
+
+//=================================
+//===== ramp_accelToIncrement =====
+//=================================
+uint32_t ramp_accelToIncrement(uint32_t accel){
+	//v^2 increases by 2*a with every step
+	uint32_t increment = lroundf(2.0f * accel / speedSquaredPerEntry * (1 << RAMP_FRAC_BITS));
+	return increment > 0 ? increment : 1;
+}
+
+
+
+//=============================
+//===== ramp_speedToIndex =====
+//=============================
+uint32_t ramp_speedToIndex(uint32_t speed){
+	float speedSquared = (float)speed * speed;
+	if (speedSquared <= speedMinSquared) return 0;
+	float index = (speedSquared - speedMinSquared) / speedSquaredPerEntry * (1 << RAMP_FRAC_BITS);
+	if (index >= indexMax) return indexMax;
+	return index;
+}
+
+
+
+//=============================
+//===== ramp_indexToSpeed =====
+//=============================
+uint32_t ramp_indexToSpeed(uint32_t index){
+	return timerF / ramp_interval(index);
+}
+
+
+
+//=========================
+//===== ramp_interval =====
+//=========================
+uint32_t ramp_interval(uint32_t index){
+	if (index >= indexMax) return intervalTable[RAMP_TABLE_SIZE];
+	uint32_t i = index >> RAMP_FRAC_BITS;
+	uint32_t frac = index & ((1 << RAMP_FRAC_BITS) - 1);
+	//intervals decrease with increasing index
+	uint32_t diff = intervalTable[i] - intervalTable[i + 1];
+	return intervalTable[i] - (uint32_t)(((uint64_t)diff * frac) >> RAMP_FRAC_BITS);
+}
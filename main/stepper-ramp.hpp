@@ -0,0 +1,23 @@
+#pragma once
+#include <stdint.h>
+
+//precomputed step intervals for linear acceleration of the stepper (used by stepper isr)
+//the ramp position is an index linear in speed^2 (fixed point Q16), thus
+//a constant index increment per step results in constant acceleration over time:
+//  v^2 = vMin^2 + 2*a*steps
+//the isr only needs integer additions and a table lookup per step
+
+//calculate interval table for speed range (at startup, uses float and sqrt)
+void ramp_init(uint32_t speedMinStepsPerS, uint32_t speedMaxStepsPerS, uint32_t timerFrequency);
+
+//index increment per step for an acceleration in steps/s^2
+uint32_t ramp_accelToIncrement(uint32_t accelStepsPerS2);
+
+//ramp index of a speed in steps/s (limited to table range)
+uint32_t ramp_speedToIndex(uint32_t speedStepsPerS);
+
+//speed in steps/s at a ramp index (for logging only)
+uint32_t ramp_indexToSpeed(uint32_t index);
+
+//timer ticks until next step at ramp index (linear interpolation between table entries)
+uint32_t ramp_interval(uint32_t index);
@@ -1,6 +1,10 @@
 //custom driver for stepper motor
 #include "config.h"
 #include "global.hpp"
+#include "params.hpp"
+#include "stepper-ramp.hpp"
+#include "stepper.hpp"
+#include "seqlock.hpp"
 #include "hal/timer_types.h"
 #include <cstdint>
 #include <inttypes.h>
@@ -9,6 +13,10 @@ extern "C" {
 #include "driver/timer.h"
 #include "driver/gpio.h"
 #include "esp_log.h"
+#ifdef STEPPER_PULSE_RMT
+#include "driver/rmt.h"
+#include "hal/rmt_ll.h"
+#endif
 }
 
 
@@ -16,14 +24,19 @@ extern "C" {
 //=== configuration ===
 //=====================
 //used macros from config.h:
+//(speed, accel and decel are runtime parameters with these defaults, see params.hpp)
 //#define STEPPER_STEP_PIN GPIO_NUM_18    //mos1
 //#define STEPPER_DIR_PIN GPIO_NUM_16     //ST3
 
 //#define STEPPER_STEPS_PER_MM	200/2	//steps/mm (steps-per-rot / slope)
 //#define STEPPER_SPEED_DEFAULT	20		//mm/s
 //#define STEPPER_SPEED_MIN		4		//mm/s  - speed threshold at which stepper immediately starts/stops
-//#define STEPPER_ACCEL_INC		3		//steps/s increment per cycle 
-//#define STEPPER_DECEL_INC		8		//steps/s decrement per cycle
+//#define STEPPER_SPEED_MAX		70		//mm/s  - highest speed the acceleration table is calculated for
+//#define STEPPER_ACCEL			35		//mm/s^2 - linear acceleration
+//#define STEPPER_DECEL			80		//mm/s^2 - linear deceleration
+//#define STEPPER_PULSE_RMT				//generate step pulse with RMT peripheral instead of busy wait in isr
+//#define STEPPER_RMT_CHANNEL	RMT_CHANNEL_0
+//#define STEPPER_PULSE_US		10		//us
 
 #define TIMER_F 1000000ULL
 #define TICK_PER_S TIMER_S
@@ -36,10 +49,10 @@ extern "C" {
 //========================
 static const char *TAG = "stepper-driver"; //tag for logging
 									
-bool direction = 1;
-bool directionTarget = 1;
-bool timerIsRunning = false;
-bool timer_isr(void *arg);
+static bool direction = 1;
+static bool directionTarget = 1;
+static volatile bool timerIsRunning = false;
+static bool timer_isr(void *arg);
 
 static timer_group_t timerGroup = TIMER_GROUP_0;
 static timer_idx_t timerIdx = TIMER_0;
@@ -48,13 +61,21 @@ static timer_idx_t timerIdx = TIMER_0;
 static uint64_t posTarget = 0;
 static uint64_t posNow = 0;
 static uint64_t stepsToGo = 0;
-static uint32_t speedMin = STEPPER_SPEED_MIN * STEPPER_STEPS_PER_MM;
-static uint32_t speedNow = speedMin;
 static int debug = 0;
 static uint32_t speedTarget = STEPPER_SPEED_DEFAULT * STEPPER_STEPS_PER_MM;
-//TODO/NOTE increment actually has to be re-calculated every run to have linear accel (because also gets called faster/slower)
-static uint32_t decel_increment = STEPPER_DECEL_INC;
-static uint32_t accel_increment = STEPPER_ACCEL_INC;
+//current speed as index in precomputed ramp (see stepper-ramp.hpp), 0 = min speed
+static uint32_t rampIndex = 0;
+static uint32_t rampIndexTarget = 0;
+//ramp index change per step for linear acceleration / deceleration
+static uint32_t accel_increment = 1;
+static uint32_t decel_increment = 1;
+
+//position and speed published by isr for other tasks (64 bit posNow can not be read atomically)
+typedef struct {
+	uint64_t posNow;
+	uint32_t rampIndex;
+} isrState_t;
+static seqlock_t<isrState_t> isrState;
 
 
 
@@ -72,6 +93,7 @@ void task_stepper_debug(void *pvParameter){
 				"stepsToGo=%llu "
 				"speedNow=%u "
 				"speedTarget=%u "
+				"rampIndex=%u "
 				"debug=%d ",
 
 				timerIsRunning,
@@ -80,8 +102,9 @@ void task_stepper_debug(void *pvParameter){
 				posTarget, 
 				posNow, 
 				stepsToGo,
-				speedNow,
+				ramp_indexToSpeed(rampIndex),
 				speedTarget,
+				rampIndex,
 				debug
 				);
 
@@ -98,6 +121,33 @@ void stepper_setSpeed(uint32_t speedMmPerS) {
 	ESP_LOGI(TAG, "set target speed from %u to %u mm/s  (%u steps/s)",
 			speedTarget, speedMmPerS, speedMmPerS * STEPPER_STEPS_PER_MM);
 	speedTarget = speedMmPerS * STEPPER_STEPS_PER_MM;
+	rampIndexTarget = ramp_speedToIndex(speedTarget);
+}
+
+
+
+//===========================
+//===== set speed steps =====
+//===========================
+//set target speed in steps/s without logging, for frequent updates (velocity following)
+//speeds below STEPPER_SPEED_MIN result in min speed
+void stepper_setSpeedSteps(uint32_t speedStepsPerS) {
+	speedTarget = speedStepsPerS;
+	rampIndexTarget = ramp_speedToIndex(speedTarget);
+}
+
+
+
+//=====================
+//===== get state =====
+//=====================
+stepperState_t stepper_getState(){
+	isrState_t state = isrState.read();
+	stepperState_t result;
+	result.posSteps = state.posNow;
+	result.running = timerIsRunning;
+	result.speed = result.running ? ramp_indexToSpeed(state.rampIndex) : 0;
+	return result;
 }
 
 
@@ -161,8 +211,11 @@ void stepper_waitForStop(uint32_t timeoutMs){
 void stepper_home(uint32_t travelMm){
 	//TODO add timeout, limitswitch...
 	ESP_LOGW(TAG, "initiate auto-home, moving %d mm...", travelMm);
+	//isr is the only writer of posNow while moving
+	stepper_waitForStop();
 	posNow = travelMm * STEPPER_STEPS_PER_MM;
-	while (posNow != 0){
+	isrState.write({posNow, 0});
+	while (stepper_getState().posSteps != 0){
 		//reactivate just in case stopped by other call to prevent deadlock
 		if (!timerIsRunning) {
 			stepper_setTargetPosSteps(0);
@@ -175,6 +228,55 @@ void stepper_home(uint32_t travelMm){
 
 
 
+//===========================
+//===== step pulse init =====
+//===========================
+#ifdef STEPPER_PULSE_RMT
+//configure RMT channel to output a single pulse of STEPPER_PULSE_US on every start
+//the item stays in RMT memory, thus the isr only has to restart the transmission
+//the tx end interrupt is disabled: nothing waits for the end of the pulse, the driver isr would run after every step.
+//rmt_tx_start() enables it again on each call, thus the isr starts the channel with rmt_ll
+static void initPulseRmt(){
+	rmt_config_t config = RMT_DEFAULT_CONFIG_TX(STEPPER_STEP_PIN, STEPPER_RMT_CHANNEL);
+	config.clk_div = 80; //1us resolution
+	config.tx_config.idle_output_en = true;
+	config.tx_config.idle_level = RMT_IDLE_LEVEL_LOW;
+	ESP_ERROR_CHECK(rmt_config(&config));
+	ESP_ERROR_CHECK(rmt_driver_install(STEPPER_RMT_CHANNEL, 0, 0));
+	//high for pulse duration, duration 0 marks end of transmission
+	rmt_item32_t pulse = {};
+	pulse.level0 = 1;
+	pulse.duration0 = STEPPER_PULSE_US;
+	pulse.level1 = 0;
+	pulse.duration1 = 0;
+	ESP_ERROR_CHECK(rmt_fill_tx_items(STEPPER_RMT_CHANNEL, &pulse, 1, 0));
+	ESP_ERROR_CHECK(rmt_set_tx_intr_en(STEPPER_RMT_CHANNEL, false));
+}
+#endif
+
+
+
+//------------------
+//--- updateRamp ---
+//------------------
+//convert acceleration parameters to ramp index increments (at init and when changed)
+static void updateRamp(paramId_t id){
+	accel_increment = ramp_accelToIncrement(param_getInt(PARAM_AXIS_ACCEL) * STEPPER_STEPS_PER_MM);
+	decel_increment = ramp_accelToIncrement(param_getInt(PARAM_AXIS_DECEL) * STEPPER_STEPS_PER_MM);
+	ESP_LOGI(TAG, "ramp increments: accel=%u decel=%u", accel_increment, decel_increment);
+}
+
+
+//-------------------
+//--- updateSpeed ---
+//-------------------
+//apply axis speed parameter as target speed (at init and when changed)
+static void updateSpeed(paramId_t id){
+	stepper_setSpeed(param_getInt(PARAM_AXIS_SPEED));
+}
+
+
+
 //========================
 //===== init stepper =====
 //========================
@@ -185,6 +287,18 @@ void stepper_init(){
 	ESP_LOGI(TAG, "init - configure gpio pins...");
 	gpio_set_direction(STEPPER_DIR_PIN, GPIO_MODE_OUTPUT);
 	gpio_set_direction(STEPPER_STEP_PIN, GPIO_MODE_OUTPUT);
+#ifdef STEPPER_PULSE_RMT
+	ESP_LOGI(TAG, "init - configure rmt for step pulse...");
+	initPulseRmt();
+#endif
+
+	ESP_LOGI(TAG, "init - calculate acceleration table...");
+	ramp_init(STEPPER_SPEED_MIN * STEPPER_STEPS_PER_MM, STEPPER_SPEED_MAX * STEPPER_STEPS_PER_MM, TIMER_F);
+	updateRamp(PARAM_AXIS_ACCEL);
+	param_onChange(PARAM_AXIS_ACCEL, updateRamp);
+	param_onChange(PARAM_AXIS_DECEL, updateRamp);
+	updateSpeed(PARAM_AXIS_SPEED);
+	param_onChange(PARAM_AXIS_SPEED, updateSpeed);
 
 	ESP_LOGI(TAG, "init - initialize/configure timer...");
 	timer_config_t timer_conf = {
@@ -205,7 +319,7 @@ void stepper_init(){
 //================================
 //=== timer interrupt function ===
 //================================
-bool timer_isr(void *arg) {
+static bool timer_isr(void *arg) {
 
 	//-----------------
 	//--- variables ---
@@ -225,8 +339,10 @@ bool timer_isr(void *arg) {
 			gpio_set_level(STEPPER_DIR_PIN, direction);
 			stepsToGo = abs(int64_t(posTarget - posNow));
 		} else {
-			//set to minimun decel steps
-			stepsToGo = (speedNow - speedMin) / decel_increment;
+			//set to minimun decel steps (divides only when not already set, then both decrease per step)
+			if (stepsToGo * decel_increment > rampIndex || (stepsToGo + 1) * decel_increment <= rampIndex) {
+				stepsToGo = rampIndex / decel_increment;
+			}
 		}
 	}
 	//NORMAL (any direction 0/1)
@@ -237,34 +353,41 @@ bool timer_isr(void *arg) {
 	//--------------------
 	//--- define speed ---
 	//--------------------
-	//FIXME noticed crash: division by 0 when min speed > target speed
-	uint64_t stepsDecelRemaining = (speedNow - speedMin) / decel_increment;
+	//ramp index is linear in speed^2 -> steps needed to reach min speed with constant deceleration:
+	//rampIndex / decel_increment, compared in ramp index units instead (no division per step)
+	uint64_t decelIndexToGo = stepsToGo * decel_increment;
 	//DECELERATE
 
 	//prevent hard stop (faster stop than decel ramp)
 	//Idea: when target gets lowered while decelerating, 
 	//      move further than target to not exceed decel ramp (overshoot),
 	//      then change dir and move back to actual target pos
-	if (stepsToGo < stepsDecelRemaining/2){ //significantly less steps planned to comply with decel ramp
-		stepsToGo = stepsDecelRemaining; //set to required steps
+	if ((stepsToGo + 1) * 2 * decel_increment <= rampIndex){ //significantly less steps planned to comply with decel ramp
+		stepsToGo = rampIndex / decel_increment; //set to required steps
+		decelIndexToGo = stepsToGo * decel_increment;
 	}
 
-	if (stepsToGo <= stepsDecelRemaining) {
-		if ((speedNow - speedMin) > decel_increment) {
-			speedNow -= decel_increment;
+	if (decelIndexToGo <= rampIndex) {
+		if (rampIndex > decel_increment) {
+			rampIndex -= decel_increment;
 		} else {
-			speedNow = speedMin; //PAUSE HERE??? / irrelevant?
+			rampIndex = 0; //min speed
 		}
 	}
 	//ACCELERATE
-	else if (speedNow < speedTarget) {
-		speedNow += accel_increment;
-		if (speedNow > speedTarget) speedNow = speedTarget;
+	else if (rampIndex < rampIndexTarget) {
+		rampIndex += accel_increment;
+		if (rampIndex > rampIndexTarget) rampIndex = rampIndexTarget;
 	}
-	//COASTING
-	else { //not relevant?
-		speedNow = speedTarget;
+	//SLOW DOWN (target speed was lowered)
+	else if (rampIndex > rampIndexTarget) {
+		if (rampIndex - rampIndexTarget > decel_increment) {
+			rampIndex -= decel_increment;
+		} else {
+			rampIndex = rampIndexTarget;
+		}
 	}
+	//COASTING at target speed
 
 	//-------------------------------
 	//--- update timer, increment ---
@@ -273,18 +396,25 @@ bool timer_isr(void *arg) {
 	if (stepsToGo == 0) {
 		timer_pause(timerGroup, timerIdx);
 		timerIsRunning = false;
-		speedNow = speedMin;
+		rampIndex = 0;
+		isrState.writeFromIsr({posNow, rampIndex});
 		return 1;
 	}
 
 	//STEPS REMAINING -> NEXT STEP
-	//update timer with new speed
-	ESP_ERROR_CHECK(timer_set_alarm_value(timerGroup, timerIdx, TIMER_F / speedNow));
+	//update timer with new speed (precomputed interval, no division in isr)
+	ESP_ERROR_CHECK(timer_set_alarm_value(timerGroup, timerIdx, ramp_interval(rampIndex)));
 
 	//generate pulse
+#ifdef STEPPER_PULSE_RMT
+	//pulse is output by hardware, no waiting (no tx end interrupt, see initPulseRmt)
+	rmt_ll_tx_reset_pointer(&RMT, STEPPER_RMT_CHANNEL);
+	rmt_ll_tx_start(&RMT, STEPPER_RMT_CHANNEL);
+#else
 	GPIO.out_w1ts = (1ULL << STEPPER_STEP_PIN); //turn on (fast)
-	ets_delay_us(10);
+	ets_delay_us(STEPPER_PULSE_US);
 	GPIO.out_w1tc = (1ULL << STEPPER_STEP_PIN); //turn off (fast)
+#endif
 
 	//increment pos
 	stepsToGo --;
@@ -298,6 +428,7 @@ bool timer_isr(void *arg) {
 			ESP_LOGE(TAG,"isr: posNow would be negative - ignoring decrement");
 		}
 	}
+	isrState.writeFromIsr({posNow, rampIndex});
 	return 1;
 }
 
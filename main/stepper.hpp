@@ -1,4 +1,12 @@
 #pragma once
+#include <stdint.h>
+
+//state of the stepper driver, published by timer isr
+typedef struct {
+	uint64_t posSteps;	//actual position in steps
+	uint32_t speed;		//current speed in steps/s
+	bool running;		//timer running / moving to target
+} stepperState_t;
 
 //init stepper pins and timer
 void stepper_init();
@@ -19,6 +27,12 @@ void stepper_setTargetPosMm(uint32_t posMm);
 //set target speed in millimeters per second
 void stepper_setSpeed(uint32_t speedMmPerS);
 
+//set target speed in steps per second (no logging, for frequent updates)
+void stepper_setSpeedSteps(uint32_t speedStepsPerS);
+
+//get consistent snapshot of position and speed without blocking the isr (task context)
+stepperState_t stepper_getState();
+
 
 
 //task that periodically logs variables for debugging stepper driver
@@ -1,19 +1,26 @@
 #include "switchesAnalog.hpp"
 #include "config.h"
 #include "global.hpp"
+#include "adc-service.hpp"
 
 #define CHECK_BIT(var,pos) (((var)>>(pos)) & 1) //TODO duplicate code: same macro already used in vfd.cpp
 
 
 
 
+//=====================
+//=== configuration ===
+//=====================
+//decoded code has to be read in that many consecutive scans to be accepted
+//(filters intermediate codes while the ladder voltage settles, e.g. pressing two buttons)
+#define STABLE_SCANS 2
+
+
+
 //=====================
 //===== Variables =====
 //=====================
 static const char *TAG = "switches-analog"; //tag for logging
-int diffMin = 4095;
-int adcValue;
-int match_index = 0;
 
 //array that describes voltages for all combinations of the 4 inputs
 const int lookup_voltages[] = {
@@ -36,44 +43,60 @@ const int lookup_voltages[] = {
     1363  //1111
 };
 
+//state of last scan
+static TickType_t lastScanTick = 0;
+static bool scannedOnce = false;
+static uint8_t codeStable = 0;      //debounced state of all 4 switches (bit 0 = S0)
+static uint8_t codeCandidate = 0;   //code read recently, not yet stable
+static int candidateCount = 0;
 
 
 
-//===========================
-//===== handle function =====
-//===========================
-//handle demuxing of 4 switches from 1 adc (has to be run repeatedly)
-void handle(){
-    //read current voltage
-    adcValue = gpio_readAdc(ADC_CHANNEL_4SW_TO_ANALOG);
-    ESP_LOGI(TAG, "voltage read: %d", adcValue);
 
-    //find closest match in lookup table
-    diffMin = 4095; //reset diffMin each run
+//---------------------
+//---- decodeAdc ------
+//---------------------
+//find closest match in lookup table -> bit per switch
+static uint8_t decodeAdc(int adcValue){
+    int diffMin = 4095;
+    uint8_t match_index = 0;
     for (int i=0; i<16; i++){
-        int diff = fabs(adcValue - lookup_voltages[i]);
+        int diff = abs(adcValue - lookup_voltages[i]);
         if (diff < diffMin){
             diffMin = diff;
             match_index = i;
         }
     }
+    return match_index;
+}
 
-    //get bool values for each input from matched index
-    bool s0 = CHECK_BIT(match_index, 0);
-    bool s1 = CHECK_BIT(match_index, 1);
-    bool s2 = CHECK_BIT(match_index, 2);
-    bool s3 = CHECK_BIT(match_index, 3);
-    //bool s1 = ((match_index & 0b1000) == 0b1000);
-    //bool s2 = ((match_index & 0b0100) == 0b0100);
-    //bool s3 = ((match_index & 0b0010) == 0b0010);
-    //bool s4 = ((match_index & 0b0001) == 0b0001);
-
-
-    //log results
-    ESP_LOGI(TAG, "adcRead: %d, closest-match: %d, diff: %d, index: %d, switches: %d%d%d%d",
-            adcValue, lookup_voltages[match_index], diffMin, match_index, (int)s3, (int)s2, (int)s1, (int)s0);
 
 
+//=========================
+//===== scan function =====
+//=========================
+//read the resistor ladder once and debounce the decoded state of all 4 switches
+//run at most once per tick (switchesAnalog_getState does that automatically)
+void switchesAnalog_scan(){
+    lastScanTick = xTaskGetTickCount();
+    scannedOnce = true;
+    //read current voltage (one multisampled read for all switches)
+    int adcValue = adcService_get(ADC_CHANNEL_4SW_TO_ANALOG);
+    uint8_t code = decodeAdc(adcValue);
+
+    //accept code when read in STABLE_SCANS consecutive scans
+    if (code != codeCandidate) {
+        codeCandidate = code;
+        candidateCount = 1;
+    } else if (candidateCount < STABLE_SCANS) {
+        candidateCount++;
+    }
+    if (candidateCount >= STABLE_SCANS && codeStable != codeCandidate) {
+        ESP_LOGD(TAG, "adcRead: %d, closest-match: %d, switches: %d%d%d%d",
+                adcValue, lookup_voltages[code],
+                CHECK_BIT(code, 3), CHECK_BIT(code, 2), CHECK_BIT(code, 1), CHECK_BIT(code, 0));
+        codeStable = codeCandidate;
+    }
 }
 
 
@@ -82,13 +105,13 @@ void handle(){
 //===== getState =====
 //====================
 //get state of certain switch (0-3)
+//all switches share one scan per tick, thus querying all 4 switches reads the adc once
 bool switchesAnalog_getState(int swNumber){
-    //run handle function to obtain all current input states
-    handle();
+    if (!scannedOnce || xTaskGetTickCount() != lastScanTick) {
+        switchesAnalog_scan();
+    }
     //get relevant bit
-    bool state = CHECK_BIT(match_index, swNumber);
-    ESP_LOGI(TAG, "returned state of switch No. %d = %i", swNumber, (int)state);
-    return state;
+    return CHECK_BIT(codeStable, swNumber);
 }
 
 bool switchesAnalog_getState_sw0(){
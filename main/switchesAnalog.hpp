@@ -3,6 +3,7 @@ extern "C"
 {
 #include <stdio.h>
 #include <freertos/FreeRTOS.h>
+#include <freertos/task.h>
 #include "esp_log.h"
 #include "driver/adc.h"
 #include <math.h>
@@ -11,7 +12,11 @@ extern "C"
 #include "gpio_adc.hpp"
 
 
-//get current state of certain switch
+//read the resistor ladder once and debounce the decoded state of all 4 switches
+//called automatically by switchesAnalog_getState at most once per tick
+void switchesAnalog_scan();
+
+//get debounced state of certain switch (0-3) from the last scan
 bool switchesAnalog_getState(int swNumber);
 
 bool switchesAnalog_getState_sw0();
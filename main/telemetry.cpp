@@ -0,0 +1,119 @@
+extern "C"
+{
+#include <freertos/FreeRTOS.h>
+#include "esp_log.h"
+}
+
+#include "config.h"
+#include "telemetry.hpp"
+#include "control.hpp"
+
+
+//----------------------
+//----- variables ------
+//----------------------
+static const char *TAG = "telemetry";
+
+//ring buffer, written by control task, read by console task -> short critical sections only
+static telemetryRecord_t ring[TELEMETRY_RING_LENGTH];
+static uint32_t ringHead = 0;  //index the next record is written to
+static uint32_t ringCount = 0;
+static uint32_t pieceCount = 0;
+static portMUX_TYPE ringMux = portMUX_INITIALIZER_UNLOCKED;
+
+static_assert(sizeof(systemStateStr) / sizeof(systemStateStr[0]) == TELEMETRY_STATE_COUNT,
+        "TELEMETRY_STATE_COUNT does not match systemState_t");
+
+
+
+//=====================
+//=== telemetry_add ===
+//=====================
+void telemetry_add(telemetryRecord_t *record){
+    portENTER_CRITICAL(&ringMux);
+    record->piece = ++pieceCount;
+    ring[ringHead] = *record;
+    ringHead = (ringHead + 1) % TELEMETRY_RING_LENGTH;
+    if (ringCount < TELEMETRY_RING_LENGTH) ringCount++;
+    portEXIT_CRITICAL(&ringMux);
+
+    const uint32_t *ms = record->stateMs;
+    ESP_LOGI(TAG, "piece %d: %dmm (target %d, overshoot %d) idle=%d start=%d wind=%d stop=%d countdown=%d cut=%d cutter=%d/%d",
+            record->piece, record->lengthMeasuredMm, record->lengthTargetMm, record->overshootMm,
+            ms[(int)systemState_t::COUNTING], ms[(int)systemState_t::WINDING_START], ms[(int)systemState_t::WINDING],
+            ms[(int)systemState_t::TARGET_REACHED], ms[(int)systemState_t::AUTO_CUT_WAITING], ms[(int)systemState_t::CUTTING],
+            record->cutterReturnMs, record->cutterMs);
+}
+
+
+
+//=======================
+//=== telemetry_count ===
+//=======================
+int telemetry_count(){
+    portENTER_CRITICAL(&ringMux);
+    int count = ringCount;
+    portEXIT_CRITICAL(&ringMux);
+    return count;
+}
+
+
+
+//===========================
+//=== telemetry_getLatest ===
+//===========================
+bool telemetry_getLatest(telemetryRecord_t *record){
+    portENTER_CRITICAL(&ringMux);
+    bool found = ringCount > 0;
+    if (found) *record = ring[(ringHead + TELEMETRY_RING_LENGTH - 1) % TELEMETRY_RING_LENGTH];
+    portEXIT_CRITICAL(&ringMux);
+    return found;
+}
+
+
+
+//=======================
+//=== telemetry_clear ===
+//=======================
+void telemetry_clear(){
+    portENTER_CRITICAL(&ringMux);
+    ringCount = 0;
+    portEXIT_CRITICAL(&ringMux);
+}
+
+
+
+//==========================
+//=== telemetry_printCsv ===
+//==========================
+void telemetry_printCsv(FILE *out){
+    //--- header ---
+    fprintf(out, "piece,timestamp_ms,target_mm,motor_off_mm,measured_mm,overshoot_mm");
+    for (int state = 0; state < TELEMETRY_STATE_COUNT; state++) {
+        fprintf(out, ",%s_ms", systemStateStr[state]);
+    }
+    fprintf(out, ",lvl0_ms,lvl1_ms,lvl2_ms,lvl3_ms,cutter_ms,cutter_return_ms,flags\n");
+
+    //--- records, oldest first ---
+    //copy one record at a time: printing is slow, the control task may add records meanwhile
+    portENTER_CRITICAL(&ringMux);
+    uint32_t pieceFirst = pieceCount - ringCount + 1;
+    uint32_t pieceLast = pieceCount;
+    portEXIT_CRITICAL(&ringMux);
+    for (uint32_t piece = pieceFirst; piece <= pieceLast; piece++) {
+        telemetryRecord_t r;
+        portENTER_CRITICAL(&ringMux);
+        uint32_t age = pieceCount - piece; //0 = latest
+        bool available = age < ringCount;
+        if (available) r = ring[(ringHead + TELEMETRY_RING_LENGTH - 1 - age) % TELEMETRY_RING_LENGTH];
+        portEXIT_CRITICAL(&ringMux);
+        if (!available) continue; //overwritten meanwhile
+        fprintf(out, "%u,%u,%d,%d,%d,%d", r.piece, r.timestampMs, r.lengthTargetMm, r.lengthMotorOffMm,
+                r.lengthMeasuredMm, r.overshootMm);
+        for (int state = 0; state < TELEMETRY_STATE_COUNT; state++) {
+            fprintf(out, ",%u", r.stateMs[state]);
+        }
+        fprintf(out, ",%u,%u,%u,%u,%u,%u,%u\n", r.levelMs[0], r.levelMs[1], r.levelMs[2], r.levelMs[3],
+                r.cutterMs, r.cutterReturnMs, r.flags);
+    }
+}
@@ -0,0 +1,50 @@
+#pragma once
+#include <stdint.h>
+#include <stdio.h>
+
+//per-piece telemetry: one fixed-size record per cut piece in a ring buffer in RAM
+//(the oldest records are overwritten), recorded by the control task and exported as csv
+//over the console uart (see console.cpp) for offline throughput and accuracy statistics
+
+
+//number of systemState_t values (control.hpp)
+#define TELEMETRY_STATE_COUNT 8
+
+//flags of telemetryRecord_t
+#define TELEMETRY_FLAG_JOB 0x01         //piece of a production job
+#define TELEMETRY_FLAG_PIPELINED 0x02   //control continued while the cutter was still returning
+#define TELEMETRY_FLAG_CUTTER_FAULT 0x04 //cutter cycle canceled or timed out
+
+//one cut piece
+//the record starts when control continued after the previous cut and ends when the cutter is back
+//at idle position, thus the state durations add up to the time between two cuts
+typedef struct {
+    uint32_t piece;             //running number since power on
+    uint32_t timestampMs;       //start of record (esp_log_timestamp)
+    uint32_t stateMs[TELEMETRY_STATE_COUNT]; //time spent in each systemState_t (COUNTING: idle)
+    uint32_t levelMs[4];        //time wound at each vfd speed level (setDynSpeedLvl)
+    uint32_t cutterMs;          //cutter started until back at idle position
+    uint32_t cutterReturnMs;    //part of cutterMs after control already continued
+    int32_t lengthTargetMm;
+    int32_t lengthMotorOffMm;   //length when the motor was turned off at target
+    int32_t lengthMeasuredMm;   //length at cut
+    int16_t overshootMm;        //length at cut - target
+    uint8_t flags;
+    uint8_t reserved;
+} telemetryRecord_t;
+
+
+//append complete record (overwrites oldest when full), sets the piece number
+void telemetry_add(telemetryRecord_t *record);
+
+//number of records currently stored
+int telemetry_count();
+
+//copy latest record, returns false when there is none
+bool telemetry_getLatest(telemetryRecord_t *record);
+
+//remove all records
+void telemetry_clear();
+
+//print all stored records as csv with header line, oldest first
+void telemetry_printCsv(FILE *out);
@@ -1,14 +1,133 @@
 #include "vfd.hpp"
 #include "config.h"
 #include "global.hpp"
+#include <cmath>
+#ifdef VFD_ANALOG_SPEED
+extern "C" {
+#include "driver/ledc.h"
+}
+#endif
+#ifdef VFD_MODBUS
+#include "modbus-rtu.hpp"
+#endif
 
 #define CHECK_BIT(var,pos) (((var)>>(pos)) & 1)
 
 const char* vfd_directionStr[2] = {"FWD", "REV"};
 static const char *TAG = "vfd";
 static uint8_t level = 0; //current speed level
-static bool state = false; //current state
+static volatile bool state = false; //current state (also turned off by isr)
 static vfd_direction_t direction = FWD; //current direction
+static const float levelPercent[4] = VFD_LEVEL_PERCENT;
+#ifdef VFD_CONTINUOUS_SPEED
+static float percent = 0; //current frequency reference
+#endif
+#ifdef VFD_ANALOG_SPEED
+#define PWM_CHANNEL LEDC_CHANNEL_0
+#define PWM_MODE LEDC_HIGH_SPEED_MODE
+#endif
+#ifdef VFD_MODBUS
+static modbus_t bus;
+static volatile uint16_t frequencyReference = 0; //0.1Hz, written to the vfd by the modbus task
+static vfdFeedback_t feedback = {};
+static bool feedbackReceived = false;
+static portMUX_TYPE feedbackMux = portMUX_INITIALIZER_UNLOCKED;
+//feedback registers are read as one block
+#define REG_FIRST VFD_REG_FREQUENCY
+#define REG_COUNT (VFD_REG_TEMPERATURE - VFD_REG_FREQUENCY + 1)
+#ifdef VFD_REG_FAULT
+static_assert(VFD_REG_FAULT >= REG_FIRST && VFD_REG_FAULT < REG_FIRST + REG_COUNT, "VFD_REG_FAULT not in read block");
+#endif
+#endif
+
+
+
+#ifdef VFD_MODBUS
+//=============================
+//======== modbus task ========
+//=============================
+//writes the frequency reference when changed and reads all feedback registers in one transaction
+//every VFD_MODBUS_PERIOD_MS (control task only reads the latest values, never waits for the bus)
+static void task_vfdModbus(void *pvParameter){
+    uint32_t written = UINT32_MAX; //reference written last, unknown -> write at first run
+    int failedReads = 0; //consecutive
+    TickType_t lastWake = xTaskGetTickCount();
+    while (1) {
+        //--- frequency reference ---
+        uint16_t reference = frequencyReference;
+        if (reference != written && modbus_writeRegister(&bus, VFD_REG_FREQUENCY, reference) == MODBUS_OK) {
+            written = reference;
+        }
+
+        //--- feedback ---
+        uint16_t registers[REG_COUNT];
+        modbusResult_t result = modbus_readRegisters(&bus, REG_FIRST, REG_COUNT, registers);
+        portENTER_CRITICAL(&feedbackMux);
+        if (result == MODBUS_OK) {
+            feedback.frequencyHz = registers[VFD_REG_FREQUENCY - REG_FIRST] / 10.0;
+            feedback.runState = registers[VFD_REG_RUN_STATE - REG_FIRST];
+            feedback.busVoltageV = registers[VFD_REG_VOLTAGE - REG_FIRST] / 10.0;
+            feedback.currentA = registers[VFD_REG_CURRENT - REG_FIRST] / 100.0;
+            feedback.temperatureC = registers[VFD_REG_TEMPERATURE - REG_FIRST];
+#ifdef VFD_REG_FAULT
+            feedback.faultCode = registers[VFD_REG_FAULT - REG_FIRST];
+#endif
+            feedback.timestampMs = esp_log_timestamp();
+            feedbackReceived = true;
+        }
+        feedback.transactions = bus.transactions;
+        feedback.errors = bus.errors;
+        portEXIT_CRITICAL(&feedbackMux);
+
+        //single errors are retried in the next period, log when communication is lost / back only
+        if (result != MODBUS_OK) {
+            if (++failedReads == VFD_MODBUS_LOST_READS) {
+                ESP_LOGE(TAG, "modbus: communication lost: %s", modbusResultStr[result]);
+            }
+        } else {
+            if (failedReads >= VFD_MODBUS_LOST_READS) {
+                ESP_LOGW(TAG, "modbus: communication ok after %d failed reads", failedReads);
+                written = UINT32_MAX; //vfd may have been reset -> write reference again
+            }
+            failedReads = 0;
+        }
+        vTaskDelayUntil(&lastWake, pdMS_TO_TICKS(VFD_MODBUS_PERIOD_MS));
+    }
+}
+#endif
+
+
+
+//=============================
+//========== init =============
+//=============================
+void vfd_init(){
+#ifdef VFD_ANALOG_SPEED
+    //pwm is filtered to a voltage for the analog input of the vfd
+    ledc_timer_config_t timerConfig = {};
+    timerConfig.speed_mode = PWM_MODE;
+    timerConfig.duty_resolution = VFD_PWM_RESOLUTION;
+    timerConfig.timer_num = LEDC_TIMER_0;
+    timerConfig.freq_hz = VFD_PWM_FREQUENCY_HZ;
+    timerConfig.clk_cfg = LEDC_AUTO_CLK;
+    ESP_ERROR_CHECK(ledc_timer_config(&timerConfig));
+    ledc_channel_config_t channelConfig = {};
+    channelConfig.gpio_num = GPIO_VFD_ANALOG;
+    channelConfig.speed_mode = PWM_MODE;
+    channelConfig.channel = PWM_CHANNEL;
+    channelConfig.intr_type = LEDC_INTR_DISABLE;
+    channelConfig.timer_sel = LEDC_TIMER_0;
+    channelConfig.duty = 0;
+    ESP_ERROR_CHECK(ledc_channel_config(&channelConfig));
+    ESP_LOGI(TAG, "analog speed reference: pwm %dHz on gpio %d", VFD_PWM_FREQUENCY_HZ, (int)GPIO_VFD_ANALOG);
+#endif
+#ifdef VFD_MODBUS
+    if (modbus_init(&bus, VFD_MODBUS_UART, VFD_MODBUS_BAUD, GPIO_VFD_MODBUS_TX, GPIO_VFD_MODBUS_RX,
+                GPIO_VFD_MODBUS_DE, VFD_MODBUS_SLAVE_ID, VFD_MODBUS_TIMEOUT_MS) == ESP_OK) {
+        xTaskCreate(task_vfdModbus, "vfdModbus", 3072, NULL, VFD_MODBUS_TASK_PRIORITY, NULL);
+    }
+#endif
+}
 
 
 //=============================
@@ -48,6 +167,63 @@ void vfd_setState(bool stateNew, vfd_direction_t directionNew){
 
 
 
+//=============================
+//======= stopFromIsr =========
+//=============================
+//target length trip in encoder isr (control.cpp)
+void vfd_stopFromIsr(){
+    gpio_set_level(GPIO_VFD_FWD, 0);
+    gpio_set_level(GPIO_VFD_REV, 0);
+    state = false;
+}
+
+
+
+//=============================
+//====== setSpeedPercent ======
+//=============================
+#ifdef VFD_CONTINUOUS_SPEED
+void vfd_setSpeedPercent(float percentNew){
+    if (percentNew < 0) percentNew = 0;
+    if (percentNew > 100) percentNew = 100;
+    //profile changes the value every control cycle -> no info log
+    if (fabsf(percentNew - percent) < 0.05) return;
+    percent = percentNew;
+    level = vfd_percentToLevel(percent);
+#ifdef VFD_ANALOG_SPEED
+    uint32_t duty = percent / 100 * ((1 << VFD_PWM_BITS) - 1) + 0.5;
+    ledc_set_duty(PWM_MODE, PWM_CHANNEL, duty);
+    ledc_update_duty(PWM_MODE, PWM_CHANNEL);
+    ESP_LOGD(TAG, "speed reference %.1f%% (duty %d, level %d)", percent, duty, level);
+#else
+    //written by modbus task
+    frequencyReference = percent / 100 * VFD_MAX_FREQUENCY_HZ * 10 + 0.5;
+    ESP_LOGD(TAG, "speed reference %.1f%% (%.1fHz, level %d)", percent, frequencyReference / 10.0, level);
+#endif
+}
+
+void vfd_setSpeedLevel(uint8_t levelNew){
+    if (levelNew > 3) levelNew = 3;
+    if (level == levelNew && fabsf(percent - levelPercent[levelNew]) < 0.05) return;
+    ESP_LOGI(TAG, "CHANGING speed level from %i to %i (%.1f%%)", level, levelNew, levelPercent[levelNew]);
+    vfd_setSpeedPercent(levelPercent[levelNew]);
+}
+
+float vfd_getSpeedPercent(){
+    return percent;
+}
+
+#else
+void vfd_setSpeedPercent(float percentNew){
+    vfd_setSpeedLevel(vfd_percentToLevel(percentNew));
+}
+
+float vfd_getSpeedPercent(){
+    return levelPercent[level];
+}
+
+
+
 //=============================
 //======= setSpeedLevel =======
 //=============================
@@ -114,3 +290,66 @@ void vfd_setSpeedLevel(uint8_t levelNew){
     //ESP_LOGI(TAG, " - pin state: D2=%i, D1=%i, D0=%i", (int)D2, (int)D1, (int)D0);
     ESP_LOGI(TAG, " - pin state: D1=%i, D0=%i", (int)D1, (int)D0);
 }
+#endif //VFD_CONTINUOUS_SPEED
+
+
+
+//=============================
+//===== getState / Level ======
+//=============================
+bool vfd_getState(){
+    return state;
+}
+
+uint8_t vfd_getSpeedLevel(){
+    return level;
+}
+
+
+
+//=============================
+//====== percentToLevel =======
+//=============================
+uint8_t vfd_percentToLevel(float percentNow){
+    uint8_t lvl = 0;
+    for (uint8_t i = 1; i < 4; i++) {
+        if (percentNow >= levelPercent[i] - 0.05) lvl = i;
+    }
+    return lvl;
+}
+
+
+
+//=============================
+//======== getFeedback ========
+//=============================
+bool vfd_getFeedback(vfdFeedback_t *feedbackOut){
+#ifdef VFD_MODBUS
+    portENTER_CRITICAL(&feedbackMux);
+    *feedbackOut = feedback;
+    bool received = feedbackReceived;
+    portEXIT_CRITICAL(&feedbackMux);
+    return received && esp_log_timestamp() - feedbackOut->timestampMs <= VFD_MODBUS_FEEDBACK_MAX_AGE_MS;
+#else
+    return false;
+#endif
+}
+
+
+
+//=============================
+//======= printFeedback =======
+//=============================
+void vfd_printFeedback(FILE *out){
+#ifdef VFD_MODBUS
+    vfdFeedback_t now;
+    bool valid = vfd_getFeedback(&now);
+    fprintf(out, "reference %.1fHz, %s\n", frequencyReference / 10.0, valid ? "feedback:" : "NO CURRENT FEEDBACK, last:");
+    fprintf(out, "output %.1fHz  current %.2fA  bus %.1fV  temperature %dC  run state %d  fault %d  (%ums ago)\n",
+            now.frequencyHz, now.currentA, now.busVoltageV, now.temperatureC, now.runState, now.faultCode,
+            esp_log_timestamp() - now.timestampMs);
+    fprintf(out, "modbus: %u transactions, %u errors\n", now.transactions, now.errors);
+#else
+    fprintf(out, "no vfd feedback (VFD_MODBUS disabled)\n");
+#endif
+}
@@ -15,8 +15,51 @@ typedef enum vfd_direction_t {FWD, REV} vfd_direction_t;
 //strubg array to be able to log direction state as string
 extern const char* vfd_directionStr[2];
 
+//configure speed output (VFD_ANALOG_SPEED: ledc pwm, VFD_MODBUS: uart and polling task),
+//run once after the gpios are configured
+void vfd_init();
+
 //function for setting the state and optional direction of the motor: on/off, FWD/REV (default FWD)
 void vfd_setState(bool stateNew, vfd_direction_t direction = FWD);
 
+//turn motor off from interrupt context (no logging), vfd_getState() is false afterwards
+void vfd_stopFromIsr();
+
 //function for setting the speed level (0-3)
+//VFD_CONTINUOUS_SPEED: sets the frequency of the level (VFD_LEVEL_PERCENT)
 void vfd_setSpeedLevel(uint8_t levelNew = 0);
+
+//set frequency in percent of the max frequency
+//digital speed levels: highest level not faster than that is selected
+void vfd_setSpeedPercent(float percentNew);
+
+//get current state (motor on) and speed level
+//VFD_CONTINUOUS_SPEED: level is the highest level not faster than the current frequency
+bool vfd_getState();
+uint8_t vfd_getSpeedLevel();
+float vfd_getSpeedPercent();
+
+//highest speed level with a frequency not above percent
+uint8_t vfd_percentToLevel(float percent);
+
+
+//feedback read from the vfd (VFD_MODBUS), all values of one batch read
+typedef struct {
+    float frequencyHz;      //output frequency
+    float currentA;
+    float busVoltageV;
+    int temperatureC;
+    uint16_t runState;      //1 = fwd, 2 = stop, 3 = rev
+    uint16_t faultCode;     //0 = no fault (VFD_REG_FAULT)
+    uint32_t timestampMs;   //time of the read (esp_log_timestamp)
+    //communication statistics
+    uint32_t transactions;
+    uint32_t errors;
+} vfdFeedback_t;
+
+//copy latest feedback, returns false when there is none or it is older than VFD_MODBUS_FEEDBACK_MAX_AGE_MS
+//(communication lost, digital or analog speed reference)
+bool vfd_getFeedback(vfdFeedback_t *feedback);
+
+//print feedback and communication statistics
+void vfd_printFeedback(FILE *out);
@@ -0,0 +1,441 @@
+//host simulation of the cable-length-cutter firmware
+//runs the unmodified firmware (main/ and components/) against stubbed FreeRTOS and
+//peripheral drivers on a virtual clock. A virtual machine (sim_machine.cpp) reacts to the
+//outputs and feeds encoder edges, switches and step pulses back.
+//An operator task repeatedly winds and auto-cuts pieces and statistics are printed at the end.
+//With -j the pieces are programmed as one production job instead, START stays on for all of them.
+//With -t the telemetry records are requested over the console uart at the end (csv on stdout).
+//With -l the encoder roller slips depending on the cable speed (see slip correction, console command "slip").
+//With -k the encoder is calibrated on the machine first (calibration mode, true length entered with poti).
+//With -s a console command is sent before the first piece, e.g. -s "param cutDelay 1000" (repeatable).
+//The vfd is simulated as modbus slave too (sim_modbus.cpp, used with VFD_MODBUS), -m drops a fraction of its responses.
+//With -o the supply spool is empty and with -x the cable jams after the given meters (stall / empty spool detection).
+//
+//Power loss: -b drops the supply voltage at a virtual time and stops shortly after,
+//with -f the flash partitions are kept in a file, thus a second run resumes from the stored state.
+//
+//usage: ./host-sim [-n jobs] [-p preset 0-3] [-j] [-e encoderScaleError] [-l slipPerMps] [-b brownOutMs] [-f flashFile] [-c] [-t] [-k] [-s command]
+//                  [-m modbusLossRate] [-o cableEndM] [-x jamAtM] [-v[v[v]]]
+#include <cstdio>
+#include <cstdlib>
+#include <cmath>
+#include <chrono>
+#include <vector>
+#include <unistd.h>
+
+extern "C" {
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+void app_main();
+}
+#include "config.h"
+#include "control.hpp"
+#include "encoder.hpp"
+#include "cutter.hpp"
+#include "telemetry.hpp"
+#include "params.hpp"
+#include "sim.hpp"
+
+extern systemState_t controlState; //defined in control.cpp
+
+//time waited after power on for welcome message and guide auto-home
+#define SETTLE_MS 8000
+//abort a job if it takes longer than this
+#define JOB_TIMEOUT_MS 120000
+//supply voltage drops below shutdown threshold at brown-out, power is completely lost after hold-up time
+#define BROWN_OUT_ADC 2500
+#define HOLD_UP_MS 100
+
+
+//=====================
+//===== variables =====
+//=====================
+typedef struct {
+    int targetMm;
+    double trueMm;      //actual length of cut piece
+    int measuredMm;     //encoder length at time of cut
+    uint32_t cycleMs;   //start pressed until cut finished
+} jobResult_t;
+
+static int jobCount = 20;
+static int preset = 0;
+static bool productionJob = false; //program pieces as job (control_addJob) instead of pressing START for each
+static bool printCsv = false;
+static bool dumpTelemetry = false; //send console command "telemetry" after the last piece
+static bool calibrateFirst = false; //run calibration mode before the first piece
+static std::vector<const char *> consoleCommands; //sent over the console uart before the first piece
+static std::vector<jobResult_t> results;
+static jobResult_t jobNow;
+static uint64_t guideBlockedAtStart = 0;
+static uint32_t brownOutMs = 0; //0 = no brown-out
+static uint64_t brownOutUs = 0; //virtual time supply dropped
+static double modbusLossRate = 0;
+
+//comparison of encoder speed estimate with true reel speed
+static double speedErrorSquareSum = 0;
+static double speedErrorMax = 0;
+static uint64_t speedSamples = 0;
+
+//adc value of the 4-switch resistor ladder with only one switch pressed (see switchesAnalog.cpp)
+static const int ladderSingleSwitch[4] = {3780, 3390, 2760, 1964};
+static const int presetLengthMm[4] = {5000, 5000, 10000, 15000}; //0 = default target length
+
+
+
+//---------------------------
+//----- local functions -----
+//---------------------------
+static void onCut(double pieceMm){
+    jobNow.trueMm = pieceMm;
+    jobNow.measuredMm = encoder_getLenMm();
+}
+
+//true when the firmware stopped the reel after a simulated fault (-o, -x), nothing will happen anymore
+static bool stoppedAfterFault(){
+    return machineState.faultStopUs != 0 && controlState == systemState_t::COUNTING;
+}
+
+//wait until control task reaches state, returns false on timeout or when stopped after a fault
+static bool waitForState(systemState_t state, uint32_t timeoutMs){
+    uint32_t start = esp_log_timestamp();
+    while (controlState != state) {
+        if (esp_log_timestamp() - start > timeoutMs || stoppedAfterFault()) return false;
+        vTaskDelay(1);
+    }
+    return true;
+}
+
+//wait until control task leaves state, returns false on timeout
+static bool waitForStateLeft(systemState_t state, uint32_t timeoutMs){
+    uint32_t start = esp_log_timestamp();
+    while (controlState == state) {
+        if (esp_log_timestamp() - start > timeoutMs) return false;
+        vTaskDelay(1);
+    }
+    return true;
+}
+
+//wait until cutter finished its cycle, returns false on timeout
+static bool waitForCutterIdle(uint32_t timeoutMs){
+    uint32_t start = esp_log_timestamp();
+    while (cutter_isRunning()) {
+        if (esp_log_timestamp() - start > timeoutMs) return false;
+        vTaskDelay(1);
+    }
+    return true;
+}
+
+static void pressLadderSwitch(int index, uint32_t ms){
+    sim_adcSetRaw(ADC_CHANNEL_4SW_TO_ANALOG, ladderSingleSwitch[index]);
+    vTaskDelay(pdMS_TO_TICKS(ms));
+    sim_adcSetRaw(ADC_CHANNEL_4SW_TO_ANALOG, 4095);
+    vTaskDelay(pdMS_TO_TICKS(200));
+}
+
+
+
+//calibration mode like an operator with a tape measure: wind a reference length,
+//enter the true length with the poti and store the result
+static void runCalibration(){
+    const int setPreset3 = 1845; //ladder with SET and PRESET3 pressed
+    sim_adcSetRaw(ADC_CHANNEL_4SW_TO_ANALOG, setPreset3);
+    vTaskDelay(pdMS_TO_TICKS(CALIBRATION_ENTER_MS + 300));
+    sim_adcSetRaw(ADC_CHANNEL_4SW_TO_ANALOG, 4095);
+    if (!waitForState(systemState_t::CALIBRATION, 1000)) {
+        ESP_LOGE("sim", "calibration mode not entered, control state is %s", systemStateStr[(int)controlState]);
+        return;
+    }
+    vTaskDelay(pdMS_TO_TICKS(500)); //guide moved to zero
+    double startMm = machineState.cableMm;
+    float stepsPerMeterOld = param_getFloat(PARAM_ENC_STEPS_PER_M);
+    //wind reference length
+    sim_gpioSetInput(GPIO_NUM_26, 0);
+    vTaskDelay(pdMS_TO_TICKS(20000));
+    sim_gpioSetInput(GPIO_NUM_26, 1);
+    vTaskDelay(pdMS_TO_TICKS(3000)); //reel stopped
+    double trueMm = machineState.cableMm - startMm;
+    double measuredMm = encoder_getSteps() * 1000.0 / stepsPerMeterOld;
+    //enter true length: poti covers measured length +-CALIBRATION_RANGE_PERCENT
+    double deviation = (trueMm / measuredMm - 1) * 100 / CALIBRATION_RANGE_PERCENT;
+    sim_adcSetRaw(ADC_CHANNEL_POTI, (int)lround((deviation + 1) / 2 * 4095));
+    pressLadderSwitch(0, 500); //SET
+    sim_adcSetRaw(ADC_CHANNEL_POTI, 0);
+    pressLadderSwitch(1, 300); //PRESET1: store
+    if (!waitForState(systemState_t::COUNTING, 1000)) {
+        ESP_LOGE("sim", "calibration not stored, control state is %s", systemStateStr[(int)controlState]);
+    }
+    printf("calibration: true %.1fmm, measured %.1fmm -> %.1f steps/m (was %.1f)\n",
+            trueMm, measuredMm, param_getFloat(PARAM_ENC_STEPS_PER_M), stepsPerMeterOld);
+    //CUT: reference piece is not part of the statistics
+    sim_gpioSetInput(GPIO_NUM_33, 0);
+    vTaskDelay(pdMS_TO_TICKS(300));
+    sim_gpioSetInput(GPIO_NUM_33, 1);
+    waitForCutterIdle(JOB_TIMEOUT_MS);
+    //RESET: start pieces at length 0
+    sim_gpioSetInput(GPIO_NUM_25, 0);
+    vTaskDelay(pdMS_TO_TICKS(300));
+    sim_gpioSetInput(GPIO_NUM_25, 1);
+    vTaskDelay(pdMS_TO_TICKS(1000));
+}
+
+//record finished piece
+static void pieceDone(int piece, uint32_t cycleMs){
+    jobNow.cycleMs = cycleMs;
+    results.push_back(jobNow);
+    if (printCsv) {
+        printf("%d,%d,%.1f,%d,%u\n", piece, jobNow.targetMm, jobNow.trueMm, jobNow.measuredMm, jobNow.cycleMs);
+    }
+}
+
+//press START for each piece, auto-cut switch enabled
+static void runSinglePieces(){
+    //enable auto cut (toggle switch to GND)
+    sim_gpioSetInput(GPIO_NUM_32, 0);
+    vTaskDelay(pdMS_TO_TICKS(100));
+
+    for (int job = 0; job < jobCount; job++) {
+        jobNow = {};
+        jobNow.targetMm = presetLengthMm[preset];
+        uint32_t start = esp_log_timestamp();
+        sim_gpioSetInput(GPIO_NUM_26, 0); //press START
+        if (!waitForState(systemState_t::CUTTING, JOB_TIMEOUT_MS)
+                || !waitForState(systemState_t::COUNTING, JOB_TIMEOUT_MS)) {
+            if (stoppedAfterFault()) break;
+            ESP_LOGE("sim", "job %d: timeout, control state is %s", job, systemStateStr[(int)controlState]);
+            break;
+        }
+        pieceDone(job, esp_log_timestamp() - start);
+        sim_gpioSetInput(GPIO_NUM_26, 1); //release START
+        vTaskDelay(pdMS_TO_TICKS(100));
+    }
+}
+
+//program all pieces as one job and keep START on, auto-cut switch stays off
+static void runProductionJob(){
+    control_addJob(presetLengthMm[preset], jobCount);
+    uint32_t start = esp_log_timestamp();
+    sim_gpioSetInput(GPIO_NUM_26, 0); //press START
+    for (int piece = 0; piece < jobCount; piece++) {
+        jobNow = {};
+        jobNow.targetMm = presetLengthMm[preset];
+        if (!waitForState(systemState_t::CUTTING, JOB_TIMEOUT_MS)
+                || !waitForStateLeft(systemState_t::CUTTING, JOB_TIMEOUT_MS)) {
+            if (stoppedAfterFault()) break;
+            ESP_LOGE("sim", "piece %d: timeout, control state is %s", piece, systemStateStr[(int)controlState]);
+            break;
+        }
+        //cycle: previous cut finished until this cut finished
+        pieceDone(piece, esp_log_timestamp() - start);
+        start = esp_log_timestamp();
+    }
+    if (!stoppedAfterFault() && (control_getActiveJob() >= 0 || controlState != systemState_t::COUNTING)) {
+        ESP_LOGE("sim", "job not finished, control state is %s", systemStateStr[(int)controlState]);
+    }
+    sim_gpioSetInput(GPIO_NUM_26, 1); //release START
+    vTaskDelay(pdMS_TO_TICKS(100));
+}
+
+
+
+//=======================
+//=== operator task =====
+//=======================
+//presses buttons like an operator winding pieces
+static void task_operator(void *pvParameter){
+    vTaskDelay(pdMS_TO_TICKS(SETTLE_MS));
+    for (const char *command : consoleCommands) {
+        sim_uartInput(CONSOLE_UART, command);
+        sim_uartInput(CONSOLE_UART, "\n");
+        vTaskDelay(pdMS_TO_TICKS(100));
+    }
+    if (calibrateFirst) {
+        runCalibration();
+    }
+    guideBlockedAtStart = machineState.guideStepsBlocked;
+    if (preset > 0) {
+        pressLadderSwitch(preset, 300);
+    }
+    if (productionJob) {
+        runProductionJob();
+    } else {
+        runSinglePieces();
+    }
+    //cutter may still return to idle position after the last cut (pipelined cut cycle)
+    waitForCutterIdle(JOB_TIMEOUT_MS);
+    if (dumpTelemetry) {
+        sim_uartInput(CONSOLE_UART, "telemetry\n");
+        vTaskDelay(pdMS_TO_TICKS(100));
+    }
+    sim_requestStop();
+    vTaskDelete(NULL);
+}
+
+
+//sample encoder speed estimate and compare with machine model
+static void task_speedProbe(void *pvParameter){
+    while (1) {
+        vTaskDelay(1);
+        if (machineState.cableEnded) continue; //reel turns without cable
+        double error = encoder_getSpeed() - machineState.reelSpeedMmPerS * (1 + machineConfig.encoderScaleError);
+        speedErrorSquareSum += error * error;
+        speedErrorMax = fmax(speedErrorMax, fabs(error));
+        speedSamples++;
+    }
+}
+
+
+//drop supply voltage at brown-out time and stop when the hold-up capacitor is empty
+static void task_brownOut(void *pvParameter){
+    vTaskDelay(pdMS_TO_TICKS(brownOutMs));
+    brownOutUs = sim_nowUs();
+    sim_adcSetRaw(ADC_CHANNEL_SUPPLY_VOLTAGE, BROWN_OUT_ADC);
+    vTaskDelay(pdMS_TO_TICKS(HOLD_UP_MS));
+    sim_requestStop();
+    vTaskDelete(NULL);
+}
+
+
+static void task_main(void *pvParameter){
+    app_main();
+}
+
+
+
+//=====================
+//==== statistics =====
+//=====================
+typedef struct { double mean, sd, min, max; } stat_t;
+
+template <typename F>
+static stat_t calcStat(F value){
+    stat_t s = {0, 0, INFINITY, -INFINITY};
+    if (results.empty()) return {0, 0, 0, 0};
+    for (auto &r : results) {
+        double v = value(r);
+        s.mean += v;
+        s.min = fmin(s.min, v);
+        s.max = fmax(s.max, v);
+    }
+    s.mean /= results.size();
+    for (auto &r : results) s.sd += pow(value(r) - s.mean, 2);
+    s.sd = sqrt(s.sd / results.size());
+    return s;
+}
+
+static void printStat(const char * name, stat_t s){
+    printf("%-34s mean=%9.2f  sd=%8.2f  min=%9.2f  max=%9.2f\n", name, s.mean, s.sd, s.min, s.max);
+}
+
+static void printSummary(double wallS){
+    double simS = sim_nowUs() / 1e6;
+    printf("\n===== host-sim summary =====\n");
+    printf("jobs finished: %zu/%d   virtual time: %.1f s   wall time: %.2f s   (%.1f jobs/s, %.0fx realtime)\n",
+            results.size(), jobCount, simS, wallS, results.size() / wallS, simS / wallS);
+    printStat("cycle time [ms]", calcStat([](jobResult_t &r){ return (double)r.cycleMs; }));
+    printStat("true length - target [mm]", calcStat([](jobResult_t &r){ return r.trueMm - r.targetMm; }));
+    printStat("measured - true length [mm]", calcStat([](jobResult_t &r){ return r.measuredMm - r.trueMm; }));
+    telemetryRecord_t last;
+    if (telemetry_getLatest(&last)) {
+        const uint32_t *ms = last.stateMs;
+        printf("last cut cycle [ms]: idle %u  winding %u  stopping %u  countdown %u  cut %u  cutter return (overlapped) %u\n",
+                ms[(int)systemState_t::COUNTING], ms[(int)systemState_t::WINDING_START] + ms[(int)systemState_t::WINDING],
+                ms[(int)systemState_t::TARGET_REACHED], ms[(int)systemState_t::AUTO_CUT_WAITING],
+                ms[(int)systemState_t::CUTTING], last.cutterReturnMs);
+    }
+    printf("encoder speed estimate: rms error %.1f mm/s, max %.1f mm/s (%llu samples)\n",
+            speedSamples ? sqrt(speedErrorSquareSum / speedSamples) : 0, speedErrorMax, (unsigned long long)speedSamples);
+    printf("guide: %llu steps, %u stops while winding, %llu blocked at hardware limit after homing\n",
+            (unsigned long long)machineState.guideSteps, machineState.guideStopsWinding,
+            (unsigned long long)(machineState.guideStepsBlocked - guideBlockedAtStart));
+    printf("isr: timer %.0f/s  gpio %.0f/s  pcnt %.0f/s  rmt %.0f/s  busy-wait in isr %.2f%% cpu\n",
+            simStats.timerIsrCount / simS, simStats.gpioIsrCount / simS, simStats.pcntIsrCount / simS,
+            simStats.rmtIsrCount / simS,
+            simStats.isrBusyWaitUs / (simS * 1e4));
+    printf("per second: task switches %.0f  spi transactions %.0f (%.0f bit)  adc conversions %.0f (+%.0f dma)  nvs commits %.2f\n",
+            simStats.taskSwitches / simS, simStats.spiTransactions / simS, simStats.spiBits / simS,
+            simStats.adcConversions / simS, simStats.adcDmaSamples / simS, simStats.nvsCommits / simS);
+    printf("flash: %llu writes, %llu sectors erased, %llu accesses while vfd on (longest %.1f ms)\n",
+            (unsigned long long)simStats.flashWrites, (unsigned long long)simStats.flashErases,
+            (unsigned long long)simStats.flashVfdOn, simStats.flashVfdOnMaxUs / 1000.0);
+    if (simModbusStats.requests) {
+        printf("vfd modbus: %.1f requests/s, %llu responses, %llu dropped, %llu crc errors, %llu exceptions, bus load %.1f%%\n",
+                simModbusStats.requests / simS, (unsigned long long)simModbusStats.responses,
+                (unsigned long long)simModbusStats.dropped, (unsigned long long)simModbusStats.crcErrors,
+                (unsigned long long)simModbusStats.exceptions, simModbusStats.busyUs / (simS * 1e4));
+    }
+    if (machineState.faultUs) {
+        const char *fault = machineState.stalled ? "cable jammed" : "supply spool empty";
+        if (machineState.faultStopUs) {
+            printf("%s at %.0fmm: vfd turned off after %.0f ms\n", fault, machineState.cableMm,
+                    (machineState.faultStopUs - machineState.faultUs) / 1e3);
+        } else {
+            printf("%s at %.0fmm: vfd NOT turned off\n", fault, machineState.cableMm);
+        }
+    }
+    if (brownOutUs) {
+        uint64_t lastWriteUs = sim_flashLastWriteUs();
+        if (lastWriteUs >= brownOutUs) {
+            printf("brown-out at %.3f s: state stored %.2f ms after supply dropped (hold-up %d ms)\n",
+                    brownOutUs / 1e6, (lastWriteUs - brownOutUs) / 1e3, HOLD_UP_MS);
+        } else {
+            printf("brown-out at %.3f s: state NOT stored within hold-up time %d ms\n", brownOutUs / 1e6, HOLD_UP_MS);
+        }
+    }
+}
+
+
+
+//=====================
+//======= main ========
+//=====================
+int main(int argc, char **argv){
+    int verbosity = 0;
+    int opt;
+    while ((opt = getopt(argc, argv, "n:p:je:l:b:f:ctks:m:o:x:v")) != -1) {
+        switch (opt) {
+            case 'n': jobCount = atoi(optarg); break;
+            case 'p': preset = atoi(optarg) & 3; break;
+            case 'j': productionJob = true; break;
+            case 'e': machineConfig.encoderScaleError = atof(optarg); break;
+            case 'l': machineConfig.encoderSlipPerMps = atof(optarg); break;
+            case 'b': brownOutMs = atoi(optarg); break;
+            case 'f': sim_flashLoad(optarg); break;
+            case 'c': printCsv = true; break;
+            case 't': dumpTelemetry = true; break;
+            case 'k': calibrateFirst = true; break;
+            case 's': consoleCommands.push_back(optarg); break;
+            case 'm': modbusLossRate = atof(optarg); break;
+            case 'o': machineConfig.cableEndMm = atof(optarg) * 1000; break;
+            case 'x': machineConfig.jamAtMm = atof(optarg) * 1000; break;
+            case 'v': verbosity++; break;
+            default:
+                fprintf(stderr, "usage: %s [-n jobs] [-p preset 0-3] [-j] [-e encoderScaleError] [-l slipPerMps] [-b brownOutMs] [-f flashFile] [-c] [-t] [-k] [-s command] [-m modbusLossRate] [-o cableEndM] [-x jamAtM] [-v[v[v]]]\n", argv[0]);
+                return 1;
+        }
+    }
+    sim_setLogLevelMax((esp_log_level_t)(ESP_LOG_ERROR + (verbosity > 3 ? 3 : verbosity)));
+    if (printCsv) printf("job,target_mm,true_mm,measured_mm,cycle_ms\n");
+
+    //--- idle input state ---
+    sim_adcSetRaw(ADC_CHANNEL_SUPPLY_VOLTAGE, 4095);
+    sim_adcSetRaw(ADC_CHANNEL_4SW_TO_ANALOG, 4095);
+    sim_adcSetRaw(ADC_CHANNEL_POTI, 0);
+    machine_onCut = onCut;
+    sim_modbusInit(VFD_MODBUS_UART, modbusLossRate);
+
+    //--- run firmware ---
+    xTaskCreate(task_main, "main", 3584, NULL, 1, NULL);
+    xTaskCreate(task_operator, "operator", 2048, NULL, 1, NULL);
+    xTaskCreate(task_speedProbe, "speedProbe", 2048, NULL, 1, NULL);
+    if (brownOutMs) xTaskCreate(task_brownOut, "brownOut", 2048, NULL, 1, NULL);
+    auto wallStart = std::chrono::steady_clock::now();
+    sim_run((uint64_t)(SETTLE_MS + (uint64_t)jobCount * JOB_TIMEOUT_MS) * 1000);
+    double wallS = std::chrono::duration<double>(std::chrono::steady_clock::now() - wallStart).count();
+
+    printSummary(wallS);
+    sim_flashSave();
+    fflush(stdout);
+    //tasks are still blocked in their coroutines -> skip destructors
+    //jobs are not finished after a brown-out
+    _exit((brownOutMs || results.size() == (size_t)jobCount) ? 0 : 1);
+}
@@ -0,0 +1,168 @@
+#pragma once
+//internal interface between the host simulation parts:
+//- sim_rtos.cpp:    virtual clock, coroutine scheduler, FreeRTOS/timer/log stubs
+//- sim_periph.cpp:  gpio, adc (single and continuous), spi, uart and nvs stubs
+//- sim_machine.cpp: virtual reel, vfd, cable guide and cutter
+//- main.cpp:        operator task, job statistics and command line
+
+#include <cstdint>
+extern "C" {
+#include "esp_log.h"
+#include "driver/gpio.h"
+#include "driver/adc.h"
+#include "driver/uart.h"
+}
+
+#define SIM_TIME_NEVER UINT64_MAX
+
+
+
+//======================================
+//========= clock and scheduler ========
+//======================================
+//current virtual time in microseconds
+uint64_t sim_nowUs();
+
+//true while an isr (timer alarm, gpio edge) is executed
+bool sim_inIsr();
+
+//cap log output of all tags to this level (firmware sets its own levels in app_main)
+void sim_setLogLevelMax(esp_log_level_t level);
+
+//run tasks, timer alarms and machine events until virtual time reached or stop requested
+void sim_run(uint64_t untilUs);
+
+//make sim_run return after the current task slice
+void sim_requestStop();
+
+//run an isr handler with isr bookkeeping (flag, statistics)
+void sim_runIsr(void (*handler)(void *), void *arg);
+
+//current task spends time in a blocking driver call (e.g. flash write), other tasks continue
+void sim_blockUs(uint64_t us);
+
+
+
+//======================================
+//============ peripherals =============
+//======================================
+//set level of an input pin, runs the installed gpio isr handler on edges
+void sim_gpioSetInput(gpio_num_t gpio_num, int level);
+
+//level currently driven on an output pin
+int sim_gpioGetOutput(gpio_num_t gpio_num);
+
+//raw value returned by adc1_get_raw() for a channel
+void sim_adcSetRaw(adc1_channel_t channel, int raw);
+
+//output of a ledc pwm channel on a pin as fraction of full duty (0-1), -1 when no channel is configured
+double sim_ledcGetDuty(gpio_num_t gpio_num);
+
+//characters received by a uart with installed driver (e.g. console commands)
+void sim_uartInput(uart_port_t uart_num, const char *text);
+void sim_uartReceive(uart_port_t uart_num, const uint8_t *data, size_t length);
+
+//device connected to a uart: gets the written bytes and the time their transmission ends
+typedef void (*simUartTxHandler_t)(const uint8_t *data, size_t length, uint64_t txDoneUs);
+void sim_uartSetTxHandler(uart_port_t uart_num, simUartTxHandler_t handler);
+//transmission time of one byte at the configured baud rate
+uint64_t sim_uartByteUs(uart_port_t uart_num);
+
+//keep content of the raw flash partitions in a file (loaded now, saved by sim_flashSave)
+//allows simulating power loss and restart with two runs
+void sim_flashLoad(const char *path);
+void sim_flashSave();
+
+//virtual time the last esp_partition_write() finished
+uint64_t sim_flashLastWriteUs();
+
+//counters for profiling the firmware
+typedef struct {
+    uint64_t taskSwitches;
+    uint64_t timerIsrCount;
+    uint64_t gpioIsrCount;
+    uint64_t pcntIsrCount;
+    uint64_t rmtIsrCount;     //tx end interrupts of the rmt driver
+    uint64_t isrBusyWaitUs;   //time spent in ets_delay_us() from isr context
+    uint64_t taskBusyWaitUs;  //time spent in ets_delay_us() from task context
+    uint64_t spiTransactions;
+    uint64_t spiBits;
+    uint64_t adcConversions;  //blocking reads (adc1_get_raw)
+    uint64_t adcDmaSamples;   //samples of continuous mode
+    uint64_t nvsCommits;
+    uint64_t flashWrites;     //esp_partition_write calls
+    uint64_t flashErases;     //erased sectors
+    uint64_t flashVfdOn;      //writes, erases and nvs commits while the vfd runs (cache disabled, isrs in flash held off)
+    uint64_t flashVfdOnMaxUs; //longest of them
+} simStats_t;
+extern simStats_t simStats;
+
+
+
+//======================================
+//============ modbus slave ============
+//======================================
+//vfd on a uart (sim_modbus.cpp), a fraction of the responses is dropped (0-1)
+void sim_modbusInit(uart_port_t uart_num, double responseLossRate);
+
+typedef struct {
+    uint64_t requests;
+    uint64_t responses;   //received by the firmware
+    uint64_t crcErrors;
+    uint64_t exceptions;
+    uint64_t dropped;
+    uint64_t busyUs;      //transmission time of requests and responses
+} simModbusStats_t;
+extern simModbusStats_t simModbusStats;
+
+
+
+//======================================
+//=============== machine ==============
+//======================================
+typedef struct {
+    float reelSpeedMmPerS[4];   //cable speed at vfd speed level 0-3
+    float analogMaxSpeedMmPerS; //cable speed at full analog / modbus reference (VFD_MAX_FREQUENCY_HZ)
+    float accelTauMs;           //time constant reel speeding up
+    float coastTauMs;           //time constant reel coasting down after vfd off
+    float encoderScaleError;    //relative error of encoder roller (0.01 = measures 1% too much)
+    float encoderSlipPerMps;    //roller slip per cable speed (0.005 = measures 0.5% too little at 1m/s)
+    float cutterCycleMs;        //duration of one full cutter revolution
+    float guideStartPosMm;      //physical position of guide at power on
+    double cableEndMm;          //supply spool empty: cable end passes the encoder here, reel turns freely (0 = never)
+    double jamAtMm;             //cable jams here: reel blocked, motor stalls (0 = never)
+} machineConfig_t;
+extern machineConfig_t machineConfig;
+
+typedef struct {
+    double cableMm;             //true cable length passed the encoder since power on
+    double cableAtLastCutMm;    //true cable length at last cut
+    double reelSpeedMmPerS;
+    uint32_t cutCount;
+    int32_t guidePosSteps;      //physical guide position
+    uint64_t guideStepsBlocked; //steps driven against a hardware limit
+    uint64_t guideSteps;
+    uint32_t guideStopsWinding; //guide stood still >GUIDE_STOP_GAP_MS while reel ran at winding speed
+    bool vfdOn;
+    //vfd as seen over modbus (sim_modbus.cpp)
+    double vfdReferenceHz;      //frequency reference written over modbus, -1 = not used (digital / analog)
+    double vfdOutputHz;
+    double motorCurrentA;
+    //simulated faults (cableEndMm, jamAtMm)
+    bool cableEnded;
+    bool stalled;
+    uint64_t faultUs;           //time the fault occurred
+    uint64_t faultStopUs;       //time the vfd was turned off afterwards
+} machineState_t;
+extern machineState_t machineState;
+
+//next time the machine model needs to be updated
+uint64_t machine_nextEventUs();
+//advance machine model to given time (emits encoder edges, updates switches)
+void machine_process(uint64_t nowUs);
+//evaluate step pulse written to GPIO.out_w1ts by stepper isr
+void machine_checkStepPulse();
+//pulse generated by hardware (rmt) on an output pin
+void machine_outputPulse(gpio_num_t gpio_num);
+//called when the cutter blade passes the cable
+extern void (*machine_onCut)(double pieceMm);
@@ -0,0 +1,255 @@
+//virtual machine model for the host simulation
+//- reel: driven by vfd outputs (FWD/REV, D0/D1 speed level, analog or modbus reference), first order speed
+//  response, coasts after stop. Motor current and output frequency as reported by the vfd over modbus.
+//- faults: empty supply spool (cable stops, reel turns freely), jammed cable (reel blocked, motor stalls)
+//- encoder: quadrature edges generated from the cable length, fed into the encoder isr
+//- cable guide: counts step pulses of the stepper isr, clamps at the hardware limits
+//- cutter: driven by relay output, operates the cutter position switch, cuts the cable half way
+#include <cmath>
+
+extern "C" {
+#include "driver/gpio.h"
+}
+#include "config.h"
+#include "sim.hpp"
+
+//physics update interval while anything is moving
+#define MACHINE_TICK_US 100
+//gap between guide steps counted as stop while the reel runs faster than GUIDE_STOP_MIN_REEL_SPEED
+//(guide speed is then above STEPPER_SPEED_MIN, thus continuous movement is possible)
+#define GUIDE_STOP_GAP_MS 20
+#define GUIDE_STOP_MIN_REEL_SPEED 500
+
+
+//=====================
+//===== variables =====
+//=====================
+machineConfig_t machineConfig = {
+    .reelSpeedMmPerS = {60, 250, 700, 1400},
+    .analogMaxSpeedMmPerS = 1400,
+    .accelTauMs = 400,
+    .coastTauMs = 180,
+    .encoderScaleError = 0,
+    .encoderSlipPerMps = 0,
+    .cutterCycleMs = 900,
+    .guideStartPosMm = 50,
+    .cableEndMm = 0,
+    .jamAtMm = 0,
+};
+machineState_t machineState = {.vfdReferenceHz = -1};
+void (*machine_onCut)(double pieceMm) = nullptr;
+
+static bool initialized = false;
+static uint64_t physicsUs = 0;       //time the model was last integrated to
+static uint64_t nextTickUs = 0;
+static double encoderQuarterSteps = 0; //quadrature position (4 edges per counted step)
+static int64_t encoderPhase = 0;       //last emitted quadrature position
+static double cutterAngle = 0;         //0..1 revolution, 0 = idle position
+static uint64_t guideLastStepUs = 0;
+
+
+//---------------------------
+//----- local functions -----
+//---------------------------
+//quarter steps per mm cable actually measured by the encoder (roller slips more at high speed)
+static double quarterStepsPerMm(){
+    double slip = machineConfig.encoderSlipPerMps * fabs(machineState.reelSpeedMmPerS) / 1000;
+    return 4.0 * ENCODER_STEPS_PER_METER / 1000 * (1 + machineConfig.encoderScaleError - slip);
+}
+
+//cable speed at the encoder, the reel turns without cable after the cable end passed
+static double cableSpeed(){
+    return machineState.cableEnded ? 0 : machineState.reelSpeedMmPerS;
+}
+
+static void init(){
+    initialized = true;
+    machineState.guidePosSteps = machineConfig.guideStartPosMm * STEPPER_STEPS_PER_MM;
+    physicsUs = sim_nowUs();
+    nextTickUs = physicsUs;
+}
+
+//apply quadrature state of position to encoder pins
+//note: encoder.cpp flips direction (FLIP_DIRECTION is checked with #ifdef), thus the
+//decoders pin A is ROT_ENC_B_GPIO. Winding forward has to count up.
+static void writeEncoderPins(int64_t position){
+    //clockwise gray sequence as BA: 11 01 00 10
+    static const uint8_t sequence[4] = {0b11, 0b01, 0b00, 0b10};
+    uint8_t ba = sequence[((position % 4) + 4) % 4];
+    sim_gpioSetInput(ROT_ENC_B_GPIO, ba & 1);
+    sim_gpioSetInput(ROT_ENC_A_GPIO, (ba >> 1) & 1);
+}
+
+//true while anything in the machine moves or is powered
+static bool isActive(){
+    return machineState.reelSpeedMmPerS != 0
+        || sim_gpioGetOutput(GPIO_VFD_FWD) || sim_gpioGetOutput(GPIO_VFD_REV)
+        || sim_gpioGetOutput(GPIO_RELAY);
+}
+
+//reel speed the vfd is currently commanding
+static double vfdTargetSpeed(){
+    int level = sim_gpioGetOutput(GPIO_VFD_D0) | (sim_gpioGetOutput(GPIO_VFD_D1) << 1);
+    double speed = machineConfig.reelSpeedMmPerS[level];
+    //analog frequency reference (VFD_ANALOG_SPEED): pwm on D0 instead of preset selection
+    double duty = sim_ledcGetDuty(GPIO_VFD_D0);
+    if (duty >= 0) speed = duty * machineConfig.analogMaxSpeedMmPerS;
+    //modbus frequency reference (VFD_MODBUS)
+    if (machineState.vfdReferenceHz >= 0) speed = machineState.vfdReferenceHz / VFD_MAX_FREQUENCY_HZ * machineConfig.analogMaxSpeedMmPerS;
+    bool fwd = sim_gpioGetOutput(GPIO_VFD_FWD);
+    bool rev = sim_gpioGetOutput(GPIO_VFD_REV);
+    machineState.vfdOn = fwd != rev;
+    if (fwd && !rev) return speed;
+    if (rev && !fwd) return -speed;
+    return 0;
+}
+
+
+//--- physics tick ---
+static void updateDynamics(double dtMs){
+    //reel speed: first order response, coasting with separate time constant
+    double target = vfdTargetSpeed();
+    double tau = machineState.vfdOn ? machineConfig.accelTauMs : machineConfig.coastTauMs;
+    double &speed = machineState.reelSpeedMmPerS;
+    speed += (target - speed) * (1 - exp(-dtMs / tau));
+    if (target == 0 && fabs(speed) < 1) speed = 0; //stopped by friction
+
+    //--- faults ---
+    if (!machineState.stalled && machineConfig.jamAtMm > 0 && machineState.cableMm >= machineConfig.jamAtMm) {
+        machineState.stalled = true;
+        machineState.faultUs = sim_nowUs();
+    }
+    if (!machineState.cableEnded && machineConfig.cableEndMm > 0 && machineState.cableMm >= machineConfig.cableEndMm) {
+        machineState.cableEnded = true;
+        machineState.faultUs = sim_nowUs();
+    }
+    if (machineState.stalled) speed = 0;
+
+    //--- vfd feedback ---
+    //output frequency follows the reel, current limit while stalled, only reel friction without cable
+    double hzPerSpeed = VFD_MAX_FREQUENCY_HZ / machineConfig.analogMaxSpeedMmPerS;
+    double load = fabs(speed) / machineConfig.analogMaxSpeedMmPerS;
+    if (!machineState.vfdOn) {
+        machineState.vfdOutputHz = 0;
+        machineState.motorCurrentA = 0;
+    } else if (machineState.stalled) {
+        machineState.vfdOutputHz = fabs(target) * hzPerSpeed;
+        machineState.motorCurrentA = 3.2;
+    } else {
+        machineState.vfdOutputHz = fabs(speed) * hzPerSpeed;
+        machineState.motorCurrentA = machineState.cableEnded ? 0.35 + 0.1 * load : 0.75 + 0.45 * load;
+    }
+
+    //cutter: motor runs while relay is on
+    if (sim_gpioGetOutput(GPIO_RELAY)) {
+        double angleOld = cutterAngle;
+        cutterAngle += dtMs / machineConfig.cutterCycleMs;
+        if (angleOld < 0.5 && cutterAngle >= 0.5) {
+            double piece = machineState.cableMm - machineState.cableAtLastCutMm;
+            machineState.cableAtLastCutMm = machineState.cableMm;
+            machineState.cutCount++;
+            if (machine_onCut) machine_onCut(piece);
+        }
+        if (cutterAngle >= 1) cutterAngle -= 1;
+    }
+    //position switch to GND is closed (low) while blade is away from idle position
+    bool atIdlePos = cutterAngle < 0.08 || cutterAngle > 0.92;
+    sim_gpioSetInput(GPIO_NUM_14, atIdlePos ? 1 : 0);
+}
+
+
+
+//==================================
+//===== machine_nextEventUs ========
+//==================================
+uint64_t machine_nextEventUs(){
+    if (!initialized) init();
+    if (!isActive()) {
+        return SIM_TIME_NEVER;
+    }
+    uint64_t now = sim_nowUs();
+    if (nextTickUs < now) nextTickUs = now; //was idle -> restart ticks now
+    uint64_t next = nextTickUs;
+    //time of next encoder edge at current speed
+    double speed = cableSpeed() * quarterStepsPerMm() / 1e6; //quarter steps per us
+    if (speed != 0) {
+        double boundary = speed > 0 ? floor(encoderQuarterSteps) + 1 : ceil(encoderQuarterSteps) - 1;
+        double dtUs = (boundary - encoderQuarterSteps) / speed;
+        uint64_t edgeUs = physicsUs + (uint64_t)ceil(dtUs);
+        if (edgeUs < next) next = edgeUs;
+    }
+    return next;
+}
+
+
+
+//==============================
+//===== machine_process ========
+//==============================
+void machine_process(uint64_t nowUs){
+    if (!initialized) init();
+    if (nowUs < physicsUs) return;
+    //reaction of the firmware to a simulated fault (machine is idle afterwards when stalled)
+    if (machineState.faultUs && !machineState.faultStopUs
+            && !sim_gpioGetOutput(GPIO_VFD_FWD) && !sim_gpioGetOutput(GPIO_VFD_REV)) {
+        machineState.faultStopUs = nowUs;
+    }
+    if (!isActive() && machineState.reelSpeedMmPerS == 0) {
+        physicsUs = nowUs;
+        return;
+    }
+    //--- integrate cable position, emit encoder edges ---
+    double dtUs = nowUs - physicsUs;
+    double deltaMm = cableSpeed() * dtUs / 1e6;
+    machineState.cableMm += deltaMm;
+    encoderQuarterSteps += deltaMm * quarterStepsPerMm();
+    int64_t target = (int64_t)floor(encoderQuarterSteps + 1e-9);
+    while (encoderPhase != target) {
+        encoderPhase += encoderPhase < target ? 1 : -1;
+        writeEncoderPins(encoderPhase);
+    }
+    physicsUs = nowUs;
+
+    //--- physics tick ---
+    if (nowUs >= nextTickUs) {
+        updateDynamics(MACHINE_TICK_US / 1000.0);
+        nextTickUs = nowUs + MACHINE_TICK_US;
+    }
+}
+
+
+
+//====================================
+//===== machine_checkStepPulse =======
+//====================================
+void machine_checkStepPulse(){
+    if (GPIO.out_w1ts & (1ULL << STEPPER_STEP_PIN)) {
+        machine_outputPulse(STEPPER_STEP_PIN);
+    }
+}
+
+
+
+//====================================
+//====== machine_outputPulse =========
+//====================================
+void machine_outputPulse(gpio_num_t gpio_num){
+    if (gpio_num != STEPPER_STEP_PIN) {
+        return;
+    }
+    const int32_t maxSteps = MAX_TOTAL_AXIS_TRAVEL_MM * STEPPER_STEPS_PER_MM;
+    uint64_t now = sim_nowUs();
+    if (fabs(machineState.reelSpeedMmPerS) > GUIDE_STOP_MIN_REEL_SPEED
+            && now - guideLastStepUs > GUIDE_STOP_GAP_MS * 1000) {
+        machineState.guideStopsWinding++;
+    }
+    guideLastStepUs = now;
+    int32_t pos = machineState.guidePosSteps + (sim_gpioGetOutput(STEPPER_DIR_PIN) ? 1 : -1);
+    machineState.guideSteps++;
+    //hardware limit: motor stalls
+    if (pos < 0 || pos > maxSteps) {
+        machineState.guideStepsBlocked++;
+        return;
+    }
+    machineState.guidePosSteps = pos;
+}
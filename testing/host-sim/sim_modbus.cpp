@@ -0,0 +1,162 @@
+//modbus rtu slave simulating the vfd (T13, register map see docs/vfd/) on the uart VFD_MODBUS_UART
+//- frequency reference written to register 2 drives the reel of the machine model (VFD_MODBUS)
+//- feedback registers (output frequency, run state, current...) are taken from the machine model
+//- requests are checked like a real slave: wrong crc or slave id -> no response, invalid
+//  function or address -> exception response
+//- the response is received by the firmware after the processing delay and its transmission time
+//- a fraction of the responses can be dropped to test timeouts (-m)
+#include <cstdlib>
+#include <cstring>
+#include <cmath>
+
+extern "C" {
+#include "driver/uart.h"
+#include "esp_timer.h"
+}
+#include "config.h"
+#include "sim.hpp"
+
+//time from end of request to start of response
+#define RESPONSE_DELAY_US 3000
+//registers 0-17 are defined
+#define REGISTER_COUNT 18
+#define REQUEST_LENGTH 8
+
+
+//=====================
+//===== variables =====
+//=====================
+simModbusStats_t simModbusStats = {};
+
+static uart_port_t uart = UART_NUM_MAX;
+static double lossRate = 0;
+static uint8_t request[REQUEST_LENGTH];
+static size_t requestLength = 0;
+static uint8_t response[3 + 2 * REGISTER_COUNT + 2];
+static size_t responseLength = 0;
+static esp_timer_handle_t responseTimer = NULL;
+
+
+//---------------------------
+//----- local functions -----
+//---------------------------
+static uint16_t crc16(const uint8_t *data, size_t length){
+    uint16_t crc = 0xFFFF;
+    for (size_t i = 0; i < length; i++) {
+        crc ^= data[i];
+        for (int bit = 0; bit < 8; bit++) crc = (crc & 1) ? (crc >> 1) ^ 0xA001 : crc >> 1;
+    }
+    return crc;
+}
+
+static void appendCrc(uint8_t *frame, size_t &length){
+    uint16_t crc = crc16(frame, length);
+    frame[length++] = crc & 0xFF;
+    frame[length++] = crc >> 8;
+}
+
+//register value as read by the master
+static uint16_t readRegister(int address){
+    bool fwd = sim_gpioGetOutput(GPIO_VFD_FWD);
+    bool rev = sim_gpioGetOutput(GPIO_VFD_REV);
+    switch (address) {
+        case 0: case 1: return 103; //firmware versions
+        case 2: return (uint16_t)lround(machineState.vfdOutputHz * 10);
+        case 3: return fwd != rev ? (fwd ? 1 : 3) : 2;
+        case 8: return 3100; //bus voltage 310.0V
+        case 9: return (uint16_t)lround(machineState.motorCurrentA * 100);
+        case 10: return 35; //heat sink temperature
+        default: return 0; //spare (fault code register 4: no fault)
+    }
+}
+
+static void exception(uint8_t code){
+    response[1] |= 0x80;
+    response[2] = code;
+    responseLength = 3;
+    simModbusStats.exceptions++;
+}
+
+//build response to the complete request in request[]
+//returns false when the slave does not respond
+static bool handleRequest(){
+    if (crc16(request, REQUEST_LENGTH - 2) != (request[REQUEST_LENGTH - 2] | (request[REQUEST_LENGTH - 1] << 8))) {
+        simModbusStats.crcErrors++;
+        return false;
+    }
+    if (request[0] != VFD_MODBUS_SLAVE_ID) return false;
+    uint16_t address = (request[2] << 8) | request[3];
+    uint16_t value = (request[4] << 8) | request[5]; //count for read
+    response[0] = request[0];
+    response[1] = request[1];
+    switch (request[1]) {
+        case 0x03: //read holding registers
+            if (value == 0 || address + value > REGISTER_COUNT) {
+                exception(0x02); //illegal data address
+                break;
+            }
+            response[2] = 2 * value;
+            responseLength = 3;
+            for (int i = 0; i < value; i++) {
+                uint16_t reg = readRegister(address + i);
+                response[responseLength++] = reg >> 8;
+                response[responseLength++] = reg & 0xFF;
+            }
+            break;
+        case 0x06: //write single register, response is an echo
+            if (address == 2) {
+                machineState.vfdReferenceHz = value / 10.0;
+            } else if (address != 3) { //run command is accepted, the machine runs from the terminals
+                exception(0x02);
+                break;
+            }
+            memcpy(response, request, 6);
+            responseLength = 6;
+            break;
+        default:
+            exception(0x01); //illegal function
+    }
+    appendCrc(response, responseLength);
+    return true;
+}
+
+static void onResponseTime(void *arg){
+    sim_uartReceive(uart, response, responseLength);
+    simModbusStats.responses++;
+}
+
+//bytes written by the firmware
+static void onTransmit(const uint8_t *data, size_t length, uint64_t txDoneUs){
+    simModbusStats.busyUs += length * sim_uartByteUs(uart);
+    for (size_t i = 0; i < length; i++) {
+        request[requestLength++] = data[i];
+        if (requestLength < REQUEST_LENGTH) continue;
+        //--- request complete ---
+        requestLength = 0;
+        simModbusStats.requests++;
+        if (!handleRequest()) continue;
+        if ((double)rand() / RAND_MAX < lossRate) {
+            simModbusStats.dropped++;
+            continue;
+        }
+        uint64_t responseUs = responseLength * sim_uartByteUs(uart);
+        simModbusStats.busyUs += responseUs;
+        esp_timer_stop(responseTimer); //previous response not received yet is lost
+        esp_timer_start_once(responseTimer, txDoneUs + RESPONSE_DELAY_US + responseUs - sim_nowUs());
+    }
+}
+
+
+
+//==========================
+//===== sim_modbusInit =====
+//==========================
+void sim_modbusInit(uart_port_t uart_num, double responseLossRate){
+    uart = uart_num;
+    lossRate = responseLossRate;
+    esp_timer_create_args_t args = {};
+    args.callback = onResponseTime;
+    args.name = "modbusSlave";
+    esp_timer_create(&args, &responseTimer);
+    sim_uartSetTxHandler(uart, onTransmit);
+}
@@ -0,0 +1,813 @@
+//peripheral stubs for the host simulation: gpio, adc, spi, rmt, ledc, pcnt, uart, nvs, flash partitions
+#include <algorithm>
+#include <cstring>
+#include <deque>
+#include <map>
+#include <string>
+#include <vector>
+
+extern "C" {
+#include "driver/gpio.h"
+#include "driver/adc.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "driver/spi_master.h"
+#include "driver/rmt.h"
+#include "hal/rmt_ll.h"
+#include "driver/ledc.h"
+#include "driver/pcnt.h"
+#include "hal/pcnt_ll.h"
+#include "driver/uart.h"
+#include "nvs_flash.h"
+#include "esp_partition.h"
+#include "esp_log.h"
+}
+#include "sim.hpp"
+
+
+//=====================
+//===== variables =====
+//=====================
+simStats_t simStats = {};
+sim_gpio_dev_t GPIO = {};
+
+static int gpioOutputLevel[GPIO_NUM_MAX] = {};
+static int gpioInputLevel[GPIO_NUM_MAX] = {};
+static gpio_pull_mode_t gpioPull[GPIO_NUM_MAX] = {};
+static gpio_isr_t gpioIsrHandler[GPIO_NUM_MAX] = {};
+static void * gpioIsrArg[GPIO_NUM_MAX] = {};
+//inputs idle high (pullups, encoder rest position 11)
+static struct gpioInputInit {
+    gpioInputInit() { for (int &level : gpioInputLevel) level = 1; }
+} gpioInputInitInstance;
+
+static int adcRaw[ADC1_CHANNEL_MAX] = {};
+//continuous mode: conversion pattern and time of the last sample handed out
+static std::vector<uint8_t> adcPattern;
+static uint32_t adcSampleHz = 0;
+static uint32_t adcFrameBytes = 0;
+static bool adcRunning = false;
+static uint64_t adcLastSampleUs = 0;
+static size_t adcPatternIndex = 0;
+
+static gpio_num_t rmtGpio[RMT_CHANNEL_MAX] = {};
+
+struct simPcntUnit {
+    pcnt_config_t channel[PCNT_CHANNEL_MAX];
+    bool channelConfigured[PCNT_CHANNEL_MAX];
+    int16_t count;
+    int16_t hLim, lLim;
+    bool running;
+    uint32_t eventsEnabled;
+    uint32_t status;
+    bool intrPending;
+    void (*handler)(void *);
+    void * arg;
+};
+static simPcntUnit pcntUnit[PCNT_UNIT_MAX] = {};
+//isr registered for all units with pcnt_isr_register (instead of handlers of the isr service)
+static void (*pcntIsr)(void *) = nullptr;
+static void *pcntIsrArg = nullptr;
+
+static void pcntOnEdge(gpio_num_t gpio_num, int level);
+
+//received characters per uart, created by uart_driver_install
+static QueueHandle_t uartRx[UART_NUM_MAX] = {};
+//transmission: duration from baud rate, written bytes are passed to a handler (connected device)
+static int uartBaud[UART_NUM_MAX] = {115200, 115200, 115200};
+static uint64_t uartTxDoneUs[UART_NUM_MAX] = {};
+static simUartTxHandler_t uartTxHandler[UART_NUM_MAX] = {};
+
+static std::map<std::string, std::vector<uint8_t>> nvsData;
+static bool nvsInitialized = false;
+
+//raw partitions of partitions.csv (nvs is emulated separately)
+static esp_partition_t partitionTable[] = {
+    {nullptr, ESP_PARTITION_TYPE_DATA, (esp_partition_subtype_t)0x40, 0x110000, 0x10000, "journal", false},
+};
+static std::vector<uint8_t> partitionData[sizeof(partitionTable) / sizeof(partitionTable[0])];
+static std::string flashPath;
+static uint64_t flashLastWriteUs = 0;
+//timing of the flash chip: page program 50us + 2.5us per byte, sector erase 45ms (typical datasheet values)
+#define FLASH_PROGRAM_US(bytes) (50 + (bytes) * 5 / 2)
+#define FLASH_ERASE_SECTOR_US 45000
+
+
+//===========================
+//========== gpio ===========
+//===========================
+void sim_gpioSetInput(gpio_num_t gpio_num, int level){
+    level = level ? 1 : 0;
+    if (gpioInputLevel[gpio_num] == level) return;
+    gpioInputLevel[gpio_num] = level;
+    pcntOnEdge(gpio_num, level);
+    if (gpioIsrHandler[gpio_num] != nullptr) {
+        simStats.gpioIsrCount++;
+        sim_runIsr(gpioIsrHandler[gpio_num], gpioIsrArg[gpio_num]);
+    }
+}
+
+int sim_gpioGetOutput(gpio_num_t gpio_num){
+    return gpioOutputLevel[gpio_num];
+}
+
+void gpio_pad_select_gpio(uint8_t gpio_num){
+}
+
+esp_err_t gpio_reset_pin(gpio_num_t gpio_num){
+    return ESP_OK;
+}
+
+esp_err_t gpio_set_direction(gpio_num_t gpio_num, gpio_mode_t mode){
+    return ESP_OK;
+}
+
+esp_err_t gpio_set_pull_mode(gpio_num_t gpio_num, gpio_pull_mode_t pull){
+    gpioPull[gpio_num] = pull;
+    return ESP_OK;
+}
+
+esp_err_t gpio_set_intr_type(gpio_num_t gpio_num, gpio_int_type_t intr_type){
+    return ESP_OK;
+}
+
+esp_err_t gpio_intr_enable(gpio_num_t gpio_num){
+    return ESP_OK;
+}
+
+esp_err_t gpio_intr_disable(gpio_num_t gpio_num){
+    return ESP_OK;
+}
+
+esp_err_t gpio_set_level(gpio_num_t gpio_num, uint32_t level){
+    gpioOutputLevel[gpio_num] = level ? 1 : 0;
+    return ESP_OK;
+}
+
+int gpio_get_level(gpio_num_t gpio_num){
+    return gpioInputLevel[gpio_num];
+}
+
+esp_err_t gpio_install_isr_service(int intr_alloc_flags){
+    return ESP_OK;
+}
+
+esp_err_t gpio_isr_handler_add(gpio_num_t gpio_num, gpio_isr_t isr_handler, void *args){
+    gpioIsrHandler[gpio_num] = isr_handler;
+    gpioIsrArg[gpio_num] = args;
+    return ESP_OK;
+}
+
+esp_err_t gpio_isr_handler_remove(gpio_num_t gpio_num){
+    gpioIsrHandler[gpio_num] = nullptr;
+    return ESP_OK;
+}
+
+
+
+//===========================
+//=========== adc ===========
+//===========================
+void sim_adcSetRaw(adc1_channel_t channel, int raw){
+    adcRaw[channel] = raw;
+}
+
+esp_err_t adc1_config_width(adc_bits_width_t width_bit){
+    return ESP_OK;
+}
+
+esp_err_t adc1_config_channel_atten(adc1_channel_t channel, adc_atten_t atten){
+    return ESP_OK;
+}
+
+int adc1_get_raw(adc1_channel_t channel){
+    simStats.adcConversions++;
+    return adcRaw[channel];
+}
+
+//--- continuous mode ---
+//samples are generated from the current raw values when read, no overflow emulation
+esp_err_t adc_digi_initialize(const adc_digi_init_config_t *init_config){
+    adcFrameBytes = init_config->conv_num_each_intr;
+    return ESP_OK;
+}
+
+esp_err_t adc_digi_controller_configure(const adc_digi_configuration_t *config){
+    adcPattern.clear();
+    for (uint32_t i = 0; i < config->pattern_num; i++) {
+        adcPattern.push_back(config->adc_pattern[i].channel);
+    }
+    adcSampleHz = config->sample_freq_hz;
+    return ESP_OK;
+}
+
+esp_err_t adc_digi_start(void){
+    adcRunning = true;
+    adcLastSampleUs = sim_nowUs();
+    return ESP_OK;
+}
+
+esp_err_t adc_digi_stop(void){
+    adcRunning = false;
+    return ESP_OK;
+}
+
+esp_err_t adc_digi_deinitialize(void){
+    return ESP_OK;
+}
+
+//blocks until one frame (conv_num_each_intr bytes) is available like the dma driver
+esp_err_t adc_digi_read_bytes(uint8_t *buf, uint32_t length_max, uint32_t *out_length, uint32_t timeout_ms){
+    if (!adcRunning || adcPattern.empty() || adcSampleHz == 0) return ESP_ERR_INVALID_STATE;
+    uint32_t frameSamples = std::min(adcFrameBytes, length_max) / sizeof(adc_digi_output_data_t);
+    uint64_t framePeriodUs = (uint64_t)frameSamples * 1000000 / adcSampleHz;
+    uint64_t waitedUs = 0;
+    while (sim_nowUs() < adcLastSampleUs + framePeriodUs) {
+        if (waitedUs >= (uint64_t)timeout_ms * 1000) {
+            *out_length = 0;
+            return ESP_ERR_TIMEOUT;
+        }
+        vTaskDelay(1);
+        waitedUs += portTICK_PERIOD_MS * 1000;
+    }
+    adcLastSampleUs += framePeriodUs;
+    adc_digi_output_data_t * samples = (adc_digi_output_data_t *)buf;
+    for (uint32_t i = 0; i < frameSamples; i++) {
+        uint8_t channel = adcPattern[adcPatternIndex];
+        adcPatternIndex = (adcPatternIndex + 1) % adcPattern.size();
+        samples[i].val = 0;
+        samples[i].type1.channel = channel;
+        samples[i].type1.data = adcRaw[channel];
+    }
+    simStats.adcDmaSamples += frameSamples;
+    *out_length = frameSamples * sizeof(adc_digi_output_data_t);
+    return ESP_OK;
+}
+
+
+
+//===========================
+//=========== spi ===========
+//===========================
+//transactions complete immediately, queued ones are kept until their result is fetched
+struct simSpiDevice {
+    std::deque<spi_transaction_t *> pending;
+    int queueSize = 1;
+};
+
+static void spiCount(spi_transaction_t *trans_desc){
+    simStats.spiTransactions++;
+    simStats.spiBits += trans_desc->length;
+}
+
+esp_err_t spi_bus_initialize(spi_host_device_t host_id, const spi_bus_config_t *bus_config, int dma_chan){
+    return ESP_OK;
+}
+
+esp_err_t spi_bus_add_device(spi_host_device_t host_id, const spi_device_interface_config_t *dev_config, spi_device_handle_t *handle){
+    *handle = new simSpiDevice();
+    (*handle)->queueSize = dev_config->queue_size;
+    return ESP_OK;
+}
+
+esp_err_t spi_bus_remove_device(spi_device_handle_t handle){
+    delete handle;
+    return ESP_OK;
+}
+
+esp_err_t spi_device_transmit(spi_device_handle_t handle, spi_transaction_t *trans_desc){
+    //like idf: results of queued transactions have to be fetched first
+    if (!handle->pending.empty()) {
+        ESP_LOGE("sim", "spi_device_transmit with %zu queued transactions", handle->pending.size());
+        return ESP_ERR_INVALID_STATE;
+    }
+    spiCount(trans_desc);
+    return ESP_OK;
+}
+
+esp_err_t spi_device_polling_transmit(spi_device_handle_t handle, spi_transaction_t *trans_desc){
+    return spi_device_transmit(handle, trans_desc);
+}
+
+esp_err_t spi_device_queue_trans(spi_device_handle_t handle, spi_transaction_t *trans_desc, TickType_t ticks_to_wait){
+    if ((int)handle->pending.size() >= handle->queueSize) return ESP_ERR_TIMEOUT;
+    handle->pending.push_back(trans_desc);
+    spiCount(trans_desc);
+    return ESP_OK;
+}
+
+esp_err_t spi_device_get_trans_result(spi_device_handle_t handle, spi_transaction_t **trans_desc, TickType_t ticks_to_wait){
+    if (handle->pending.empty()) return ESP_ERR_TIMEOUT;
+    *trans_desc = handle->pending.front();
+    handle->pending.pop_front();
+    return ESP_OK;
+}
+
+
+
+//===========================
+//=========== rmt ===========
+//===========================
+//transmission is not simulated, every start is one pulse on the channel pin
+static bool rmtTxIntrEnabled[RMT_CHANNEL_MAX] = {};
+
+esp_err_t rmt_config(const rmt_config_t *rmt_param){
+    rmtGpio[rmt_param->channel] = rmt_param->gpio_num;
+    return ESP_OK;
+}
+
+esp_err_t rmt_driver_install(rmt_channel_t channel, size_t rx_buf_size, int intr_alloc_flags){
+    return ESP_OK;
+}
+
+esp_err_t rmt_driver_uninstall(rmt_channel_t channel){
+    return ESP_OK;
+}
+
+esp_err_t rmt_fill_tx_items(rmt_channel_t channel, const rmt_item32_t *item, uint16_t item_num, uint16_t mem_offset){
+    return ESP_OK;
+}
+
+esp_err_t rmt_tx_start(rmt_channel_t channel, bool tx_idx_rst){
+    //the driver enables the tx end interrupt on every start: second isr after the pulse
+    rmtTxIntrEnabled[channel] = true;
+    machine_outputPulse(rmtGpio[channel]);
+    simStats.rmtIsrCount++;
+    return ESP_OK;
+}
+
+esp_err_t rmt_set_tx_intr_en(rmt_channel_t channel, bool en){
+    rmtTxIntrEnabled[channel] = en;
+    return ESP_OK;
+}
+
+//low level register access (hal/rmt_ll.h), leaves the interrupt enable as it is
+struct simRmtDev { int unused; };
+rmt_dev_t RMT = {};
+
+void rmt_ll_tx_reset_pointer(rmt_dev_t *dev, uint32_t channel){
+}
+
+void rmt_ll_tx_start(rmt_dev_t *dev, uint32_t channel){
+    machine_outputPulse(rmtGpio[channel]);
+    if (rmtTxIntrEnabled[channel]) simStats.rmtIsrCount++;
+}
+
+
+
+//===========================
+//=========== ledc ==========
+//===========================
+//pwm is not simulated, the machine model uses the duty of the channel as mean voltage
+typedef struct {
+    gpio_num_t gpio;
+    uint32_t duty;        //set, not yet updated
+    uint32_t dutyActive;  //output since last ledc_update_duty()
+} simLedcChannel_t;
+static std::map<int, simLedcChannel_t> ledcChannels;
+static uint32_t ledcDutyMax[LEDC_TIMER_MAX] = {};
+static ledc_timer_t ledcTimerOfChannel[LEDC_CHANNEL_MAX] = {};
+
+double sim_ledcGetDuty(gpio_num_t gpio_num){
+    for (auto &entry : ledcChannels) {
+        if (entry.second.gpio != gpio_num) continue;
+        uint32_t dutyMax = ledcDutyMax[ledcTimerOfChannel[entry.first]];
+        return dutyMax ? (double)entry.second.dutyActive / dutyMax : 0;
+    }
+    return -1;
+}
+
+esp_err_t ledc_timer_config(const ledc_timer_config_t *timer_conf){
+    ledcDutyMax[timer_conf->timer_num] = (1u << timer_conf->duty_resolution) - 1;
+    return ESP_OK;
+}
+
+esp_err_t ledc_channel_config(const ledc_channel_config_t *ledc_conf){
+    ledcTimerOfChannel[ledc_conf->channel] = ledc_conf->timer_sel;
+    ledcChannels[ledc_conf->channel] = {(gpio_num_t)ledc_conf->gpio_num, ledc_conf->duty, ledc_conf->duty};
+    return ESP_OK;
+}
+
+esp_err_t ledc_set_duty(ledc_mode_t speed_mode, ledc_channel_t channel, uint32_t duty){
+    if (ledcChannels.count(channel) == 0) return ESP_ERR_INVALID_STATE;
+    ledcChannels[channel].duty = duty;
+    return ESP_OK;
+}
+
+esp_err_t ledc_update_duty(ledc_mode_t speed_mode, ledc_channel_t channel){
+    if (ledcChannels.count(channel) == 0) return ESP_ERR_INVALID_STATE;
+    ledcChannels[channel].dutyActive = ledcChannels[channel].duty;
+    return ESP_OK;
+}
+
+
+
+//===========================
+//========== pcnt ===========
+//===========================
+//counting like the hardware: edge on pulse input selects pos/neg mode, level of ctrl input
+//may reverse or disable it. The glitch filter is not simulated (inputs are ideal).
+static void pcntOnEdge(gpio_num_t gpio_num, int level){
+    for (simPcntUnit &unit : pcntUnit) {
+        if (!unit.running) continue;
+        for (int ch = 0; ch < PCNT_CHANNEL_MAX; ch++) {
+            const pcnt_config_t &config = unit.channel[ch];
+            if (!unit.channelConfigured[ch] || config.pulse_gpio_num != gpio_num) continue;
+            pcnt_count_mode_t mode = level ? config.pos_mode : config.neg_mode;
+            pcnt_ctrl_mode_t ctrl = gpioInputLevel[config.ctrl_gpio_num] ? config.hctrl_mode : config.lctrl_mode;
+            if (mode == PCNT_COUNT_DIS || ctrl == PCNT_MODE_DISABLE) continue;
+            bool up = (mode == PCNT_COUNT_INC) != (ctrl == PCNT_MODE_REVERSE);
+            unit.count += up ? 1 : -1;
+            uint32_t event = 0;
+            if (unit.count >= unit.hLim) event = PCNT_EVT_H_LIM;
+            if (unit.count <= unit.lLim) event = PCNT_EVT_L_LIM;
+            if (event) {
+                unit.count = 0;
+                unit.status = event;
+                if (unit.eventsEnabled & event) {
+                    unit.intrPending = true;
+                    if (pcntIsr) {
+                        simStats.pcntIsrCount++;
+                        sim_runIsr(pcntIsr, pcntIsrArg);
+                    } else if (unit.handler) {
+                        //isr service clears the interrupt before calling the handler
+                        unit.intrPending = false;
+                        simStats.pcntIsrCount++;
+                        sim_runIsr(unit.handler, unit.arg);
+                    }
+                }
+            }
+        }
+    }
+}
+
+esp_err_t pcnt_unit_config(const pcnt_config_t *pcnt_config){
+    simPcntUnit &unit = pcntUnit[pcnt_config->unit];
+    unit.channel[pcnt_config->channel] = *pcnt_config;
+    unit.channelConfigured[pcnt_config->channel] = true;
+    unit.hLim = pcnt_config->counter_h_lim;
+    unit.lLim = pcnt_config->counter_l_lim;
+    unit.count = 0;
+    unit.running = true;
+    return ESP_OK;
+}
+
+esp_err_t pcnt_get_counter_value(pcnt_unit_t pcnt_unit, int16_t *count){
+    *count = pcntUnit[pcnt_unit].count;
+    return ESP_OK;
+}
+
+esp_err_t pcnt_counter_pause(pcnt_unit_t pcnt_unit){
+    pcntUnit[pcnt_unit].running = false;
+    return ESP_OK;
+}
+
+esp_err_t pcnt_counter_resume(pcnt_unit_t pcnt_unit){
+    pcntUnit[pcnt_unit].running = true;
+    return ESP_OK;
+}
+
+esp_err_t pcnt_counter_clear(pcnt_unit_t pcnt_unit){
+    pcntUnit[pcnt_unit].count = 0;
+    return ESP_OK;
+}
+
+esp_err_t pcnt_intr_enable(pcnt_unit_t pcnt_unit){
+    return ESP_OK;
+}
+
+esp_err_t pcnt_intr_disable(pcnt_unit_t pcnt_unit){
+    return ESP_OK;
+}
+
+esp_err_t pcnt_event_enable(pcnt_unit_t unit, pcnt_evt_type_t evt_type){
+    pcntUnit[unit].eventsEnabled |= evt_type;
+    return ESP_OK;
+}
+
+esp_err_t pcnt_event_disable(pcnt_unit_t unit, pcnt_evt_type_t evt_type){
+    pcntUnit[unit].eventsEnabled &= ~evt_type;
+    return ESP_OK;
+}
+
+esp_err_t pcnt_get_event_status(pcnt_unit_t unit, uint32_t *status){
+    *status = pcntUnit[unit].status;
+    return ESP_OK;
+}
+
+esp_err_t pcnt_set_filter_value(pcnt_unit_t unit, uint16_t filter_val){
+    return ESP_OK;
+}
+
+esp_err_t pcnt_filter_enable(pcnt_unit_t unit){
+    return ESP_OK;
+}
+
+esp_err_t pcnt_filter_disable(pcnt_unit_t unit){
+    return ESP_OK;
+}
+
+esp_err_t pcnt_isr_register(void (*fn)(void *), void *arg, int intr_alloc_flags, pcnt_isr_handle_t *handle){
+    pcntIsr = fn;
+    pcntIsrArg = arg;
+    *handle = (pcnt_isr_handle_t)&pcntIsr;
+    return ESP_OK;
+}
+
+esp_err_t esp_intr_free(intr_handle_t handle){
+    if (handle == (intr_handle_t)&pcntIsr) pcntIsr = nullptr;
+    return ESP_OK;
+}
+
+//low level register access (hal/pcnt_ll.h)
+pcnt_dev_t *sim_pcntHw(void){
+    return (pcnt_dev_t *)pcntUnit;
+}
+
+void pcnt_ll_get_counter_value(pcnt_dev_t *hw, pcnt_unit_t unit, int16_t *count){
+    *count = pcntUnit[unit].count;
+}
+
+void pcnt_ll_get_intr_status(pcnt_dev_t *hw, uint32_t *status){
+    *status = 0;
+    for (int unit = 0; unit < PCNT_UNIT_MAX; unit++) {
+        if (pcntUnit[unit].intrPending) *status |= 1 << unit;
+    }
+}
+
+void pcnt_ll_clear_intr_status(pcnt_dev_t *hw, uint32_t status){
+    for (int unit = 0; unit < PCNT_UNIT_MAX; unit++) {
+        if (status & (1 << unit)) pcntUnit[unit].intrPending = false;
+    }
+}
+
+void pcnt_ll_get_event_status(pcnt_dev_t *hw, pcnt_unit_t unit, uint32_t *status){
+    *status = pcntUnit[unit].status;
+}
+
+esp_err_t pcnt_isr_service_install(int intr_alloc_flags){
+    return ESP_OK;
+}
+
+esp_err_t pcnt_isr_handler_add(pcnt_unit_t unit, void(*isr_handler)(void *), void *args){
+    pcntUnit[unit].handler = isr_handler;
+    pcntUnit[unit].arg = args;
+    return ESP_OK;
+}
+
+esp_err_t pcnt_isr_handler_remove(pcnt_unit_t unit){
+    pcntUnit[unit].handler = nullptr;
+    return ESP_OK;
+}
+
+
+
+//===========================
+//=========== uart ==========
+//===========================
+//receive buffer is a queue of characters, reading blocks like the driver
+void sim_uartInput(uart_port_t uart_num, const char *text){
+    if (uartRx[uart_num] == NULL) return;
+    for (const char *c = text; *c; c++) {
+        xQueueSend(uartRx[uart_num], c, 0);
+    }
+}
+
+esp_err_t uart_driver_install(uart_port_t uart_num, int rx_buffer_size, int tx_buffer_size, int queue_size,
+        QueueHandle_t *uart_queue, int intr_alloc_flags){
+    uartRx[uart_num] = xQueueCreate(rx_buffer_size, 1);
+    return ESP_OK;
+}
+
+void sim_uartReceive(uart_port_t uart_num, const uint8_t *data, size_t length){
+    if (uartRx[uart_num] == NULL) return;
+    for (size_t i = 0; i < length; i++) {
+        xQueueSend(uartRx[uart_num], &data[i], 0);
+    }
+}
+
+void sim_uartSetTxHandler(uart_port_t uart_num, simUartTxHandler_t handler){
+    uartTxHandler[uart_num] = handler;
+}
+
+uint64_t sim_uartByteUs(uart_port_t uart_num){
+    return 10 * 1000000ULL / uartBaud[uart_num]; //8N1: start + 8 data + stop bit
+}
+
+esp_err_t uart_param_config(uart_port_t uart_num, const uart_config_t *uart_config){
+    uartBaud[uart_num] = uart_config->baud_rate;
+    return ESP_OK;
+}
+
+esp_err_t uart_set_pin(uart_port_t uart_num, int tx_io_num, int rx_io_num, int rts_io_num, int cts_io_num){
+    return ESP_OK;
+}
+
+esp_err_t uart_set_mode(uart_port_t uart_num, uart_mode_t mode){
+    return ESP_OK;
+}
+
+int uart_write_bytes(uart_port_t uart_num, const void *src, size_t size){
+    uint64_t start = std::max(sim_nowUs(), uartTxDoneUs[uart_num]);
+    uartTxDoneUs[uart_num] = start + size * sim_uartByteUs(uart_num);
+    if (uartTxHandler[uart_num]) uartTxHandler[uart_num]((const uint8_t *)src, size, uartTxDoneUs[uart_num]);
+    return size;
+}
+
+esp_err_t uart_wait_tx_done(uart_port_t uart_num, TickType_t ticks_to_wait){
+    if (uartTxDoneUs[uart_num] > sim_nowUs()) sim_blockUs(uartTxDoneUs[uart_num] - sim_nowUs());
+    return ESP_OK;
+}
+
+esp_err_t uart_flush_input(uart_port_t uart_num){
+    if (uartRx[uart_num] == NULL) return ESP_OK;
+    uint8_t c;
+    while (xQueueReceive(uartRx[uart_num], &c, 0) == pdTRUE) {}
+    return ESP_OK;
+}
+
+int uart_read_bytes(uart_port_t uart_num, void *buf, uint32_t length, TickType_t ticks_to_wait){
+    if (uartRx[uart_num] == NULL) return -1;
+    uint32_t count = 0;
+    while (count < length && xQueueReceive(uartRx[uart_num], (uint8_t *)buf + count, ticks_to_wait) == pdTRUE) {
+        count++;
+    }
+    return count;
+}
+
+
+
+//===========================
+//=========== nvs ===========
+//===========================
+//single namespace, values are kept in memory for the runtime of the simulation
+esp_err_t nvs_flash_init(void){
+    nvsInitialized = true;
+    return ESP_OK;
+}
+
+esp_err_t nvs_flash_erase(void){
+    nvsData.clear();
+    return ESP_OK;
+}
+
+esp_err_t nvs_open(const char *name, nvs_open_mode_t open_mode, nvs_handle_t *out_handle){
+    if (!nvsInitialized) return ESP_ERR_NVS_NOT_INITIALIZED;
+    *out_handle = 1;
+    return ESP_OK;
+}
+
+void nvs_close(nvs_handle_t handle){
+}
+
+esp_err_t nvs_commit(nvs_handle_t handle){
+    simStats.nvsCommits++;
+    if (machineState.vfdOn) simStats.flashVfdOn++;
+    return ESP_OK;
+}
+
+esp_err_t nvs_erase_key(nvs_handle_t handle, const char *key){
+    return nvsData.erase(key) ? ESP_OK : ESP_ERR_NVS_NOT_FOUND;
+}
+
+esp_err_t nvs_set_blob(nvs_handle_t handle, const char *key, const void *value, size_t length){
+    nvsData[key] = std::vector<uint8_t>((const uint8_t *)value, (const uint8_t *)value + length);
+    return ESP_OK;
+}
+
+esp_err_t nvs_get_blob(nvs_handle_t handle, const char *key, void *out_value, size_t *length){
+    auto entry = nvsData.find(key);
+    if (entry == nvsData.end()) return ESP_ERR_NVS_NOT_FOUND;
+    if (out_value == nullptr) {
+        *length = entry->second.size();
+        return ESP_OK;
+    }
+    if (*length < entry->second.size()) return ESP_ERR_NVS_INVALID_LENGTH;
+    memcpy(out_value, entry->second.data(), entry->second.size());
+    *length = entry->second.size();
+    return ESP_OK;
+}
+
+//fixed size values are stored as blobs of their size
+#define NVS_SIM_SCALAR(suffix, type)                                                        \
+    esp_err_t nvs_set_##suffix(nvs_handle_t handle, const char *key, type value){           \
+        return nvs_set_blob(handle, key, &value, sizeof(type));                             \
+    }                                                                                       \
+    esp_err_t nvs_get_##suffix(nvs_handle_t handle, const char *key, type *out_value){      \
+        size_t length = sizeof(type);                                                       \
+        auto entry = nvsData.find(key);                                                     \
+        if (entry == nvsData.end()) return ESP_ERR_NVS_NOT_FOUND;                           \
+        if (entry->second.size() != sizeof(type)) return ESP_ERR_NVS_TYPE_MISMATCH;         \
+        return nvs_get_blob(handle, key, out_value, &length);                               \
+    }
+NVS_SIM_SCALAR(u8, uint8_t)
+NVS_SIM_SCALAR(u16, uint16_t)
+NVS_SIM_SCALAR(u32, uint32_t)
+NVS_SIM_SCALAR(i32, int32_t)
+
+
+
+//===========================
+//========== error ==========
+//===========================
+const char *esp_err_to_name(esp_err_t code){
+    switch (code) {
+        case ESP_OK: return "ESP_OK";
+        case ESP_FAIL: return "ESP_FAIL";
+        case ESP_ERR_NO_MEM: return "ESP_ERR_NO_MEM";
+        case ESP_ERR_INVALID_ARG: return "ESP_ERR_INVALID_ARG";
+        case ESP_ERR_INVALID_STATE: return "ESP_ERR_INVALID_STATE";
+        case ESP_ERR_INVALID_SIZE: return "ESP_ERR_INVALID_SIZE";
+        case ESP_ERR_NOT_FOUND: return "ESP_ERR_NOT_FOUND";
+        case ESP_ERR_TIMEOUT: return "ESP_ERR_TIMEOUT";
+        case ESP_ERR_INVALID_CRC: return "ESP_ERR_INVALID_CRC";
+        case ESP_ERR_NVS_NOT_FOUND: return "ESP_ERR_NVS_NOT_FOUND";
+        case ESP_ERR_NVS_NOT_INITIALIZED: return "ESP_ERR_NVS_NOT_INITIALIZED";
+        default: return "UNKNOWN_ERROR";
+    }
+}
+
+
+
+//===========================
+//==== flash partitions =====
+//===========================
+static std::vector<uint8_t> & partitionContent(const esp_partition_t *partition){
+    std::vector<uint8_t> &data = partitionData[partition - partitionTable];
+    if (data.empty()) data.assign(partition->size, 0xFF);
+    return data;
+}
+
+void sim_flashLoad(const char *path){
+    flashPath = path;
+    FILE *file = fopen(path, "rb");
+    if (file == NULL) return; //first run: erased flash
+    for (const esp_partition_t &partition : partitionTable) {
+        std::vector<uint8_t> &data = partitionContent(&partition);
+        if (fread(data.data(), 1, data.size(), file) != data.size()) break;
+    }
+    fclose(file);
+}
+
+void sim_flashSave(){
+    if (flashPath.empty()) return;
+    FILE *file = fopen(flashPath.c_str(), "wb");
+    if (file == NULL) return;
+    for (const esp_partition_t &partition : partitionTable) {
+        std::vector<uint8_t> &data = partitionContent(&partition);
+        fwrite(data.data(), 1, data.size(), file);
+    }
+    fclose(file);
+}
+
+uint64_t sim_flashLastWriteUs(){
+    return flashLastWriteUs;
+}
+
+const esp_partition_t *esp_partition_find_first(esp_partition_type_t type, esp_partition_subtype_t subtype, const char *label){
+    for (const esp_partition_t &partition : partitionTable) {
+        if (partition.type != type) continue;
+        if (subtype != ESP_PARTITION_SUBTYPE_ANY && partition.subtype != subtype) continue;
+        if (label != NULL && strcmp(label, partition.label) != 0) continue;
+        return &partition;
+    }
+    return NULL;
+}
+
+esp_err_t esp_partition_read(const esp_partition_t *partition, size_t src_offset, void *dst, size_t size){
+    if (src_offset + size > partition->size) return ESP_ERR_INVALID_SIZE;
+    memcpy(dst, &partitionContent(partition)[src_offset], size);
+    return ESP_OK;
+}
+
+//flash operation while the vfd runs: stop trip isr would be delayed on the target
+static void countFlashVfdOn(uint64_t durationUs){
+    if (!machineState.vfdOn) return;
+    simStats.flashVfdOn++;
+    if (durationUs > simStats.flashVfdOnMaxUs) simStats.flashVfdOnMaxUs = durationUs;
+}
+
+//programming can only clear bits like on the flash chip
+esp_err_t esp_partition_write(const esp_partition_t *partition, size_t dst_offset, const void *src, size_t size){
+    if (dst_offset + size > partition->size) return ESP_ERR_INVALID_SIZE;
+    std::vector<uint8_t> &data = partitionContent(partition);
+    for (size_t i = 0; i < size; i++) {
+        data[dst_offset + i] &= ((const uint8_t *)src)[i];
+    }
+    simStats.flashWrites++;
+    sim_blockUs(FLASH_PROGRAM_US(size));
+    countFlashVfdOn(FLASH_PROGRAM_US(size));
+    flashLastWriteUs = sim_nowUs();
+    return ESP_OK;
+}
+
+esp_err_t esp_partition_erase_range(const esp_partition_t *partition, size_t offset, size_t size){
+    if (offset % SPI_FLASH_SEC_SIZE || size % SPI_FLASH_SEC_SIZE) return ESP_ERR_INVALID_ARG;
+    if (offset + size > partition->size) return ESP_ERR_INVALID_SIZE;
+    std::vector<uint8_t> &data = partitionContent(partition);
+    memset(&data[offset], 0xFF, size);
+    simStats.flashErases += size / SPI_FLASH_SEC_SIZE;
+    sim_blockUs((uint64_t)FLASH_ERASE_SECTOR_US * (size / SPI_FLASH_SEC_SIZE));
+    countFlashVfdOn((uint64_t)FLASH_ERASE_SECTOR_US * (size / SPI_FLASH_SEC_SIZE));
+    return ESP_OK;
+}
@@ -0,0 +1,663 @@
+//virtual clock and cooperative scheduler replacing FreeRTOS on the host
+//- every task runs as a coroutine (ucontext) until it blocks (delay, queue, mutex, notification)
+//- when no task is ready the clock jumps to the next task wakeup, timer alarm or machine event
+//- isrs never interrupt a task slice, time does not pass while a task executes
+#include <ucontext.h>
+#include <cstdarg>
+#include <cstring>
+#include <vector>
+#include <deque>
+#include <map>
+#include <string>
+#include <functional>
+
+extern "C" {
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "freertos/queue.h"
+#include "freertos/semphr.h"
+#include "driver/timer.h"
+#include "esp_timer.h"
+#include "esp_log.h"
+}
+#include "sim.hpp"
+
+//time charged for a task that yields without delay (vTaskDelay(0)), prevents livelock on frozen clock
+#define SIM_YIELD_US 100
+#define SIM_TASK_STACK_SIZE (256 * 1024)
+#define SIM_TICK_US (1000000 / configTICK_RATE_HZ)
+
+
+//=====================
+//===== variables =====
+//=====================
+struct simTask {
+    ucontext_t ctx;
+    std::vector<char> stack;
+    TaskFunction_t function;
+    void * arg;
+    std::string name;
+    UBaseType_t priority;
+    uint64_t wakeUs = 0;
+    std::function<bool()> waitCondition; //task becomes ready early when this returns true
+    uint64_t seq = 0; //fifo order among tasks of same priority
+    bool finished = false;
+    uint32_t notifyValue = 0;
+    bool notifyPending = false;
+};
+
+struct simQueue {
+    std::deque<std::vector<uint8_t>> items;
+    UBaseType_t length;
+    UBaseType_t itemSize;
+    bool isMutex = false;
+    simTask * holder = nullptr;
+};
+
+struct simTimer {
+    timer_isr_t callback = nullptr;
+    void * arg = nullptr;
+    bool running = false;
+    bool autoReload = true;
+    uint64_t alarmValue = 0;
+    uint64_t counterValue = 0; //counter while paused
+    uint64_t counterZeroUs = 0; //virtual time the counter was zero while running
+};
+
+struct simEspTimer {
+    esp_timer_cb_t callback;
+    void * arg;
+    bool armed = false;
+    uint64_t deadlineUs = 0;
+    uint64_t periodUs = 0; //0 = one-shot
+};
+
+static uint64_t nowUs = 0;
+static std::vector<simTask *> tasks;
+static simTask * currentTask = nullptr;
+static ucontext_t schedulerCtx;
+static uint64_t seqCounter = 0;
+static bool stopRequested = false;
+static int isrNesting = 0;
+static simTimer timers[TIMER_GROUP_MAX][TIMER_MAX];
+static std::vector<simEspTimer *> espTimers;
+
+static esp_log_level_t logLevelMax = ESP_LOG_ERROR;
+static esp_log_level_t logLevelDefault = ESP_LOG_INFO;
+static std::map<std::string, esp_log_level_t> logLevels;
+
+
+
+//============================
+//===== clock, scheduler =====
+//============================
+uint64_t sim_nowUs(){
+    return nowUs;
+}
+
+bool sim_inIsr(){
+    return isrNesting > 0;
+}
+
+void sim_requestStop(){
+    stopRequested = true;
+}
+
+void sim_runIsr(void (*handler)(void *), void *arg){
+    isrNesting++;
+    handler(arg);
+    isrNesting--;
+}
+
+
+//--- block current task ---
+//returns to scheduler until wakeUs passed or condition true
+static void blockCurrentTask(uint64_t wakeUs, std::function<bool()> condition = nullptr){
+    simTask * task = currentTask;
+    if (task == nullptr) {
+        return; //called outside of a task (static init, isr) -> cannot block
+    }
+    task->wakeUs = wakeUs;
+    task->waitCondition = condition;
+    task->seq = ++seqCounter;
+    swapcontext(&task->ctx, &schedulerCtx);
+}
+
+//--- blocking driver call ---
+void sim_blockUs(uint64_t us){
+    blockCurrentTask(nowUs + us);
+}
+
+//convert ticks to absolute wakeup time
+static uint64_t ticksToDeadline(TickType_t ticks){
+    if (ticks == portMAX_DELAY) return SIM_TIME_NEVER;
+    return nowUs + (uint64_t)ticks * SIM_TICK_US;
+}
+
+static void taskEntry(){
+    simTask * task = currentTask;
+    task->function(task->arg);
+    //returning from a task function is only allowed for app_main in esp-idf, handle like vTaskDelete
+    task->finished = true;
+    swapcontext(&task->ctx, &schedulerCtx);
+}
+
+static bool isReady(simTask * task){
+    if (task->finished) return false;
+    if (task->wakeUs <= nowUs) return true;
+    return task->waitCondition && task->waitCondition();
+}
+
+
+//--- fire due timer alarms ---
+static void processTimers(){
+    for (int g = 0; g < TIMER_GROUP_MAX; g++) {
+        for (int i = 0; i < TIMER_MAX; i++) {
+            simTimer & timer = timers[g][i];
+            if (!timer.running || timer.callback == nullptr) continue;
+            uint64_t alarmUs = timer.counterZeroUs + timer.alarmValue;
+            if (alarmUs > nowUs) continue;
+            if (timer.autoReload) {
+                timer.counterZeroUs = alarmUs;
+            } else {
+                timer.running = false;
+            }
+            simStats.timerIsrCount++;
+            GPIO.out_w1ts = 0;
+            GPIO.out_w1tc = 0;
+            isrNesting++;
+            timer.callback(timer.arg);
+            isrNesting--;
+            machine_checkStepPulse();
+        }
+    }
+    //esp_timer callbacks
+    for (simEspTimer * timer : espTimers) {
+        if (!timer->armed || timer->deadlineUs > nowUs) continue;
+        if (timer->periodUs) {
+            timer->deadlineUs += timer->periodUs;
+        } else {
+            timer->armed = false;
+        }
+        timer->callback(timer->arg);
+    }
+}
+
+static uint64_t nextTimerAlarmUs(){
+    uint64_t next = SIM_TIME_NEVER;
+    for (int g = 0; g < TIMER_GROUP_MAX; g++) {
+        for (int i = 0; i < TIMER_MAX; i++) {
+            simTimer & timer = timers[g][i];
+            if (timer.running && timer.callback != nullptr) {
+                uint64_t alarmUs = timer.counterZeroUs + timer.alarmValue;
+                if (alarmUs < next) next = alarmUs;
+            }
+        }
+    }
+    for (simEspTimer * timer : espTimers) {
+        if (timer->armed && timer->deadlineUs < next) next = timer->deadlineUs;
+    }
+    return next;
+}
+
+
+//===========================
+//========= sim_run =========
+//===========================
+void sim_run(uint64_t untilUs){
+    stopRequested = false;
+    while (!stopRequested) {
+        //--- run ready task with highest priority ---
+        simTask * next = nullptr;
+        for (simTask * task : tasks) {
+            if (!isReady(task)) continue;
+            if (next == nullptr
+                    || task->priority > next->priority
+                    || (task->priority == next->priority && task->seq < next->seq)) {
+                next = task;
+            }
+        }
+        if (next != nullptr) {
+            next->waitCondition = nullptr;
+            currentTask = next;
+            simStats.taskSwitches++;
+            swapcontext(&schedulerCtx, &next->ctx);
+            currentTask = nullptr;
+            continue;
+        }
+
+        //--- no task ready -> advance clock to next event ---
+        uint64_t nextUs = nextTimerAlarmUs();
+        uint64_t machineUs = machine_nextEventUs();
+        if (machineUs < nextUs) nextUs = machineUs;
+        for (simTask * task : tasks) {
+            if (!task->finished && task->wakeUs < nextUs) nextUs = task->wakeUs;
+        }
+        if (nextUs > untilUs) {
+            nowUs = untilUs;
+            return;
+        }
+        if (nextUs > nowUs) nowUs = nextUs;
+        machine_process(nowUs);
+        processTimers();
+    }
+}
+
+
+
+//==========================
+//========= tasks ==========
+//==========================
+BaseType_t xTaskCreate(TaskFunction_t pvTaskCode, const char * const pcName, const uint32_t usStackDepth,
+                       void * const pvParameters, UBaseType_t uxPriority, TaskHandle_t * const pvCreatedTask){
+    simTask * task = new simTask();
+    task->function = pvTaskCode;
+    task->arg = pvParameters;
+    task->name = pcName;
+    task->priority = uxPriority;
+    task->wakeUs = nowUs;
+    task->seq = ++seqCounter;
+    task->stack.resize(SIM_TASK_STACK_SIZE);
+    getcontext(&task->ctx);
+    task->ctx.uc_stack.ss_sp = task->stack.data();
+    task->ctx.uc_stack.ss_size = task->stack.size();
+    task->ctx.uc_link = nullptr;
+    makecontext(&task->ctx, taskEntry, 0);
+    tasks.push_back(task);
+    if (pvCreatedTask) *pvCreatedTask = task;
+    return pdPASS;
+}
+
+BaseType_t xTaskCreatePinnedToCore(TaskFunction_t pvTaskCode, const char * const pcName, const uint32_t usStackDepth,
+                       void * const pvParameters, UBaseType_t uxPriority, TaskHandle_t * const pvCreatedTask, const BaseType_t xCoreID){
+    return xTaskCreate(pvTaskCode, pcName, usStackDepth, pvParameters, uxPriority, pvCreatedTask);
+}
+
+void vTaskDelete(TaskHandle_t xTaskToDelete){
+    simTask * task = xTaskToDelete ? xTaskToDelete : currentTask;
+    if (task == nullptr) return;
+    task->finished = true;
+    if (task == currentTask) {
+        swapcontext(&task->ctx, &schedulerCtx);
+    }
+}
+
+void vTaskDelay(const TickType_t xTicksToDelay){
+    if (xTicksToDelay == 0) {
+        blockCurrentTask(nowUs + SIM_YIELD_US);
+    } else {
+        blockCurrentTask(ticksToDeadline(xTicksToDelay));
+    }
+}
+
+void vTaskDelayUntil(TickType_t * const pxPreviousWakeTime, const TickType_t xTimeIncrement){
+    *pxPreviousWakeTime += xTimeIncrement;
+    uint64_t wakeUs = (uint64_t)*pxPreviousWakeTime * SIM_TICK_US;
+    if (wakeUs > nowUs) {
+        blockCurrentTask(wakeUs);
+    }
+}
+
+TickType_t xTaskGetTickCount(void){
+    return nowUs / SIM_TICK_US;
+}
+
+TickType_t xTaskGetTickCountFromISR(void){
+    return xTaskGetTickCount();
+}
+
+TaskHandle_t xTaskGetCurrentTaskHandle(void){
+    return currentTask;
+}
+
+
+//--- notifications ---
+BaseType_t xTaskNotify(TaskHandle_t xTaskToNotify, uint32_t ulValue, eNotifyAction eAction){
+    simTask * task = xTaskToNotify;
+    switch (eAction) {
+        case eNoAction: break;
+        case eSetBits: task->notifyValue |= ulValue; break;
+        case eIncrement: task->notifyValue++; break;
+        case eSetValueWithOverwrite: task->notifyValue = ulValue; break;
+        case eSetValueWithoutOverwrite:
+            if (task->notifyPending) return pdFAIL;
+            task->notifyValue = ulValue;
+            break;
+    }
+    task->notifyPending = true;
+    return pdPASS;
+}
+
+BaseType_t xTaskNotifyFromISR(TaskHandle_t xTaskToNotify, uint32_t ulValue, eNotifyAction eAction, BaseType_t *pxHigherPriorityTaskWoken){
+    if (pxHigherPriorityTaskWoken) *pxHigherPriorityTaskWoken = pdTRUE;
+    return xTaskNotify(xTaskToNotify, ulValue, eAction);
+}
+
+BaseType_t xTaskNotifyGive(TaskHandle_t xTaskToNotify){
+    return xTaskNotify(xTaskToNotify, 0, eIncrement);
+}
+
+void vTaskNotifyGiveFromISR(TaskHandle_t xTaskToNotify, BaseType_t *pxHigherPriorityTaskWoken){
+    xTaskNotifyFromISR(xTaskToNotify, 0, eIncrement, pxHigherPriorityTaskWoken);
+}
+
+BaseType_t xTaskNotifyWait(uint32_t ulBitsToClearOnEntry, uint32_t ulBitsToClearOnExit, uint32_t *pulNotificationValue, TickType_t xTicksToWait){
+    simTask * task = currentTask;
+    if (!task->notifyPending) {
+        task->notifyValue &= ~ulBitsToClearOnEntry;
+        uint64_t deadline = ticksToDeadline(xTicksToWait);
+        while (!task->notifyPending && nowUs < deadline) {
+            blockCurrentTask(deadline, [task]{ return task->notifyPending; });
+        }
+    }
+    if (pulNotificationValue) *pulNotificationValue = task->notifyValue;
+    if (!task->notifyPending) return pdFALSE;
+    task->notifyPending = false;
+    task->notifyValue &= ~ulBitsToClearOnExit;
+    return pdTRUE;
+}
+
+uint32_t ulTaskNotifyTake(BaseType_t xClearCountOnExit, TickType_t xTicksToWait){
+    simTask * task = currentTask;
+    uint64_t deadline = ticksToDeadline(xTicksToWait);
+    while (task->notifyValue == 0 && nowUs < deadline) {
+        blockCurrentTask(deadline, [task]{ return task->notifyValue != 0; });
+    }
+    uint32_t value = task->notifyValue;
+    if (value != 0) {
+        task->notifyValue = xClearCountOnExit ? 0 : value - 1;
+    }
+    task->notifyPending = false;
+    return value;
+}
+
+
+
+//==========================
+//========= queues =========
+//==========================
+QueueHandle_t xQueueCreate(UBaseType_t uxQueueLength, UBaseType_t uxItemSize){
+    simQueue * queue = new simQueue();
+    queue->length = uxQueueLength;
+    queue->itemSize = uxItemSize;
+    return queue;
+}
+
+void vQueueDelete(QueueHandle_t xQueue){
+    delete xQueue;
+}
+
+static BaseType_t queueSend(QueueHandle_t queue, const void * item, TickType_t ticksToWait, bool toFront){
+    uint64_t deadline = ticksToDeadline(ticksToWait);
+    while (queue->items.size() >= queue->length) {
+        if (nowUs >= deadline || currentTask == nullptr || sim_inIsr()) return errQUEUE_FULL;
+        blockCurrentTask(deadline, [queue]{ return queue->items.size() < queue->length; });
+    }
+    std::vector<uint8_t> data((const uint8_t *)item, (const uint8_t *)item + queue->itemSize);
+    if (toFront) {
+        queue->items.push_front(data);
+    } else {
+        queue->items.push_back(data);
+    }
+    return pdPASS;
+}
+
+BaseType_t xQueueSend(QueueHandle_t xQueue, const void * pvItemToQueue, TickType_t xTicksToWait){
+    return queueSend(xQueue, pvItemToQueue, xTicksToWait, false);
+}
+
+BaseType_t xQueueSendToFront(QueueHandle_t xQueue, const void * pvItemToQueue, TickType_t xTicksToWait){
+    return queueSend(xQueue, pvItemToQueue, xTicksToWait, true);
+}
+
+BaseType_t xQueueOverwrite(QueueHandle_t xQueue, const void * pvItemToQueue){
+    xQueue->items.clear();
+    return queueSend(xQueue, pvItemToQueue, 0, false);
+}
+
+BaseType_t xQueueSendFromISR(QueueHandle_t xQueue, const void * pvItemToQueue, BaseType_t *pxHigherPriorityTaskWoken){
+    if (pxHigherPriorityTaskWoken) *pxHigherPriorityTaskWoken = pdFALSE;
+    return queueSend(xQueue, pvItemToQueue, 0, false);
+}
+
+BaseType_t xQueueOverwriteFromISR(QueueHandle_t xQueue, const void * pvItemToQueue, BaseType_t *pxHigherPriorityTaskWoken){
+    if (pxHigherPriorityTaskWoken) *pxHigherPriorityTaskWoken = pdFALSE;
+    return xQueueOverwrite(xQueue, pvItemToQueue);
+}
+
+static BaseType_t queueReceive(QueueHandle_t queue, void * buffer, TickType_t ticksToWait, bool remove){
+    uint64_t deadline = ticksToDeadline(ticksToWait);
+    while (queue->items.empty()) {
+        if (nowUs >= deadline || currentTask == nullptr || sim_inIsr()) return pdFALSE;
+        blockCurrentTask(deadline, [queue]{ return !queue->items.empty(); });
+    }
+    memcpy(buffer, queue->items.front().data(), queue->itemSize);
+    if (remove) queue->items.pop_front();
+    return pdTRUE;
+}
+
+BaseType_t xQueueReceive(QueueHandle_t xQueue, void * pvBuffer, TickType_t xTicksToWait){
+    return queueReceive(xQueue, pvBuffer, xTicksToWait, true);
+}
+
+BaseType_t xQueuePeek(QueueHandle_t xQueue, void * pvBuffer, TickType_t xTicksToWait){
+    return queueReceive(xQueue, pvBuffer, xTicksToWait, false);
+}
+
+BaseType_t xQueueReceiveFromISR(QueueHandle_t xQueue, void * pvBuffer, BaseType_t *pxHigherPriorityTaskWoken){
+    if (pxHigherPriorityTaskWoken) *pxHigherPriorityTaskWoken = pdFALSE;
+    return queueReceive(xQueue, pvBuffer, 0, true);
+}
+
+UBaseType_t uxQueueMessagesWaiting(QueueHandle_t xQueue){
+    return xQueue->items.size();
+}
+
+BaseType_t xQueueReset(QueueHandle_t xQueue){
+    xQueue->items.clear();
+    return pdPASS;
+}
+
+
+
+//==========================
+//======= semaphores =======
+//==========================
+SemaphoreHandle_t xSemaphoreCreateMutex(void){
+    simQueue * mutex = new simQueue();
+    mutex->isMutex = true;
+    mutex->length = 1;
+    mutex->itemSize = 0;
+    return mutex;
+}
+
+SemaphoreHandle_t xSemaphoreCreateBinary(void){
+    return xQueueCreate(1, 0);
+}
+
+BaseType_t xSemaphoreTake(SemaphoreHandle_t xSemaphore, TickType_t xBlockTime){
+    if (xSemaphore->isMutex) {
+        uint64_t deadline = ticksToDeadline(xBlockTime);
+        while (xSemaphore->holder != nullptr) {
+            if (nowUs >= deadline || currentTask == nullptr) return pdFALSE;
+            blockCurrentTask(deadline, [xSemaphore]{ return xSemaphore->holder == nullptr; });
+        }
+        //outside of tasks (static init) the mutex is not actually held
+        xSemaphore->holder = currentTask;
+        return pdTRUE;
+    }
+    uint8_t dummy;
+    return queueReceive(xSemaphore, &dummy, xBlockTime, true);
+}
+
+BaseType_t xSemaphoreGive(SemaphoreHandle_t xSemaphore){
+    if (xSemaphore->isMutex) {
+        xSemaphore->holder = nullptr;
+        return pdTRUE;
+    }
+    uint8_t dummy = 0;
+    return queueSend(xSemaphore, &dummy, 0, false);
+}
+
+BaseType_t xSemaphoreGiveFromISR(SemaphoreHandle_t xSemaphore, BaseType_t *pxHigherPriorityTaskWoken){
+    if (pxHigherPriorityTaskWoken) *pxHigherPriorityTaskWoken = pdFALSE;
+    return xSemaphoreGive(xSemaphore);
+}
+
+
+
+//==========================
+//========= timers =========
+//==========================
+//counter runs at 1MHz (divider 80) in this firmware, other dividers are not simulated
+esp_err_t timer_init(timer_group_t group_num, timer_idx_t timer_num, const timer_config_t *config){
+    simTimer & timer = timers[group_num][timer_num];
+    timer.autoReload = config->auto_reload == TIMER_AUTORELOAD_EN;
+    timer.running = config->counter_en == TIMER_START;
+    timer.counterValue = 0;
+    timer.counterZeroUs = nowUs;
+    if (config->divider != 80) {
+        ESP_LOGE("sim", "timer divider %u not supported, assuming 1MHz", config->divider);
+    }
+    return ESP_OK;
+}
+
+esp_err_t timer_set_counter_value(timer_group_t group_num, timer_idx_t timer_num, uint64_t load_val){
+    simTimer & timer = timers[group_num][timer_num];
+    timer.counterValue = load_val;
+    timer.counterZeroUs = nowUs - load_val;
+    return ESP_OK;
+}
+
+esp_err_t timer_get_counter_value(timer_group_t group_num, timer_idx_t timer_num, uint64_t *timer_val){
+    simTimer & timer = timers[group_num][timer_num];
+    *timer_val = timer.running ? nowUs - timer.counterZeroUs : timer.counterValue;
+    return ESP_OK;
+}
+
+esp_err_t timer_set_alarm_value(timer_group_t group_num, timer_idx_t timer_num, uint64_t alarm_value){
+    timers[group_num][timer_num].alarmValue = alarm_value;
+    return ESP_OK;
+}
+
+esp_err_t timer_start(timer_group_t group_num, timer_idx_t timer_num){
+    simTimer & timer = timers[group_num][timer_num];
+    if (!timer.running) {
+        timer.counterZeroUs = nowUs - timer.counterValue;
+        //alarm already passed: hardware would fire immediately
+        if (timer.counterValue > timer.alarmValue) timer.counterZeroUs = nowUs - timer.alarmValue;
+        timer.running = true;
+    }
+    return ESP_OK;
+}
+
+esp_err_t timer_pause(timer_group_t group_num, timer_idx_t timer_num){
+    simTimer & timer = timers[group_num][timer_num];
+    if (timer.running) {
+        timer.counterValue = nowUs - timer.counterZeroUs;
+        timer.running = false;
+    }
+    return ESP_OK;
+}
+
+esp_err_t timer_isr_callback_add(timer_group_t group_num, timer_idx_t timer_num, timer_isr_t isr_handler, void *arg, int intr_alloc_flags){
+    timers[group_num][timer_num].callback = isr_handler;
+    timers[group_num][timer_num].arg = arg;
+    return ESP_OK;
+}
+
+esp_err_t timer_isr_callback_remove(timer_group_t group_num, timer_idx_t timer_num){
+    timers[group_num][timer_num].callback = nullptr;
+    return ESP_OK;
+}
+
+
+
+//===========================
+//======== esp_timer ========
+//===========================
+esp_err_t esp_timer_create(const esp_timer_create_args_t *create_args, esp_timer_handle_t *out_handle){
+    simEspTimer * timer = new simEspTimer();
+    timer->callback = create_args->callback;
+    timer->arg = create_args->arg;
+    espTimers.push_back(timer);
+    *out_handle = timer;
+    return ESP_OK;
+}
+
+esp_err_t esp_timer_start_once(esp_timer_handle_t timer, uint64_t timeout_us){
+    if (timer->armed) return ESP_ERR_INVALID_STATE;
+    timer->armed = true;
+    timer->deadlineUs = nowUs + timeout_us;
+    timer->periodUs = 0;
+    return ESP_OK;
+}
+
+esp_err_t esp_timer_start_periodic(esp_timer_handle_t timer, uint64_t period){
+    if (timer->armed) return ESP_ERR_INVALID_STATE;
+    timer->armed = true;
+    timer->deadlineUs = nowUs + period;
+    timer->periodUs = period;
+    return ESP_OK;
+}
+
+esp_err_t esp_timer_stop(esp_timer_handle_t timer){
+    if (!timer->armed) return ESP_ERR_INVALID_STATE;
+    timer->armed = false;
+    return ESP_OK;
+}
+
+esp_err_t esp_timer_delete(esp_timer_handle_t timer){
+    timer->armed = false;
+    timer->callback = nullptr;
+    return ESP_OK;
+}
+
+
+
+//=========================
+//===== time, logging =====
+//=========================
+int64_t esp_timer_get_time(void){
+    return nowUs;
+}
+
+uint32_t esp_log_timestamp(void){
+    return nowUs / 1000;
+}
+
+//busy waiting does not advance the virtual clock, only accounted in statistics
+void ets_delay_us(uint32_t us){
+    if (sim_inIsr()) {
+        simStats.isrBusyWaitUs += us;
+    } else {
+        simStats.taskBusyWaitUs += us;
+    }
+}
+
+void sim_setLogLevelMax(esp_log_level_t level){
+    logLevelMax = level;
+}
+
+void esp_log_level_set(const char *tag, esp_log_level_t level){
+    if (strcmp(tag, "*") == 0) {
+        logLevelDefault = level;
+        logLevels.clear();
+    } else {
+        logLevels[tag] = level;
+    }
+}
+
+void sim_log_write(esp_log_level_t level, const char *tag, const char *format, ...){
+    if (level > logLevelMax) return;
+    auto entry = logLevels.find(tag);
+    esp_log_level_t tagLevel = entry == logLevels.end() ? logLevelDefault : entry->second;
+    if (level > tagLevel) return;
+    static const char levelChar[] = {'N', 'E', 'W', 'I', 'D', 'V'};
+    printf("%c (%u) %s: ", levelChar[level], esp_log_timestamp(), tag);
+    va_list args;
+    va_start(args, format);
+    vprintf(format, args);
+    va_end(args);
+    printf("\n");
+}
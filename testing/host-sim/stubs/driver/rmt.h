@@ -0,0 +1,86 @@
+//host-sim stub of driver/rmt.h (tx only)
+//rmt_tx_start() reports a pulse on the channel gpio to the machine model and, like the driver of idf 4.x,
+//enables the tx end interrupt: counted as rmt isr
+#pragma once
+#include <stdint.h>
+#include <stdbool.h>
+#include "esp_err.h"
+#include "driver/gpio.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef enum {
+    RMT_CHANNEL_0, RMT_CHANNEL_1, RMT_CHANNEL_2, RMT_CHANNEL_3,
+    RMT_CHANNEL_4, RMT_CHANNEL_5, RMT_CHANNEL_6, RMT_CHANNEL_7,
+    RMT_CHANNEL_MAX
+} rmt_channel_t;
+
+typedef enum { RMT_MODE_TX = 0, RMT_MODE_RX, RMT_MODE_MAX } rmt_mode_t;
+typedef enum { RMT_IDLE_LEVEL_LOW = 0, RMT_IDLE_LEVEL_HIGH, RMT_IDLE_LEVEL_MAX } rmt_idle_level_t;
+typedef enum { RMT_CARRIER_LEVEL_LOW = 0, RMT_CARRIER_LEVEL_HIGH, RMT_CARRIER_LEVEL_MAX } rmt_carrier_level_t;
+
+typedef struct {
+    uint32_t carrier_freq_hz;
+    rmt_carrier_level_t carrier_level;
+    rmt_idle_level_t idle_level;
+    uint8_t carrier_duty_percent;
+    uint32_t loop_count;
+    bool carrier_en;
+    bool loop_en;
+    bool idle_output_en;
+} rmt_tx_config_t;
+
+typedef struct {
+    rmt_mode_t rmt_mode;
+    rmt_channel_t channel;
+    gpio_num_t gpio_num;
+    uint8_t clk_div;
+    uint8_t mem_block_num;
+    uint32_t flags;
+    rmt_tx_config_t tx_config;
+} rmt_config_t;
+
+typedef struct {
+    union {
+        struct {
+            uint32_t duration0 :15;
+            uint32_t level0 :1;
+            uint32_t duration1 :15;
+            uint32_t level1 :1;
+        };
+        uint32_t val;
+    };
+} rmt_item32_t;
+
+#define RMT_DEFAULT_CONFIG_TX(gpio, channel_id) \
+    {                                           \
+        .rmt_mode = RMT_MODE_TX,                \
+        .channel = channel_id,                  \
+        .gpio_num = gpio,                       \
+        .clk_div = 80,                          \
+        .mem_block_num = 1,                     \
+        .flags = 0,                             \
+        .tx_config = {                          \
+            .carrier_freq_hz = 38000,           \
+            .carrier_level = RMT_CARRIER_LEVEL_HIGH, \
+            .idle_level = RMT_IDLE_LEVEL_LOW,   \
+            .carrier_duty_percent = 33,         \
+            .loop_count = 0,                    \
+            .carrier_en = false,                \
+            .loop_en = false,                   \
+            .idle_output_en = true,             \
+        }                                       \
+    }
+
+esp_err_t rmt_config(const rmt_config_t *rmt_param);
+esp_err_t rmt_driver_install(rmt_channel_t channel, size_t rx_buf_size, int intr_alloc_flags);
+esp_err_t rmt_driver_uninstall(rmt_channel_t channel);
+esp_err_t rmt_fill_tx_items(rmt_channel_t channel, const rmt_item32_t *item, uint16_t item_num, uint16_t mem_offset);
+esp_err_t rmt_tx_start(rmt_channel_t channel, bool tx_idx_rst);
+esp_err_t rmt_set_tx_intr_en(rmt_channel_t channel, bool en);
+
+#ifdef __cplusplus
+}
+#endif
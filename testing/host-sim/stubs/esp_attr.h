@@ -0,0 +1,6 @@
+//host-sim stub of esp_attr.h
+#pragma once
+#define IRAM_ATTR
+#define DRAM_ATTR
+#define RTC_NOINIT_ATTR
+#define RTC_DATA_ATTR
@@ -0,0 +1,4 @@
+//host-sim stub of esp_system.h
+#pragma once
+#include "esp_err.h"
+#include "esp_timer.h"
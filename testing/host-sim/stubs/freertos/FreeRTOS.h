@@ -0,0 +1,56 @@
+//host-sim stub of freertos/FreeRTOS.h
+//tasks run as coroutines on a virtual clock, see sim_rtos.cpp
+#pragma once
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdlib.h>
+#include <math.h>
+#include "esp_err.h"
+#include "esp_attr.h"
+#include "esp_timer.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef int BaseType_t;
+typedef unsigned int UBaseType_t;
+typedef uint32_t TickType_t;
+typedef uint32_t StackType_t;
+
+#define pdFALSE ((BaseType_t)0)
+#define pdTRUE  ((BaseType_t)1)
+#define pdFAIL  pdFALSE
+#define pdPASS  pdTRUE
+#define errQUEUE_FULL ((BaseType_t)0)
+
+#define configTICK_RATE_HZ 100
+#define configMINIMAL_STACK_SIZE 768
+#define portMAX_DELAY ((TickType_t)0xffffffffUL)
+#define portTICK_PERIOD_MS ((TickType_t)1000 / configTICK_RATE_HZ)
+#define portTICK_RATE_MS portTICK_PERIOD_MS
+#define pdMS_TO_TICKS(xTimeInMs) ((TickType_t)(((TickType_t)(xTimeInMs) * (TickType_t)configTICK_RATE_HZ) / (TickType_t)1000U))
+
+//no preemption in the simulation: ISRs and tasks never interleave
+#define portYIELD_FROM_ISR(...) do {} while(0)
+#define portMUX_INITIALIZER_UNLOCKED 0
+typedef int portMUX_TYPE;
+#define portENTER_CRITICAL(mux) do { (void)(mux); } while(0)
+#define portEXIT_CRITICAL(mux) do { (void)(mux); } while(0)
+#define portENTER_CRITICAL_ISR(mux) do { (void)(mux); } while(0)
+#define portEXIT_CRITICAL_ISR(mux) do { (void)(mux); } while(0)
+#define taskENTER_CRITICAL(mux) portENTER_CRITICAL(mux)
+#define taskEXIT_CRITICAL(mux) portEXIT_CRITICAL(mux)
+
+typedef struct simTask * TaskHandle_t;
+typedef struct simQueue * QueueHandle_t;
+typedef QueueHandle_t SemaphoreHandle_t;
+typedef void (*TaskFunction_t)(void *);
+
+void ets_delay_us(uint32_t us);
+static inline void esp_rom_delay_us(uint32_t us) { ets_delay_us(us); }
+
+#ifdef __cplusplus
+}
+#endif
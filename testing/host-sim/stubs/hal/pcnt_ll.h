@@ -0,0 +1,22 @@
+//host-sim stub of hal/pcnt_ll.h (low level access to the pulse counter registers of idf 4.4)
+//implemented on the simulated units in sim_periph.cpp
+#pragma once
+#include <stdint.h>
+#include "driver/pcnt.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef struct simPcntDev pcnt_dev_t;
+pcnt_dev_t *sim_pcntHw(void);
+#define PCNT_LL_GET_HW(num) sim_pcntHw()
+
+void pcnt_ll_get_counter_value(pcnt_dev_t *hw, pcnt_unit_t unit, int16_t *count);
+void pcnt_ll_get_intr_status(pcnt_dev_t *hw, uint32_t *status); //bit per unit: interrupt pending
+void pcnt_ll_clear_intr_status(pcnt_dev_t *hw, uint32_t status);
+void pcnt_ll_get_event_status(pcnt_dev_t *hw, pcnt_unit_t unit, uint32_t *status);
+
+#ifdef __cplusplus
+}
+#endif
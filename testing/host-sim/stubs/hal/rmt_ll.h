@@ -0,0 +1,19 @@
+//host-sim stub of hal/rmt_ll.h (low level access to the rmt registers of idf 4.4)
+//implemented in sim_periph.cpp, starting a channel reports a pulse without the tx end interrupt of the driver
+#pragma once
+#include <stdint.h>
+#include "driver/rmt.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef struct simRmtDev rmt_dev_t;
+extern rmt_dev_t RMT; //declared by soc/rmt_struct.h on the target
+
+void rmt_ll_tx_reset_pointer(rmt_dev_t *dev, uint32_t channel);
+void rmt_ll_tx_start(rmt_dev_t *dev, uint32_t channel);
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,29 @@
+//host-sim stub of hal/timer_types.h
+#pragma once
+#include <stdint.h>
+#include <stdbool.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef enum { TIMER_GROUP_0 = 0, TIMER_GROUP_1, TIMER_GROUP_MAX } timer_group_t;
+typedef enum { TIMER_0 = 0, TIMER_1, TIMER_MAX } timer_idx_t;
+typedef enum { TIMER_COUNT_DOWN = 0, TIMER_COUNT_UP, TIMER_COUNT_MAX } timer_count_dir_t;
+typedef enum { TIMER_PAUSE = 0, TIMER_START } timer_start_t;
+typedef enum { TIMER_ALARM_DIS = 0, TIMER_ALARM_EN, TIMER_ALARM_MAX } timer_alarm_t;
+typedef enum { TIMER_INTR_LEVEL = 0, TIMER_INTR_MAX } timer_intr_mode_t;
+typedef enum { TIMER_AUTORELOAD_DIS = 0, TIMER_AUTORELOAD_EN, TIMER_AUTORELOAD_MAX } timer_autoreload_t;
+
+typedef struct {
+    timer_alarm_t alarm_en;
+    timer_start_t counter_en;
+    timer_intr_mode_t intr_type;
+    timer_count_dir_t counter_dir;
+    timer_autoreload_t auto_reload;
+    uint32_t divider;
+} timer_config_t;
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,300 @@
+//host test for the flash journal (main/journal.cpp)
+//runs the journal on a simulated nor flash (programming clears bits, erasing sets whole sectors)
+//with the geometry of the "journal" partition and checks:
+//- latest record after reopening (restart) is the last completely written one
+//- power loss while programming a record or erasing a sector (torn write, partly erased sector)
+//- missed maintenance (erase while appending)
+//- reserved slot: urgent record while the sector ahead is being erased
+//- wear: erase count of all sectors, flash reads needed to open
+#include <stdio.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <vector>
+#include <algorithm>
+#include "journal.hpp"
+
+//geometry and payload as used by main/persist.cpp
+#define SECTOR_SIZE 4096
+#define SECTOR_COUNT 16
+#define PAYLOAD_SIZE 72
+
+#define RECORDS 200000   //records appended in the long run
+#define RESTART_EVERY 997 //reopen journal after this many records (long run)
+#define POWER_LOSS_RUNS 5000
+
+
+//=============================
+//===== simulated flash =======
+//=============================
+struct simFlash {
+    std::vector<uint8_t> data = std::vector<uint8_t>(SECTOR_SIZE * SECTOR_COUNT, 0xFF);
+    uint32_t erases[SECTOR_COUNT] = {};
+    uint64_t reads = 0;
+    uint64_t programmedBytes = 0;
+    //power loss: remaining bytes that are programmed / erased before power is lost, -1 = no loss
+    long powerBudget = -1;
+    bool powerLost = false;
+};
+
+static bool consumePower(simFlash *flash, uint32_t &size){
+    if (flash->powerLost) { size = 0; return false; }
+    if (flash->powerBudget < 0) return true;
+    if ((long)size > flash->powerBudget) {
+        size = flash->powerBudget;
+        flash->powerLost = true;
+    }
+    flash->powerBudget -= size;
+    return !flash->powerLost;
+}
+
+static int flashRead(void *ctx, uint32_t offset, void *dst, uint32_t size){
+    simFlash *flash = (simFlash *)ctx;
+    if (offset + size > flash->data.size()) return -1;
+    flash->reads++;
+    memcpy(dst, &flash->data[offset], size);
+    return 0;
+}
+
+static int flashWrite(void *ctx, uint32_t offset, const void *src, uint32_t size){
+    simFlash *flash = (simFlash *)ctx;
+    if (offset + size > flash->data.size()) return -1;
+    bool complete = consumePower(flash, size);
+    for (uint32_t i = 0; i < size; i++) {
+        flash->data[offset + i] &= ((const uint8_t *)src)[i];
+    }
+    //last byte of a torn write is partly programmed
+    if (!complete && offset + size < flash->data.size()) {
+        flash->data[offset + size] &= ((const uint8_t *)src)[size] | 0x0F;
+    }
+    flash->programmedBytes += size;
+    return complete ? 0 : -1;
+}
+
+static int flashErase(void *ctx, uint32_t offset, uint32_t size){
+    simFlash *flash = (simFlash *)ctx;
+    if (offset % SECTOR_SIZE || size % SECTOR_SIZE || offset + size > flash->data.size()) return -1;
+    for (uint32_t sector = offset / SECTOR_SIZE; sector < (offset + size) / SECTOR_SIZE; sector++) {
+        uint32_t length = SECTOR_SIZE;
+        bool complete = consumePower(flash, length);
+        //interrupted erase: sector is partly erased
+        memset(&flash->data[sector * SECTOR_SIZE], 0xFF, length);
+        if (!complete) return -1;
+        flash->erases[sector]++;
+    }
+    return 0;
+}
+
+static journalFlash_t flashOf(simFlash *flash){
+    return {flashRead, flashWrite, flashErase, flash, SECTOR_SIZE, SECTOR_COUNT};
+}
+
+
+//=====================
+//====== helpers ======
+//=====================
+static int failures = 0;
+#define CHECK(condition, ...) do { if (!(condition)) { failures++; printf("FAIL %s:%d: ", __FILE__, __LINE__); printf(__VA_ARGS__); printf("\n"); } } while (0)
+
+//payload with counter and pattern derived from it
+static void makePayload(uint8_t *payload, uint32_t counter){
+    for (int i = 0; i < PAYLOAD_SIZE; i++) payload[i] = (uint8_t)(counter * 31 + i);
+    memcpy(payload, &counter, sizeof(counter));
+}
+
+static bool payloadValid(const uint8_t *payload, uint32_t *counter){
+    memcpy(counter, payload, sizeof(*counter));
+    uint8_t expected[PAYLOAD_SIZE];
+    makePayload(expected, *counter);
+    return memcmp(expected, payload, PAYLOAD_SIZE) == 0;
+}
+
+static bool latestCounter(journal_t *journal, uint32_t *counter){
+    uint8_t payload[PAYLOAD_SIZE];
+    if (!journal_readLatest(journal, payload, NULL)) return false;
+    CHECK(payloadValid(payload, counter), "latest payload corrupt");
+    return true;
+}
+
+
+
+//======================
+//======= tests ========
+//======================
+static void testEmptyAndMark(){
+    simFlash flash;
+    journalFlash_t access = flashOf(&flash);
+    journal_t journal;
+    CHECK(journal_open(&journal, &access, PAYLOAD_SIZE) == 0, "open failed");
+    uint32_t counter;
+    CHECK(!latestCounter(&journal, &counter), "empty journal has a record");
+
+    uint8_t payload[PAYLOAD_SIZE];
+    makePayload(payload, 42);
+    CHECK(journal_append(&journal, payload) == 0, "append failed");
+    CHECK(journal_markLatest(&journal, 1234) == 0, "mark failed");
+
+    journal_open(&journal, &access, PAYLOAD_SIZE);
+    uint32_t mark = 0;
+    CHECK(journal_readLatest(&journal, payload, &mark) && payloadValid(payload, &counter) && counter == 42,
+            "record not found after reopen");
+    CHECK(mark == 1234, "mark %u != 1234", mark);
+
+    //too few sectors / too large payload
+    journalFlash_t small = access;
+    small.sectorCount = 2;
+    CHECK(journal_open(&journal, &small, PAYLOAD_SIZE) != 0, "open with 2 sectors accepted");
+    CHECK(journal_open(&journal, &access, 1000) != 0, "open with too large payload accepted");
+    printf("empty journal, mark, configuration: done\n");
+}
+
+
+static void testLongRun(){
+    simFlash flash;
+    journalFlash_t access = flashOf(&flash);
+    journal_t journal;
+    journal_open(&journal, &access, PAYLOAD_SIZE);
+    uint32_t readsMax = 0;
+    uint8_t payload[PAYLOAD_SIZE];
+    for (uint32_t i = 1; i <= RECORDS; i++) {
+        makePayload(payload, i);
+        CHECK(journal_append(&journal, payload) == 0, "append %u failed", i);
+        if (journal_needsMaintenance(&journal)) journal_maintain(&journal);
+        if (i % RESTART_EVERY == 0) {
+            journal_open(&journal, &access, PAYLOAD_SIZE);
+            if (journal.openReads > readsMax) readsMax = journal.openReads;
+            uint32_t counter = 0;
+            CHECK(latestCounter(&journal, &counter) && counter == i, "after restart latest %u != %u", counter, i);
+            if (journal_needsMaintenance(&journal)) journal_maintain(&journal);
+        }
+    }
+    uint32_t erasesMin = UINT32_MAX, erasesMax = 0;
+    for (uint32_t count : flash.erases) {
+        if (count < erasesMin) erasesMin = count;
+        if (count > erasesMax) erasesMax = count;
+    }
+    CHECK(erasesMax - erasesMin <= 1, "uneven wear: erases %u..%u", erasesMin, erasesMax);
+    printf("long run: %d records (%d per sector), erases per sector %u..%u, %.1f records per erase, max %u reads at open\n",
+            RECORDS, journal.slotsPerSector, erasesMin, erasesMax,
+            (double)RECORDS / (erasesMax * SECTOR_COUNT), readsMax);
+}
+
+
+static void testMissedMaintenance(){
+    simFlash flash;
+    journalFlash_t access = flashOf(&flash);
+    journal_t journal;
+    journal_open(&journal, &access, PAYLOAD_SIZE);
+    uint8_t payload[PAYLOAD_SIZE];
+    //several passes through the ring without ever calling journal_maintain
+    uint32_t records = journal.slotsPerSector * SECTOR_COUNT * 3;
+    for (uint32_t i = 1; i <= records; i++) {
+        makePayload(payload, i);
+        CHECK(journal_append(&journal, payload) == 0, "append %u failed", i);
+    }
+    journal_open(&journal, &access, PAYLOAD_SIZE);
+    uint32_t counter = 0;
+    CHECK(latestCounter(&journal, &counter) && counter == records, "latest %u != %u", counter, records);
+    printf("missed maintenance: %u records, erased while appending: done\n", records);
+}
+
+
+//sector ahead is erased in steps (unlocked), meanwhile normal records are deferred at the reserved slot
+//and an urgent record is still written without erasing
+static void testReserveWhileErasing(){
+    simFlash flash;
+    std::fill(flash.data.begin(), flash.data.end(), 0); //nothing erased ahead
+    journalFlash_t access = flashOf(&flash);
+    journal_t journal;
+    journal_open(&journal, &access, PAYLOAD_SIZE);
+    uint8_t payload[PAYLOAD_SIZE];
+    uint32_t counter = 0;
+    for (int pass = 0; pass < SECTOR_COUNT * 2; pass++) {
+        //--- fill head sector up to reserved slot ---
+        while (journal.headSlot + 1 < journal.slotsPerSector) {
+            makePayload(payload, ++counter);
+            CHECK(journal_append(&journal, payload) == 0, "append %u failed", counter);
+        }
+        //--- start erase of sector ahead ---
+        uint32_t sector = (journal.headSector + 1) % SECTOR_COUNT;
+        uint32_t erasesBefore = flash.erases[sector];
+        bool begun = journal_maintainBegin(&journal, &sector);
+        CHECK(begun && sector == (journal.headSector + 1) % SECTOR_COUNT, "pass %d: erase not started", pass);
+        if (!begun) return;
+        CHECK(!journal_maintainBegin(&journal, &sector), "pass %d: erase started twice", pass);
+        makePayload(payload, counter + 1);
+        CHECK(journal_append(&journal, payload) == JOURNAL_BUSY, "pass %d: normal record used reserved slot", pass);
+        makePayload(payload, ++counter);
+        CHECK(journal_append(&journal, payload, true) == 0, "pass %d: urgent record failed", pass);
+        CHECK(flash.erases[sector] == erasesBefore, "pass %d: urgent record erased", pass);
+        //--- finish erase, head continues in the erased sector ---
+        journal_maintainEnd(&journal, sector, journal_maintainErase(&journal, sector));
+        CHECK(!journal_needsMaintenance(&journal), "pass %d: sector ahead not erased", pass);
+        makePayload(payload, ++counter);
+        CHECK(journal_append(&journal, payload) == 0 && journal.headSector == sector, "pass %d: append after erase failed", pass);
+    }
+    journal_open(&journal, &access, PAYLOAD_SIZE);
+    uint32_t latest = 0;
+    CHECK(latestCounter(&journal, &latest) && latest == counter, "latest %u != %u", latest, counter);
+    printf("reserved slot while erasing: %d sectors, %u records: done\n", SECTOR_COUNT * 2, counter);
+}
+
+
+//append until power is lost at a random point (while programming or erasing), then restart
+static void testPowerLoss(){
+    simFlash flash;
+    journalFlash_t access = flashOf(&flash);
+    journal_t journal;
+    journal_open(&journal, &access, PAYLOAD_SIZE);
+    srand(1);
+    uint32_t lastComplete = 0; //counter of last record written completely
+    uint32_t torn = 0;         //counter of record written when power was lost
+    uint32_t counter = 0;
+    uint32_t tornRecords = 0, interruptedErases = 0;
+    uint8_t payload[PAYLOAD_SIZE];
+    for (int run = 0; run < POWER_LOSS_RUNS; run++) {
+        //random amount of work until power is lost
+        flash.powerBudget = rand() % (SECTOR_SIZE * 4);
+        flash.powerLost = false;
+        torn = 0;
+        while (!flash.powerLost) {
+            makePayload(payload, ++counter);
+            bool erasing = !journal.aheadErased && rand() % 2;
+            if (erasing) {
+                if (journal_maintain(&journal) != 0) { interruptedErases++; break; }
+            }
+            if (journal_append(&journal, payload) == 0) lastComplete = counter;
+            else { tornRecords++; torn = counter; }
+        }
+
+        //--- restart ---
+        flash.powerBudget = -1;
+        flash.powerLost = false;
+        CHECK(journal_open(&journal, &access, PAYLOAD_SIZE) == 0, "open after power loss failed");
+        uint32_t latest = 0;
+        bool found = latestCounter(&journal, &latest);
+        //a torn record is valid if the missing bits did not have to be programmed
+        CHECK(found && (latest == lastComplete || (torn && latest == torn)),
+                "run %d: latest %u != last complete %u", run, latest, lastComplete);
+        if (journal_needsMaintenance(&journal)) journal_maintain(&journal);
+        lastComplete = latest;
+        counter = lastComplete;
+    }
+    printf("power loss: %d restarts, %u torn records, %u interrupted erases, last record %u: done\n",
+            POWER_LOSS_RUNS, tornRecords, interruptedErases, lastComplete);
+}
+
+
+
+//=====================
+//======= main ========
+//=====================
+int main(){
+    testEmptyAndMark();
+    testLongRun();
+    testMissedMaintenance();
+    testReserveWhileErasing();
+    testPowerLoss();
+    printf("%s (%d failures)\n", failures ? "FAILED" : "PASSED", failures);
+    return failures ? 1 : 0;
+}
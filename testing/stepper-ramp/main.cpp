@@ -0,0 +1,175 @@
+//host benchmark for the speed calculation done in the stepper isr (main/stepper.cpp)
+//compares the legacy fixed speed increment per step with the precomputed ramp table:
+//- linearity of the acceleration over time
+//- divisions per step (bound of isr time on the esp32) and cost per step on the host
+#include <stdio.h>
+#include <stdint.h>
+#include <math.h>
+#include <vector>
+#include <chrono>
+#include "stepper-ramp.hpp"
+
+//values as in config.h
+#define TIMER_F 1000000ULL
+#define STEPPER_STEPS_PER_MM (200/2)
+#define STEPPER_SPEED_MIN 4
+#define STEPPER_SPEED_MAX 70
+#define STEPPER_ACCEL 40
+#define STEPPER_DECEL 80
+#define LEGACY_ACCEL_INC 3
+#define LEGACY_DECEL_INC 7
+
+static const uint32_t speedMin = STEPPER_SPEED_MIN * STEPPER_STEPS_PER_MM;
+
+//divisions done by the isr calculation (64 bit: software routine on the esp32, duration depends on operands)
+static uint64_t divisions64 = 0;
+static uint64_t divisions32 = 0;
+
+
+//==============================
+//===== legacy calculation =====
+//==============================
+//speed in steps/s changes by fixed amount every step (copy of previous timer_isr code)
+struct legacyRamp {
+	uint32_t speedNow = speedMin;
+	uint32_t speedTarget;
+	legacyRamp(uint32_t target) : speedTarget(target) {}
+	uint32_t next(uint64_t stepsToGo){
+		uint64_t stepsDecelRemaining = (speedNow - speedMin) / LEGACY_DECEL_INC;
+		if (stepsToGo < stepsDecelRemaining/2) stepsToGo = stepsDecelRemaining;
+		if (stepsToGo <= stepsDecelRemaining) {
+			if ((speedNow - speedMin) > LEGACY_DECEL_INC) speedNow -= LEGACY_DECEL_INC;
+			else speedNow = speedMin;
+		}
+		else if (speedNow < speedTarget) {
+			speedNow += LEGACY_ACCEL_INC;
+			if (speedNow > speedTarget) speedNow = speedTarget;
+		}
+		else speedNow = speedTarget;
+		divisions64 += 2;
+		return TIMER_F / speedNow;
+	}
+};
+
+
+//=============================
+//===== table calculation =====
+//=============================
+//same logic as current timer_isr
+struct tableRamp {
+	uint32_t rampIndex = 0;
+	uint32_t rampIndexTarget;
+	uint32_t accel_increment = ramp_accelToIncrement(STEPPER_ACCEL * STEPPER_STEPS_PER_MM);
+	uint32_t decel_increment = ramp_accelToIncrement(STEPPER_DECEL * STEPPER_STEPS_PER_MM);
+	tableRamp(uint32_t target) : rampIndexTarget(ramp_speedToIndex(target)) {}
+	uint32_t next(uint64_t stepsToGo){
+		uint64_t decelIndexToGo = stepsToGo * decel_increment;
+		if ((stepsToGo + 1) * 2 * decel_increment <= rampIndex) {
+			divisions32++;
+			stepsToGo = rampIndex / decel_increment;
+			decelIndexToGo = stepsToGo * decel_increment;
+		}
+		if (decelIndexToGo <= rampIndex) {
+			if (rampIndex > decel_increment) rampIndex -= decel_increment;
+			else rampIndex = 0;
+		}
+		else if (rampIndex < rampIndexTarget) {
+			rampIndex += accel_increment;
+			if (rampIndex > rampIndexTarget) rampIndex = rampIndexTarget;
+		}
+		else if (rampIndex > rampIndexTarget) {
+			if (rampIndex - rampIndexTarget > decel_increment) rampIndex -= decel_increment;
+			else rampIndex = rampIndexTarget;
+		}
+		return ramp_interval(rampIndex);
+	}
+};
+
+
+//=====================
+//===== benchmark =====
+//=====================
+//run move of certain steps, returns intervals of all steps
+template <typename RAMP>
+static std::vector<uint32_t> runMove(uint32_t steps, uint32_t speedTarget){
+	RAMP ramp(speedTarget);
+	std::vector<uint32_t> intervals;
+	for (uint64_t stepsToGo = steps; stepsToGo > 0; stepsToGo--) {
+		intervals.push_back(ramp.next(stepsToGo));
+	}
+	return intervals;
+}
+
+//ns per calculated step on this host
+template <typename RAMP>
+static double timePerStep(uint32_t steps, uint32_t speedTarget){
+	const int repeat = 2000;
+	volatile uint32_t sink = 0;
+	auto start = std::chrono::steady_clock::now();
+	for (int r = 0; r < repeat; r++) {
+		RAMP ramp(speedTarget);
+		for (uint64_t stepsToGo = steps; stepsToGo > 0; stepsToGo--) {
+			sink = sink + ramp.next(stepsToGo);
+		}
+	}
+	double ns = std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count();
+	return ns / ((double)repeat * steps);
+}
+
+//evaluate acceleration phase (standstill until 95% of reached speed):
+//fit a line to speed over time, deviation from that line shows non-linear acceleration
+static void printProfile(const char * name, const std::vector<uint32_t> & intervals, double accelNominal){
+	double vReached = (double)TIMER_F / intervals[intervals.size() / 2] / STEPPER_STEPS_PER_MM;
+	std::vector<double> t, v;
+	double time = 0, tTotal = 0;
+	for (uint32_t interval : intervals) tTotal += interval / (double)TIMER_F;
+	for (uint32_t interval : intervals) {
+		double speed = (double)TIMER_F / interval / STEPPER_STEPS_PER_MM;
+		if (speed > 0.95 * vReached) break;
+		time += interval / (double)TIMER_F;
+		t.push_back(time);
+		v.push_back(speed);
+	}
+	//least squares fit v = v0 + a*t
+	double n = t.size(), st = 0, sv = 0, stt = 0, stv = 0;
+	for (size_t i = 0; i < t.size(); i++) { st += t[i]; sv += v[i]; stt += t[i]*t[i]; stv += t[i]*v[i]; }
+	double a = (n*stv - st*sv) / (n*stt - st*st);
+	double v0 = (sv - a*st) / n;
+	double devMax = 0;
+	for (size_t i = 0; i < t.size(); i++) devMax = fmax(devMax, fabs(v[i] - (v0 + a*t[i])));
+
+	printf("  %-7s v=%5.1fmm/s  accel %6.1fmm/s^2", name, vReached, a);
+	if (accelNominal > 0) printf(" (set %4.0f)", accelNominal); else printf("           ");
+	printf("  max deviation from linear ramp %5.2fmm/s  accel time %.3fs  move time %.3fs\n", devMax, time, tTotal);
+}
+
+
+int main(){
+	ramp_init(speedMin, STEPPER_SPEED_MAX * STEPPER_STEPS_PER_MM, TIMER_F);
+	const uint32_t speeds[] = {25, 45, 70}; //mm/s
+	const uint32_t moveSteps = 80 * STEPPER_STEPS_PER_MM; //80mm
+
+	printf("=== stepper ramp benchmark: move %umm from standstill ===\n", moveSteps / STEPPER_STEPS_PER_MM);
+	for (uint32_t speed : speeds) {
+		uint32_t target = speed * STEPPER_STEPS_PER_MM;
+		printf("target speed %u mm/s:\n", speed);
+		printProfile("legacy", runMove<legacyRamp>(moveSteps, target), 0);
+		printProfile("table", runMove<tableRamp>(moveSteps, target), STEPPER_ACCEL);
+	}
+
+	printf("\n=== divisions per step in isr (move %umm at 25 mm/s) ===\n", moveSteps / STEPPER_STEPS_PER_MM);
+	//the esp32 divides 32 bit in hardware, 64 bit divisions are a software loop with data dependent duration
+	divisions64 = divisions32 = 0;
+	runMove<legacyRamp>(moveSteps, 25 * STEPPER_STEPS_PER_MM);
+	printf("  legacy: %.2f (64 bit)  TIMER_F/speed + decel steps\n", (double)divisions64 / moveSteps);
+	divisions64 = divisions32 = 0;
+	runMove<tableRamp>(moveSteps, 25 * STEPPER_STEPS_PER_MM);
+	printf("  table:  %.2f (32 bit)  only when target is lowered below decel distance, compared as stepsToGo*decel_increment\n",
+			(double)divisions32 / moveSteps);
+
+	printf("\n=== calculation cost per step (host, -O2, 64 bit division in hardware: not representative for esp32) ===\n");
+	printf("  legacy: %.2f ns\n", timePerStep<legacyRamp>(moveSteps, 25 * STEPPER_STEPS_PER_MM));
+	printf("  table:  %.2f ns  (table lookup + interpolation, 2 multiplications)\n",
+			timePerStep<tableRamp>(moveSteps, 25 * STEPPER_STEPS_PER_MM));
+	return 0;
+}